@@ -4,6 +4,7 @@
  */
 
 #include "buffer.h"
+#include "stats.h"
 
 
 BakeError buf_allocate(Buffer * out, size_t capacity) {
@@ -73,6 +74,7 @@ BakeError buf_growToCapacity(Buffer * buffer, size_t capacity) {
 
     // Update the capacity of the buffer so we can write into the new space
     buffer->capacity = capacity;
+    countStat(STAT_BUFFER_GROWTHS, 1);
 
     return BAKE_SUCCESS;
 }
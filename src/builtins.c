@@ -0,0 +1,361 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "builtins.h"
+
+
+/**
+ * The size of the buffer used to copy the contents of files.
+ */
+#define COPY_BUFFER_SIZE  65536
+
+
+/**
+ * The commands that can be executed within bake.
+ */
+static const Builtin BUILTINS[] = {
+    {"echo", builtinEcho},
+    {"mkdir", builtinMkdir},
+    {"touch", builtinTouch},
+    {"rm", builtinRm},
+    {"cp", builtinCp}
+};
+
+
+void runBuiltin(char ** arguments, FILE * output, FILE * error, bool * executed, int * exitStatus) {
+    *executed = false;
+
+    for(size_t index = 0; index < sizeof(BUILTINS) / sizeof(BUILTINS[0]); ++index) {
+        if(strcmp(arguments[0], BUILTINS[index].name) == 0) {
+            *executed = BUILTINS[index].function(&arguments[1], output, error, exitStatus);
+            return;
+        }
+    }
+}
+
+
+bool builtinEcho(char ** arguments, FILE * output, FILE * error, int * exitStatus) {
+    // Escapes are interpreted differently by different shells, so leave them to the shell
+    for(size_t index = 0; arguments[index] != NULL; ++index) {
+        if(strchr(arguments[index], '\\') != NULL)
+            return false;
+    }
+
+    // A single -n is the only option that bash and dash both read
+    bool newline = true;
+    if(*arguments != NULL && strcmp(*arguments, "-n") == 0) {
+        newline = false;
+        arguments++;
+    }
+
+    // Any other options, such as -E, are read by bash but printed by dash, so leave them to the shell
+    if(*arguments != NULL && (*arguments)[0] == '-' && (*arguments)[1] != '\0'
+       && strspn(&(*arguments)[1], "nEe") == strlen(&(*arguments)[1]))
+        return false;
+
+    // Print the arguments separated by spaces
+    for(size_t index = 0; arguments[index] != NULL; ++index) {
+        if(index > 0) {
+            fputc(' ', output);
+        }
+
+        fputs(arguments[index], output);
+    }
+
+    if(newline) {
+        fputc('\n', output);
+    }
+
+    // Like the shell, only fail if the output couldn't be written
+    *exitStatus = EXIT_SUCCESS;
+    if(fflush(output) != 0 || ferror(output)) {
+        fprintf(error, "echo: write error: %s\n", strerror(errno));
+        clearerr(output);
+        *exitStatus = EXIT_FAILURE;
+    }
+
+    return true;
+}
+
+
+bool builtinMkdir(char ** arguments, FILE * output, FILE * error, int * exitStatus) {
+    bool parents = false;
+    if(*arguments != NULL && strcmp(*arguments, "-p") == 0) {
+        parents = true;
+        arguments++;
+    }
+
+    // Leave any other options, or a missing operand, to mkdir itself
+    if(*arguments == NULL)
+        return false;
+
+    for(size_t index = 0; arguments[index] != NULL; ++index) {
+        if(arguments[index][0] == '-')
+            return false;
+    }
+
+    *exitStatus = EXIT_SUCCESS;
+    for(size_t index = 0; arguments[index] != NULL; ++index) {
+        char * path = arguments[index];
+
+        if(parents) {
+            // makeParentDirectories reports which directory it couldn't create
+            if(makeParentDirectories(path, error) != 0) {
+                *exitStatus = EXIT_FAILURE;
+            }
+        } else if(mkdir(path, 0777) != 0) {
+            fprintf(error, "mkdir: cannot create directory '%s': %s\n", path, strerror(errno));
+            *exitStatus = EXIT_FAILURE;
+        }
+    }
+
+    return true;
+}
+
+
+bool builtinTouch(char ** arguments, FILE * output, FILE * error, int * exitStatus) {
+    // Leave any options, or a missing operand, to touch itself
+    if(*arguments == NULL)
+        return false;
+
+    for(size_t index = 0; arguments[index] != NULL; ++index) {
+        if(arguments[index][0] == '-')
+            return false;
+    }
+
+    *exitStatus = EXIT_SUCCESS;
+    for(size_t index = 0; arguments[index] != NULL; ++index) {
+        char * path = arguments[index];
+
+        // Create the file if it doesn't exist, and then update its times to now
+        int fd = open(path, O_WRONLY | O_CREAT | O_NOCTTY | O_NONBLOCK, 0666);
+        int openError = errno;
+
+        int err;
+        if(fd >= 0) {
+            err = futimens(fd, NULL);
+            close(fd);
+        } else {
+            err = utimensat(AT_FDCWD, path, NULL, 0);
+
+            // If the file couldn't be opened or updated, report why it couldn't be opened
+            if(err != 0 && openError != EISDIR) {
+                errno = openError;
+            }
+        }
+
+        if(err != 0) {
+            fprintf(error, "touch: cannot touch '%s': %s\n", path, strerror(errno));
+            *exitStatus = EXIT_FAILURE;
+        }
+    }
+
+    return true;
+}
+
+
+bool builtinRm(char ** arguments, FILE * output, FILE * error, int * exitStatus) {
+    // Without -f rm may prompt before removing files, so leave it to rm itself
+    if(*arguments == NULL || strcmp(*arguments, "-f") != 0)
+        return false;
+
+    arguments++;
+    for(size_t index = 0; arguments[index] != NULL; ++index) {
+        if(arguments[index][0] == '-')
+            return false;
+    }
+
+    *exitStatus = EXIT_SUCCESS;
+    for(size_t index = 0; arguments[index] != NULL; ++index) {
+        char * path = arguments[index];
+
+        // Files that don't exist are ignored with -f
+        if(unlink(path) == 0 || errno == ENOENT)
+            continue;
+
+        // Some systems report removing a directory as not being permitted
+        int errorNumber = errno;
+        struct stat result;
+        if(lstat(path, &result) == 0 && S_ISDIR(result.st_mode)) {
+            errorNumber = EISDIR;
+        }
+
+        fprintf(error, "rm: cannot remove '%s': %s\n", path, strerror(errorNumber));
+        *exitStatus = EXIT_FAILURE;
+    }
+
+    return true;
+}
+
+
+bool builtinCp(char ** arguments, FILE * output, FILE * error, int * exitStatus) {
+    // Only support copying one file without any options
+    if(arguments[0] == NULL || arguments[1] == NULL || arguments[2] != NULL
+       || arguments[0][0] == '-' || arguments[1][0] == '-')
+        return false;
+
+    char * source = arguments[0];
+    char * destination = arguments[1];
+
+    // If the destination is a directory, copy the file into it
+    char path[PATH_MAX];
+    struct stat result;
+    if(stat(destination, &result) == 0 && S_ISDIR(result.st_mode)) {
+        char * sourceCopy = strdup(source);
+        if(sourceCopy == NULL)
+            return false;
+
+        int length = snprintf(path, sizeof(path), "%s/%s", destination, basename(sourceCopy));
+        free(sourceCopy);
+
+        if(length < 0 || (size_t) length >= sizeof(path))
+            return false;
+
+        destination = path;
+    }
+
+    *exitStatus = (copyFile(source, destination, error) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    return true;
+}
+
+
+int makeParentDirectories(char * path, FILE * error) {
+    char * copy = strdup(path);
+    if(copy == NULL) {
+        fprintf(error, "mkdir: cannot create directory '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    // Create each directory in the path in turn, skipping the root directory
+    char * position = (copy[0] != '\0' ? copy + 1 : copy);
+    for(; ; ++position) {
+        if(*position != '/' && *position != '\0')
+            continue;
+
+        char separator = *position;
+        *position = '\0';
+
+        // Directories that already exist are fine
+        if(mkdir(copy, 0777) != 0) {
+            int errorNumber = errno;
+            struct stat result;
+            bool exists = (stat(copy, &result) == 0);
+
+            if(!exists || !S_ISDIR(result.st_mode)) {
+                // A file in the place of a parent directory is reported as it not being a directory
+                if(exists) {
+                    errorNumber = (separator == '/' ? ENOTDIR : EEXIST);
+                }
+
+                fprintf(error, "mkdir: cannot create directory '%s': %s\n", copy, strerror(errorNumber));
+                free(copy);
+                return -1;
+            }
+        }
+
+        if(separator == '\0')
+            break;
+
+        *position = separator;
+    }
+
+    free(copy);
+    return 0;
+}
+
+
+int copyFile(char * source, char * destination, FILE * error) {
+    // Open the source file
+    int sourceFD = open(source, O_RDONLY | O_NOCTTY);
+    struct stat sourceStat;
+    if(sourceFD < 0 || fstat(sourceFD, &sourceStat) != 0) {
+        fprintf(error, "cp: cannot stat '%s': %s\n", source, strerror(errno));
+        if(sourceFD >= 0) {
+            close(sourceFD);
+        }
+        return -1;
+    }
+
+    if(S_ISDIR(sourceStat.st_mode)) {
+        fprintf(error, "cp: -r not specified; omitting directory '%s'\n", source);
+        close(sourceFD);
+        return -1;
+    }
+
+    // Copying a file onto itself would truncate it
+    struct stat destinationStat;
+    if(stat(destination, &destinationStat) == 0
+       && destinationStat.st_dev == sourceStat.st_dev && destinationStat.st_ino == sourceStat.st_ino) {
+        fprintf(error, "cp: '%s' and '%s' are the same file\n", source, destination);
+        close(sourceFD);
+        return -1;
+    }
+
+    // Open the destination file, giving it the permissions of the source file if it is created
+    int destinationFD = open(destination, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, sourceStat.st_mode & 0777);
+    if(destinationFD < 0) {
+        fprintf(error, "cp: cannot create regular file '%s': %s\n", destination, strerror(errno));
+        close(sourceFD);
+        return -1;
+    }
+
+    // Copy the contents of the source file into the destination file
+    char * buffer = malloc(COPY_BUFFER_SIZE);
+    int status = (buffer != NULL ? 0 : -1);
+    int errorNumber = errno;
+
+    ssize_t charsRead = 0;
+    while(status == 0 && (charsRead = read(sourceFD, buffer, COPY_BUFFER_SIZE)) != 0) {
+        if(charsRead < 0) {
+            if(errno == EINTR)
+                continue;
+
+            status = -1;
+            errorNumber = errno;
+            break;
+        }
+
+        for(ssize_t written = 0; written < charsRead; ) {
+            ssize_t count = write(destinationFD, buffer + written, (size_t) (charsRead - written));
+            if(count < 0 && errno == EINTR)
+                continue;
+
+            if(count < 0) {
+                status = -1;
+                errorNumber = errno;
+                break;
+            }
+
+            written += count;
+        }
+    }
+
+    free(buffer);
+    close(sourceFD);
+
+    if(close(destinationFD) != 0 && status == 0) {
+        status = -1;
+        errorNumber = errno;
+    }
+
+    if(status != 0) {
+        fprintf(error, "cp: error copying '%s' to '%s': %s\n", source, destination, strerror(errorNumber));
+    }
+
+    return status;
+}
@@ -0,0 +1,107 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === builtins ===
+//
+// Executes common trivial commands, such as echo and mkdir -p, within bake itself
+// instead of in a new process. Only the simple forms of these commands are supported,
+// and anything else is left to be executed by the program itself.
+//
+
+#ifndef CITS2002_BUILTINS_H
+#define CITS2002_BUILTINS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "errors.h"
+
+
+/**
+ * A command that can be executed within bake, passed the NULL terminated arguments of the command
+ * after its name, and the files to use as its stdout and stderr. If the builtin supports the arguments,
+ * it executes the command, places its exit status into {@param exitStatus} and returns true.
+ * Otherwise it does nothing and returns false.
+ */
+typedef bool (* BuiltinFunction)(char ** arguments, FILE * output, FILE * error, int * exitStatus);
+
+
+/**
+ * A command that can be executed within bake.
+ */
+typedef struct {
+    /**
+     * The name of the program the builtin replaces.
+     */
+    char * name;
+
+    /**
+     * The function that executes the builtin.
+     */
+    BuiltinFunction function;
+} Builtin;
+
+
+/**
+ * Execute the command with the NULL terminated arguments {@param arguments} within bake if there is a
+ * builtin that supports it, placing whether it was executed into {@param executed} and its exit status
+ * into {@param exitStatus}. The output of the command is written to {@param output}, and any errors
+ * are written to {@param error}.
+ *
+ * The builtins print the same output and return the same exit status as the programs they replace.
+ */
+void runBuiltin(char ** arguments, FILE * output, FILE * error, bool * executed, int * exitStatus);
+
+
+/**
+ * Builtin echo, supporting the option -n.
+ */
+bool builtinEcho(char ** arguments, FILE * output, FILE * error, int * exitStatus);
+
+
+/**
+ * Builtin mkdir, supporting the option -p.
+ */
+bool builtinMkdir(char ** arguments, FILE * output, FILE * error, int * exitStatus);
+
+
+/**
+ * Builtin touch, without any options.
+ */
+bool builtinTouch(char ** arguments, FILE * output, FILE * error, int * exitStatus);
+
+
+/**
+ * Builtin rm, only supporting the option -f.
+ */
+bool builtinRm(char ** arguments, FILE * output, FILE * error, int * exitStatus);
+
+
+/**
+ * Builtin cp, only supporting copying one regular file without any options.
+ */
+bool builtinCp(char ** arguments, FILE * output, FILE * error, int * exitStatus);
+
+
+/**
+ * Create the directory {@param path} and any of its parents that don't exist, like mkdir -p,
+ * writing any errors to {@param error}.
+ *
+ * @return 0 on success, or -1 with errno set if a directory could not be created
+ */
+int makeParentDirectories(char * path, FILE * error);
+
+
+/**
+ * Copy the contents of the regular file {@param source} into {@param destination}, like cp,
+ * writing any errors to {@param error}.
+ *
+ * @return 0 on success, or -1 if the file could not be copied
+ */
+int copyFile(char * source, char * destination, FILE * error);
+
+
+#endif //CITS2002_BUILTINS_H
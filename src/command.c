@@ -0,0 +1,329 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+ */
+
+// strdup is POSIX, and glibc only declares it under -std=c99 when a feature-test macro is defined
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "command.h"
+#include "stats.h"
+
+
+/**
+ * Shell keywords, and shell builtins that either change the state of the
+ * shell or have no standalone program, which must be executed by the shell.
+ */
+static const char * SHELL_WORDS[] = {
+    "!", "{", "}", "[[", "]]", ".", ":", "alias", "bg", "break", "builtin", "case", "cd", "command",
+    "continue", "declare", "do", "done", "elif", "else", "esac", "eval", "exec", "exit", "export",
+    "fg", "fi", "for", "function", "getopts", "hash", "if", "in", "jobs", "let", "local", "read",
+    "readonly", "return", "select", "set", "shift", "source", "then", "time", "times", "trap",
+    "type", "typeset", "ulimit", "umask", "unalias", "unset", "until", "wait", "while"
+};
+
+
+/**
+ * The names of shells that behave like a POSIX shell.
+ */
+static const char * POSIX_SHELLS[] = {"sh", "bash", "dash", "ash", "ksh", "mksh", "zsh"};
+
+
+bool isShellCharacter(char ch) {
+    switch (ch) {
+        case '|': case '&': case ';': case '<': case '>': case '(': case ')':
+        case '$': case '`': case '\\': case '*': case '?': case '[': case ']':
+        case '#': case '~': case '{': case '}': case '!':
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+bool isShellWord(char * word) {
+    for(size_t index = 0; index < sizeof(SHELL_WORDS) / sizeof(SHELL_WORDS[0]); ++index) {
+        if(strcmp(word, SHELL_WORDS[index]) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+
+bool isPosixShell(char * shell) {
+    // Find the name of the shell's program, without its directory
+    char * name = strrchr(shell, '/');
+    name = (name != NULL ? name + 1 : shell);
+
+    for(size_t index = 0; index < sizeof(POSIX_SHELLS) / sizeof(POSIX_SHELLS[0]); ++index) {
+        if(strcmp(name, POSIX_SHELLS[index]) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+
+BakeError tokenizeCommand(char * command, char *** out) {
+    *out = NULL;
+
+    // Stores the pointers to each argument as they are found
+    Buffer arguments;
+    BakeError err = buf_allocate(&arguments, 8 * sizeof(char *));
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Stores the characters of the argument currently being read
+    StringBuilder argument;
+    err = strbuilder_allocate(&argument, 64);
+    if(err != BAKE_SUCCESS) {
+        buf_free(&arguments);
+        return err;
+    }
+
+    // Whether we found something that needs the shell to execute this command
+    bool needsShell = false;
+
+    char * position = command;
+    while(!needsShell && err == BAKE_SUCCESS) {
+        // Skip the whitespace between arguments
+        while(isspace(*position)) {
+            position++;
+        }
+
+        if(*position == '\0')
+            break;
+
+        // Read the characters of this argument until the next unquoted whitespace
+        strbuilder_reset(&argument);
+        char * start = position;
+
+        while(!needsShell && err == BAKE_SUCCESS && *position != '\0' && !isspace(*position)) {
+            char ch = *position;
+
+            if(ch == '\'' || ch == '"') {
+                // Find the closing quote
+                char * end = strchr(position + 1, ch);
+                size_t length = (end != NULL ? (size_t) (end - position - 1) : 0);
+
+                // If there is no closing quote, or there are expansions or escapes within double quotes
+                if(end == NULL || (ch == '"' && strcspn(position + 1, "$`\\!") < length)) {
+                    needsShell = true;
+                    break;
+                }
+
+                // Append the contents of the quotes, without the quotes themselves
+                err = strbuilder_appendSubstring(&argument, position + 1, length);
+                position = end + 1;
+                continue;
+            }
+
+            if(isShellCharacter(ch)) {
+                needsShell = true;
+                break;
+            }
+
+            err = strbuilder_appendSubstring(&argument, position, 1);
+            position++;
+        }
+
+        if(needsShell || err != BAKE_SUCCESS)
+            break;
+
+        // The first word can't be a variable assignment, keyword or shell builtin
+        if(arguments.used == 0) {
+            size_t wordLength = (size_t) (position - start);
+            if(memchr(start, '=', wordLength) != NULL || isShellWord(strbuilder_get(&argument))) {
+                needsShell = true;
+                break;
+            }
+        }
+
+        // Copy the argument so we can keep it
+        char * copy = strdup(strbuilder_get(&argument));
+        if(copy == NULL) {
+            reportError("Unable to copy command argument: %s\n", strerror(errno));
+            err = BAKE_ERROR_MEMORY;
+            break;
+        }
+
+        err = buf_append(&arguments, &copy, sizeof(char *));
+        if(err != BAKE_SUCCESS) {
+            free(copy);
+        }
+    }
+
+    strbuilder_free(&argument);
+
+    // Commands without any arguments are left to the shell
+    if(!needsShell && err == BAKE_SUCCESS && arguments.used == 0) {
+        needsShell = true;
+    }
+
+    // Terminate the array of arguments with NULL
+    if(!needsShell && err == BAKE_SUCCESS) {
+        char * terminator = NULL;
+        err = buf_append(&arguments, &terminator, sizeof(char *));
+    }
+
+    // If we can't execute the command directly, free the arguments we found
+    if(needsShell || err != BAKE_SUCCESS) {
+        char ** found = buf_get(&arguments);
+        for(size_t index = 0; index < arguments.used / sizeof(char *); ++index) {
+            free(found[index]);
+        }
+
+        buf_free(&arguments);
+        return err;
+    }
+
+    // The arguments buffer's data is now owned by the caller
+    *out = buf_get(&arguments);
+    return BAKE_SUCCESS;
+}
+
+
+BakeError findProgram(StringMap * cache, char * name, char ** out) {
+    // If the name contains a slash, it is already a path to the program
+    if(strchr(name, '/') != NULL) {
+        *out = name;
+        return BAKE_SUCCESS;
+    }
+
+    // Check if we have already searched for this program. Programs
+    // that could not be found are stored with an empty path.
+    char * cached = strmap_get(cache, name);
+    if(cached != NULL) {
+        *out = (cached[0] != '\0' ? cached : NULL);
+        return BAKE_SUCCESS;
+    }
+
+    char * pathVariable = getenv("PATH");
+    if(pathVariable == NULL) {
+        pathVariable = DEFAULT_PATH;
+    }
+
+    // Look through each directory in PATH for an executable file with the program's name
+    char candidate[PATH_MAX];
+    char * found = NULL;
+    char * directory = pathVariable;
+    while(found == NULL) {
+        size_t directoryLength = strcspn(directory, ":");
+
+        // An empty directory in PATH refers to the current directory
+        int length;
+        if(directoryLength == 0) {
+            length = snprintf(candidate, sizeof(candidate), "%s", name);
+        } else {
+            length = snprintf(candidate, sizeof(candidate), "%.*s/%s", (int) directoryLength, directory, name);
+        }
+
+        struct stat result;
+        countStat(STAT_FILE_STATS, 1);
+        if(length > 0 && (size_t) length < sizeof(candidate)
+           && stat(candidate, &result) == 0 && S_ISREG(result.st_mode) && access(candidate, X_OK) == 0) {
+            found = candidate;
+            break;
+        }
+
+        // Move on to the next directory, if there is one
+        if(directory[directoryLength] == '\0')
+            break;
+
+        directory = &directory[directoryLength + 1];
+    }
+
+    // Store the path we found, or an empty path if there was none
+    char * key = strdup(name);
+    char * value = strdup(found != NULL ? found : "");
+    if(key == NULL || value == NULL) {
+        free(key);
+        free(value);
+        reportError("Unable to store path of program %s: %s\n", name, strerror(errno));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    BakeError err = strmap_put(cache, key, value);
+    if(err != BAKE_SUCCESS) {
+        free(key);
+        free(value);
+        return err;
+    }
+
+    *out = (value[0] != '\0' ? value : NULL);
+    return BAKE_SUCCESS;
+}
+
+
+BakeError appendShellQuoted(StringBuilder * builder, char * string) {
+    BakeError err = strbuilder_append(builder, "'");
+
+    // Single quotes can't be escaped within single quotes, so each is
+    // placed between the end of one quoted string and the start of another
+    while(err == BAKE_SUCCESS) {
+        size_t length = strcspn(string, "'");
+
+        err = strbuilder_appendSubstring(builder, string, length);
+        if(err != BAKE_SUCCESS || string[length] == '\0')
+            break;
+
+        err = strbuilder_append(builder, "'\\''");
+        string = &string[length + 1];
+    }
+
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    return strbuilder_append(builder, "'");
+}
+
+
+BakeError appendScript(BakeOptions options, Target * target, StringBuilder * builder) {
+    BakeError err = BAKE_SUCCESS;
+
+    // Get the action lines from the target
+    size_t actionCount = target_actionLineCount(target);
+    ActionLine * actions = target_getActionLines(target);
+
+    for(size_t index = 0; index < actionCount && err == BAKE_SUCCESS; ++index) {
+        ActionLine * action = &actions[index];
+
+        // Have the shell print the command just before it executes it, so it appears in order with the output
+        if(!options.silent && !action->skipPrinting) {
+            err = strbuilder_append(builder, "printf '%s\\n' ");
+            if(err == BAKE_SUCCESS) {
+                err = appendShellQuoted(builder, action->command);
+            }
+            if(err == BAKE_SUCCESS) {
+                err = strbuilder_append(builder, "\n");
+            }
+        }
+
+        // Execute the command on its own line
+        if(err == BAKE_SUCCESS) {
+            err = strbuilder_appendFormat(builder, "%s\n", action->command);
+        }
+
+        // If we care whether the command succeeded, report which line failed and stop the script if it didn't
+        if(err == BAKE_SUCCESS && options.requireSuccess && action->requireSuccess) {
+            err = strbuilder_appendFormat(builder,
+                    "bake_status=$?; if [ $bake_status -ne 0 ]; then echo %zu >&%i; exit $bake_status; fi\n",
+                    index, SCRIPT_STATUS_FD);
+        }
+    }
+
+    // Any failures we don't care about should not fail the script
+    if(err == BAKE_SUCCESS) {
+        err = strbuilder_append(builder, "exit 0\n");
+    }
+
+    return err;
+}
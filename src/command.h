@@ -0,0 +1,96 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === command ===
+//
+// Splits simple commands into their arguments so that they can be executed
+// directly, without starting a shell, and finds the programs they execute.
+//
+
+#ifndef CITS2002_COMMAND_H
+#define CITS2002_COMMAND_H
+
+#include <stdbool.h>
+#include "stringmap.h"
+#include "main.h"
+
+
+/**
+ * The shell used to execute commands if the bakefile does not set the SHELL variable.
+ */
+#define DEFAULT_SHELL  "/bin/bash"
+
+
+/**
+ * The PATH used to find programs if the PATH environment variable is not set.
+ */
+#define DEFAULT_PATH  "/usr/bin:/bin"
+
+
+/**
+ * The file descriptor that one shell scripts write the index of a failed action line to.
+ */
+#define SCRIPT_STATUS_FD  3
+
+
+/**
+ * @return whether {@param ch} has a special meaning to the shell outside of quotes,
+ *         such as for pipes, redirection, globs, expansions or separating commands
+ */
+bool isShellCharacter(char ch);
+
+
+/**
+ * @return whether {@param word} is a shell keyword, or a shell builtin with no equivalent program
+ */
+bool isShellWord(char * word);
+
+
+/**
+ * @return whether {@param shell} is a POSIX shell, which would execute simple commands
+ *         in the same way as executing their program directly
+ */
+bool isPosixShell(char * shell);
+
+
+/**
+ * Split {@param command} into its arguments, and place them into {@param out} as a newly
+ * allocated NULL terminated array of newly allocated strings.
+ *
+ * If the command uses any features of the shell, NULL will be placed into {@param out}.
+ * Arguments may be quoted, as long as the quotes contain no expansions or escapes.
+ */
+BakeError tokenizeCommand(char * command, char *** out);
+
+
+/**
+ * Find the path of the program {@param name} from the PATH environment variable, and place it into
+ * {@param out}, or NULL if no program could be found. Names that contain a '/' are used as is.
+ *
+ * Paths that are found are stored in {@param cache}, and re-used for the
+ * rest of the build instead of searching through PATH again.
+ */
+BakeError findProgram(StringMap * cache, char * name, char ** out);
+
+
+/**
+ * Append {@param string} into {@param builder} within single quotes, so that the shell reads it as is.
+ */
+BakeError appendShellQuoted(StringBuilder * builder, char * string);
+
+
+/**
+ * Append a shell script into {@param builder} that executes all the action lines of {@param target} in order.
+ *
+ * Each action line is printed before it is executed, unless it is silent. If an action line that requires
+ * success fails, the script writes the index of that action line to SCRIPT_STATUS_FD and exits with its
+ * exit status.
+ */
+BakeError appendScript(BakeOptions options, Target * target, StringBuilder * builder);
+
+
+#endif //CITS2002_COMMAND_H
@@ -0,0 +1,461 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "events.h"
+#include "files.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#else
+#include <poll.h>
+#endif
+
+
+/**
+ * The kinds of file descriptors registered with epoll, stored in the upper 32 bits of their epoll data.
+ */
+#define WATCH_FD      0
+#define WATCH_CHILD   1
+#define WATCH_SIGNAL  2
+
+
+#ifdef __linux__
+
+int openPidFD(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int) syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void) pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+
+BakeError addToEpoll(int epollFD, int fd, uint64_t kind) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = (kind << 32) | (uint32_t) fd;
+
+    if(epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &event) != 0) {
+        reportError("Unable to watch file descriptor %i: %s\n", fd, strerror(errno));
+        return BAKE_ERROR_IO;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+#else
+
+/**
+ * The pipe that is written to whenever SIGCHLD is received.
+ */
+static int childSignalPipe[2] = {-1, -1};
+
+
+void notifyChildExited(int signal) {
+    (void) signal;
+
+    int savedErrno = errno;
+    ssize_t written = write(childSignalPipe[PIPE_WRITE], "", 1);
+    (void) written;
+    errno = savedErrno;
+}
+
+#endif
+
+
+BakeError events_allocate(EventLoop * out) {
+    out->epollFD = -1;
+    out->usePidFDs = false;
+    out->signalFD = -1;
+    out->blockedSignals = false;
+    out->nextEvent = 0;
+
+    BakeError err = buf_allocate(&out->children, 8 * sizeof(WatchedChild));
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    err = buf_allocate(&out->fds, 8 * sizeof(int));
+    if(err != BAKE_SUCCESS) {
+        buf_free(&out->children);
+        return err;
+    }
+
+    err = buf_allocate(&out->events, 8 * sizeof(Event));
+    if(err != BAKE_SUCCESS) {
+        buf_free(&out->children);
+        buf_free(&out->fds);
+        return err;
+    }
+
+#ifdef __linux__
+    out->epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if(out->epollFD < 0) {
+        reportError("Unable to create epoll instance: %s\n", strerror(errno));
+        events_free(out);
+        return BAKE_ERROR_IO;
+    }
+
+    // Check whether the kernel supports pidfds, which were added in Linux 5.3
+    int pidFD = openPidFD(getpid());
+    if(pidFD >= 0) {
+        close(pidFD);
+        out->usePidFDs = true;
+        return BAKE_SUCCESS;
+    }
+
+    // Otherwise, block SIGCHLD so that it can be read through a signalfd instead
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+
+    int sigErr = pthread_sigmask(SIG_BLOCK, &signals, &out->previousMask);
+    if(sigErr != 0) {
+        reportError("Unable to block SIGCHLD: %s\n", strerror(sigErr));
+        events_free(out);
+        return BAKE_ERROR_UNKNOWN;
+    }
+
+    out->blockedSignals = true;
+    out->signalFD = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(out->signalFD < 0) {
+        reportError("Unable to create signalfd for SIGCHLD: %s\n", strerror(errno));
+        events_free(out);
+        return BAKE_ERROR_IO;
+    }
+
+    err = addToEpoll(out->epollFD, out->signalFD, WATCH_SIGNAL);
+    if(err != BAKE_SUCCESS) {
+        events_free(out);
+        return err;
+    }
+#else
+    // Create the pipe the SIGCHLD handler writes to, and install the handler, the first time a loop is created
+    if(childSignalPipe[PIPE_READ] < 0) {
+        err = createPipe(childSignalPipe);
+        if(err != BAKE_SUCCESS) {
+            events_free(out);
+            return err;
+        }
+
+        fcntl(childSignalPipe[PIPE_READ], F_SETFL, O_NONBLOCK);
+        fcntl(childSignalPipe[PIPE_WRITE], F_SETFL, O_NONBLOCK);
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = notifyChildExited;
+        action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+        sigemptyset(&action.sa_mask);
+
+        if(sigaction(SIGCHLD, &action, NULL) != 0) {
+            reportError("Unable to handle SIGCHLD: %s\n", strerror(errno));
+            events_free(out);
+            return BAKE_ERROR_UNKNOWN;
+        }
+    }
+
+    out->signalFD = childSignalPipe[PIPE_READ];
+#endif
+
+    return BAKE_SUCCESS;
+}
+
+
+void events_free(EventLoop * loop) {
+    // Close the pidfds of any children that haven't exited
+    size_t childCount = loop->children.used / sizeof(WatchedChild);
+    WatchedChild * children = buf_get(&loop->children);
+    for(size_t index = 0; index < childCount; ++index) {
+        if(children[index].pidFD >= 0) {
+            close(children[index].pidFD);
+        }
+    }
+
+#ifdef __linux__
+    if(loop->signalFD >= 0) {
+        close(loop->signalFD);
+    }
+
+    if(loop->blockedSignals) {
+        pthread_sigmask(SIG_SETMASK, &loop->previousMask, NULL);
+    }
+
+    if(loop->epollFD >= 0) {
+        close(loop->epollFD);
+    }
+#endif
+
+    loop->epollFD = -1;
+    loop->signalFD = -1;
+    loop->blockedSignals = false;
+
+    buf_free(&loop->children);
+    buf_free(&loop->fds);
+    buf_free(&loop->events);
+}
+
+
+BakeError events_watchChild(EventLoop * loop, pid_t pid) {
+    WatchedChild child;
+    child.pid = pid;
+    child.pidFD = -1;
+
+#ifdef __linux__
+    if(loop->usePidFDs) {
+        child.pidFD = openPidFD(pid);
+        if(child.pidFD < 0) {
+            reportError("Unable to open pidfd for process %i: %s\n", pid, strerror(errno));
+            return BAKE_ERROR_EXECUTION;
+        }
+
+        BakeError err = addToEpoll(loop->epollFD, child.pidFD, WATCH_CHILD);
+        if(err != BAKE_SUCCESS) {
+            close(child.pidFD);
+            return err;
+        }
+    }
+#endif
+
+    BakeError err = buf_append(&loop->children, &child, sizeof(WatchedChild));
+    if(err != BAKE_SUCCESS && child.pidFD >= 0) {
+        close(child.pidFD);
+    }
+
+    return err;
+}
+
+
+BakeError events_watchFD(EventLoop * loop, int fd) {
+#ifdef __linux__
+    BakeError err = addToEpoll(loop->epollFD, fd, WATCH_FD);
+    if(err != BAKE_SUCCESS)
+        return err;
+#endif
+
+    return buf_append(&loop->fds, &fd, sizeof(int));
+}
+
+
+void events_unwatchFD(EventLoop * loop, int fd) {
+#ifdef __linux__
+    epoll_ctl(loop->epollFD, EPOLL_CTL_DEL, fd, NULL);
+#endif
+
+    // Remove the file descriptor by moving the last file descriptor into its place
+    size_t fdCount = loop->fds.used / sizeof(int);
+    int * fds = buf_get(&loop->fds);
+    for(size_t index = 0; index < fdCount; ++index) {
+        if(fds[index] == fd) {
+            fds[index] = fds[fdCount - 1];
+            loop->fds.used -= sizeof(int);
+            break;
+        }
+    }
+
+    // Forget any events for the file descriptor that haven't been returned
+    size_t eventCount = loop->events.used / sizeof(Event);
+    Event * events = buf_get(&loop->events);
+    for(size_t index = loop->nextEvent; index < eventCount; ++index) {
+        if(events[index].type == EVENT_READABLE && events[index].fd == fd) {
+            events[index].type = EVENT_NONE;
+        }
+    }
+}
+
+
+BakeError events_wait(EventLoop * loop, double timeout, Event * out) {
+    BakeError err;
+    out->type = EVENT_NONE;
+
+    // If we're notified through SIGCHLD, check for children that exited before we started watching them
+    if(!loop->usePidFDs && loop->nextEvent * sizeof(Event) == loop->events.used) {
+        err = events_reapChildren(loop);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    // Only wait if there are no events left to return
+    if(loop->nextEvent * sizeof(Event) == loop->events.used) {
+        buf_reset(&loop->events);
+        loop->nextEvent = 0;
+
+        int timeoutMillis = (timeout < 0 ? -1 : (int) (timeout * 1000));
+
+#ifdef __linux__
+        struct epoll_event ready[EVENT_BATCH_SIZE];
+        int readyCount = epoll_wait(loop->epollFD, ready, EVENT_BATCH_SIZE, timeoutMillis);
+        if(readyCount < 0 && errno != EINTR) {
+            reportError("Unable to wait for events: %s\n", strerror(errno));
+            return BAKE_ERROR_IO;
+        }
+
+        for(int index = 0; index < readyCount; ++index) {
+            uint64_t kind = ready[index].data.u64 >> 32;
+            int fd = (int) (ready[index].data.u64 & 0xFFFFFFFF);
+
+            if(kind == WATCH_FD) {
+                Event event;
+                event.type = EVENT_READABLE;
+                event.fd = fd;
+                err = events_push(loop, event);
+            } else if(kind == WATCH_CHILD) {
+                // Find the child that this pidfd refers to
+                size_t childCount = loop->children.used / sizeof(WatchedChild);
+                WatchedChild * children = buf_get(&loop->children);
+                size_t child = 0;
+                while(child < childCount && children[child].pidFD != fd) {
+                    child += 1;
+                }
+
+                bool exited;
+                err = (child < childCount ? events_reapChild(loop, child, &exited) : BAKE_SUCCESS);
+            } else {
+                drainFD(loop->signalFD);
+                err = events_reapChildren(loop);
+            }
+
+            if(err != BAKE_SUCCESS)
+                return err;
+        }
+#else
+        // Poll all the watched file descriptors, followed by the SIGCHLD pipe
+        size_t fdCount = loop->fds.used / sizeof(int);
+        int * fds = buf_get(&loop->fds);
+
+        struct pollfd * polled = calloc(fdCount + 1, sizeof(struct pollfd));
+        if(polled == NULL) {
+            reportError("Unable to allocate memory to wait for events\n");
+            return BAKE_ERROR_MEMORY;
+        }
+
+        for(size_t index = 0; index < fdCount; ++index) {
+            polled[index].fd = fds[index];
+            polled[index].events = POLLIN;
+        }
+
+        polled[fdCount].fd = loop->signalFD;
+        polled[fdCount].events = POLLIN;
+
+        int readyCount = poll(polled, (nfds_t) (fdCount + 1), timeoutMillis);
+        if(readyCount < 0 && errno != EINTR) {
+            reportError("Unable to wait for events: %s\n", strerror(errno));
+            free(polled);
+            return BAKE_ERROR_IO;
+        }
+
+        err = BAKE_SUCCESS;
+        for(size_t index = 0; readyCount > 0 && index < fdCount && err == BAKE_SUCCESS; ++index) {
+            if(polled[index].revents == 0)
+                continue;
+
+            Event event;
+            event.type = EVENT_READABLE;
+            event.fd = polled[index].fd;
+            err = events_push(loop, event);
+        }
+
+        if(readyCount > 0 && err == BAKE_SUCCESS && polled[fdCount].revents != 0) {
+            drainFD(loop->signalFD);
+            err = events_reapChildren(loop);
+        }
+
+        free(polled);
+        if(err != BAKE_SUCCESS)
+            return err;
+#endif
+    }
+
+    // Return the next event that hasn't been forgotten
+    size_t eventCount = loop->events.used / sizeof(Event);
+    Event * events = buf_get(&loop->events);
+    while(loop->nextEvent < eventCount && out->type == EVENT_NONE) {
+        *out = events[loop->nextEvent++];
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError events_push(EventLoop * loop, Event event) {
+    return buf_append(&loop->events, &event, sizeof(Event));
+}
+
+
+BakeError events_reapChildren(EventLoop * loop) {
+    size_t index = 0;
+    while(index < loop->children.used / sizeof(WatchedChild)) {
+        bool exited;
+        BakeError err = events_reapChild(loop, index, &exited);
+        if(err != BAKE_SUCCESS)
+            return err;
+
+        // If the child exited, another child has been moved into its place
+        if(!exited) {
+            index += 1;
+        }
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError events_reapChild(EventLoop * loop, size_t index, bool * exited) {
+    size_t childCount = loop->children.used / sizeof(WatchedChild);
+    WatchedChild * children = buf_get(&loop->children);
+    WatchedChild child = children[index];
+
+    // Check whether the child has exited without blocking, collecting the resources it used if it has
+    Event event;
+    pid_t result = wait4(child.pid, &event.waitStatus, WNOHANG, &event.resources);
+    if(result < 0 && errno == EINTR) {
+        *exited = false;
+        return BAKE_SUCCESS;
+    }
+
+    if(result < 0) {
+        reportError("Unable to wait for process %i to complete: %s\n", child.pid, strerror(errno));
+        return BAKE_ERROR_EXECUTION;
+    }
+
+    *exited = (result == child.pid);
+    if(!*exited)
+        return BAKE_SUCCESS;
+
+    // Stop watching the child by moving the last child into its place
+    if(child.pidFD >= 0) {
+        close(child.pidFD);
+    }
+
+    children[index] = children[childCount - 1];
+    loop->children.used -= sizeof(WatchedChild);
+
+    event.type = EVENT_CHILD_EXITED;
+    event.pid = child.pid;
+    return events_push(loop, event);
+}
+
+
+void drainFD(int fd) {
+    char buf[256];
+    while(read(fd, buf, sizeof(buf)) > 0) {
+        // Discard the data
+    }
+}
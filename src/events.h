@@ -0,0 +1,245 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === events ===
+//
+// An event loop that waits for any of many child processes to exit, or for any of many
+// file descriptors to become readable, without blocking on any one of them.
+//
+// On Linux the loop is built on epoll, and is notified of each child's exit through its
+// pidfd, or through a signalfd for SIGCHLD if pidfds aren't supported. On other systems
+// it uses poll, and a pipe that is written to by a SIGCHLD handler.
+//
+
+#ifndef CITS2002_EVENTS_H
+#define CITS2002_EVENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "errors.h"
+#include "buffer.h"
+
+
+/**
+ * The maximum number of events to read from the system at once.
+ */
+#define EVENT_BATCH_SIZE  32
+
+
+/**
+ * The kinds of events that can be returned from an EventLoop.
+ */
+typedef enum {
+    /**
+     * Nothing happened before the timeout.
+     */
+    EVENT_NONE,
+
+    /**
+     * A watched child process exited. It has already been reaped, and the resources it used collected.
+     */
+    EVENT_CHILD_EXITED,
+
+    /**
+     * A watched file descriptor has data to be read, or has been closed.
+     */
+    EVENT_READABLE
+} EventType;
+
+
+/**
+ * Something that happened that an EventLoop was watching for.
+ */
+typedef struct {
+    /**
+     * What happened.
+     */
+    EventType type;
+
+    /**
+     * The child process that exited, if type is EVENT_CHILD_EXITED.
+     */
+    pid_t pid;
+
+    /**
+     * The status of the child process reported by waitpid, if type is EVENT_CHILD_EXITED.
+     */
+    int waitStatus;
+
+    /**
+     * The resources used by the child process and its reaped children, if type is EVENT_CHILD_EXITED.
+     */
+    struct rusage resources;
+
+    /**
+     * The file descriptor that became readable, if type is EVENT_READABLE.
+     */
+    int fd;
+} Event;
+
+
+/**
+ * A child process watched by an EventLoop.
+ */
+typedef struct {
+    /**
+     * The ID of the child process.
+     */
+    pid_t pid;
+
+    /**
+     * A pidfd referring to the child process that becomes readable when it exits, or -1 if not using pidfds.
+     */
+    int pidFD;
+} WatchedChild;
+
+
+/**
+ * Waits for child processes to exit, and for file descriptors to become readable.
+ */
+typedef struct {
+    /**
+     * The epoll instance all the watched file descriptors are registered with, or -1 if not using epoll.
+     */
+    int epollFD;
+
+    /**
+     * Whether each child is watched through its own pidfd.
+     */
+    bool usePidFDs;
+
+    /**
+     * If not using pidfds, the file descriptor that becomes readable when SIGCHLD is received. Otherwise -1.
+     */
+    int signalFD;
+
+    /**
+     * The signal mask to restore when the loop is freed, if SIGCHLD was blocked to be read from signalFD.
+     */
+    sigset_t previousMask;
+
+    /**
+     * Whether SIGCHLD was blocked, and previousMask must be restored.
+     */
+    bool blockedSignals;
+
+    /**
+     * A buffer containing a list of the WatchedChild's that haven't exited yet.
+     */
+    Buffer children;
+
+    /**
+     * A buffer containing a list of the file descriptors watched for reading.
+     */
+    Buffer fds;
+
+    /**
+     * A buffer containing a list of Event's that have happened, and not yet been returned.
+     */
+    Buffer events;
+
+    /**
+     * The index of the first event in events that has not been returned.
+     */
+    size_t nextEvent;
+} EventLoop;
+
+
+/**
+ * Allocate a new EventLoop, and place it into {@param out}.
+ */
+BakeError events_allocate(EventLoop * out);
+
+
+/**
+ * Free the resources of {@param loop} and mark it as invalid. Children that are
+ * still being watched are not waited for, and watched file descriptors are not closed.
+ */
+void events_free(EventLoop * loop);
+
+
+/**
+ * Watch for the child process {@param pid} to exit. It will be reaped by {@param loop} when it does.
+ */
+BakeError events_watchChild(EventLoop * loop, pid_t pid);
+
+
+/**
+ * Watch for the file descriptor {@param fd} to become readable.
+ */
+BakeError events_watchFD(EventLoop * loop, int fd);
+
+
+/**
+ * Stop watching the file descriptor {@param fd}. This must be done before {@param fd} is closed.
+ */
+void events_unwatchFD(EventLoop * loop, int fd);
+
+
+/**
+ * Wait for up to {@param timeout} seconds, or forever if {@param timeout} is negative, for one
+ * of the children or file descriptors watched by {@param loop} to exit or become readable, and
+ * place what happened into {@param out}. If nothing happened, EVENT_NONE is placed into {@param out}.
+ */
+BakeError events_wait(EventLoop * loop, double timeout, Event * out);
+
+
+/**
+ * Add the event {@param event} to the events of {@param loop} that are yet to be returned.
+ */
+BakeError events_push(EventLoop * loop, Event event);
+
+
+/**
+ * Reap each of the children watched by {@param loop} that have exited, adding an event for each.
+ */
+BakeError events_reapChildren(EventLoop * loop);
+
+
+/**
+ * Reap the child {@param index} of the children of {@param loop}, adding an event for it and no
+ * longer watching it if it has exited. Places whether it had exited into {@param exited}.
+ */
+BakeError events_reapChild(EventLoop * loop, size_t index, bool * exited);
+
+
+/**
+ * Read everything available from the file descriptor {@param fd}, which must be non-blocking, and discard it.
+ */
+void drainFD(int fd);
+
+
+#ifdef __linux__
+
+/**
+ * Open a pidfd for the process {@param pid}.
+ *
+ * @return the pidfd, or -1 with errno set if it could not be opened
+ */
+int openPidFD(pid_t pid);
+
+
+/**
+ * Register {@param fd} with the epoll instance {@param epollFD} to be watched for reading, tagged as {@param kind}.
+ */
+BakeError addToEpoll(int epollFD, int fd, uint64_t kind);
+
+#else
+
+/**
+ * Handles SIGCHLD by writing to the pipe the event loop polls, so that the event loop wakes up.
+ */
+void notifyChildExited(int signal);
+
+#endif
+
+
+#endif //CITS2002_EVENTS_H
@@ -3,164 +3,577 @@
    Student number(s):	22494652
 */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <zconf.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <stdlib.h>
 #include "execution.h"
 #include "files.h"
 
 
-BakeError executeCommand(char * command, StringBuilder * output, int * exitStatus) {
-    int pipeFDs[2]; // Stores the file descriptors if we open a pipe to retrieve the stdout output
-    int err;        // Stores any errors that could occur in this method
+/**
+ * The environment of bake, which is passed on to the commands it executes.
+ */
+extern char ** environ;
 
-    // If we are storing the output, create a pipe so we can get the output of the command
-    if(output != NULL) {
-        err = pipe(pipeFDs);
+
+/**
+ * The size of the buffer used to read the output of jobs.
+ */
+#define JOB_OUTPUT_BUFFER_SIZE  4096
+
+
+BakeError scheduler_allocate(Scheduler * out, BakeOptions options, Bakefile bakefile) {
+    out->nextOrder = 0;
+    out->usedSlots = 0;
+    out->state = NULL;
+    out->jobServer = NULL;
+    out->statCache = NULL;
+    out->freshness = options.freshness;
+    limit_initialise(&out->limit, options);
+
+    // When running jobs in parallel, start the targets on the longest chains of targets first
+    out->criticalPathFirst = (out->limit.automatic || out->limit.maxJobs > 1);
+    out->stopping = false;
+    out->interrupted = false;
+
+    // Simple commands are only executed directly if the shell would have executed them the same way
+    out->shell = bakefile.shell;
+    out->posixShell = isPosixShell(bakefile.shell);
+
+    // Allocate a queue to hold the targets that are ready to be executed
+    BakeError err = tqueue_allocate(&out->ready, 16);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Allocate a buffer to hold the jobs that are executing
+    err = buf_allocate(&out->jobs, 4 * sizeof(Job));
+    if(err != BAKE_SUCCESS) {
+        tqueue_free(&out->ready);
+        return err;
+    }
+
+    // Allocate a map to cache the paths of the programs that are executed
+    err = strmap_allocate(&out->programPaths, 16);
+    if(err != BAKE_SUCCESS) {
+        tqueue_free(&out->ready);
+        buf_free(&out->jobs);
+        return err;
+    }
+
+    // Allocate a buffer to hold the targets that are prepared
+    err = buf_allocate(&out->targets, 16 * sizeof(Target *));
+    if(err != BAKE_SUCCESS) {
+        tqueue_free(&out->ready);
+        buf_free(&out->jobs);
+        strmap_free(&out->programPaths);
+        return err;
+    }
+
+    // Allocate a buffer to hold the targets that fail
+    err = buf_allocate(&out->failures, 4 * sizeof(Target *));
+    if(err != BAKE_SUCCESS) {
+        tqueue_free(&out->ready);
+        buf_free(&out->jobs);
+        strmap_free(&out->programPaths);
+        buf_free(&out->targets);
+        return err;
+    }
+
+    // Allocate a buffer to hold the ready targets that are held back
+    err = buf_allocate(&out->blocked, 4 * sizeof(Target *));
+    if(err != BAKE_SUCCESS) {
+        tqueue_free(&out->ready);
+        buf_free(&out->jobs);
+        strmap_free(&out->programPaths);
+        buf_free(&out->targets);
+        buf_free(&out->failures);
+        return err;
+    }
+
+    // Allocate a report to hold the resources used by the commands that are executed
+    err = usage_allocate(&out->usage);
+    if(err != BAKE_SUCCESS) {
+        tqueue_free(&out->ready);
+        buf_free(&out->jobs);
+        strmap_free(&out->programPaths);
+        buf_free(&out->targets);
+        buf_free(&out->failures);
+        buf_free(&out->blocked);
+        return err;
+    }
+
+    // Create the event loop used to wait for the processes of jobs to exit
+    err = events_allocate(&out->events);
+    if(err != BAKE_SUCCESS) {
+        tqueue_free(&out->ready);
+        buf_free(&out->jobs);
+        strmap_free(&out->programPaths);
+        buf_free(&out->targets);
+        buf_free(&out->failures);
+        buf_free(&out->blocked);
+        usage_free(&out->usage);
+        return err;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+void scheduler_free(Scheduler * scheduler) {
+    tqueue_free(&scheduler->ready);
+    buf_free(&scheduler->jobs);
+    strmap_free(&scheduler->programPaths);
+    buf_free(&scheduler->targets);
+    buf_free(&scheduler->failures);
+    buf_free(&scheduler->blocked);
+    usage_free(&scheduler->usage);
+    events_free(&scheduler->events);
+}
+
+
+size_t scheduler_jobCount(Scheduler * scheduler) {
+    // Return the number of Job's that are in the used data of the jobs buffer
+    return scheduler->jobs.used / sizeof(Job);
+}
+
+
+Job * scheduler_getJobs(Scheduler * scheduler) {
+    // Return the jobs array, which contains an array of Job's
+    return buf_get(&scheduler->jobs);
+}
+
+
+Redirections noRedirections(void) {
+    Redirections redirections;
+    redirections.input = -1;
+    redirections.output = -1;
+    redirections.error = -1;
+    redirections.status = -1;
+    return redirections;
+}
+
+
+BakeError startProgram(char * program, char ** arguments, Redirections redirections, bool newGroup,
+                       Target * target, pid_t * pid, int * spawnError) {
+    // posix_spawn can't give the new process a nice level or CPU affinity, so processes that need them are forked
+    if(target != NULL && hasPoolSettings(target))
+        return forkProgram(program, arguments, redirections, newGroup, target, pid, spawnError);
+
+    // Flush anything we've printed, so that it appears before the output of the program
+    fflush(stdout);
+    *pid = -1;
+    *spawnError = 0;
+
+    // Start the new process without any signals blocked, even if we have blocked SIGCHLD to read it from a signalfd
+    posix_spawnattr_t attributes;
+    int err = posix_spawnattr_init(&attributes);
+    if(err != 0) {
+        reportError("Unable to prepare process to execute %s: %s\n", program, strerror(err));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attributes, &signals);
+
+    short flags = POSIX_SPAWN_SETSIGMASK;
+    if(newGroup) {
+        // A process group of 0 gives the process a new group with the same ID as itself
+        posix_spawnattr_setpgroup(&attributes, 0);
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+
+    posix_spawnattr_setflags(&attributes, flags);
+
+    // The redirections to perform in the new process before the program is executed
+    posix_spawn_file_actions_t fileActions;
+    err = posix_spawn_file_actions_init(&fileActions);
+    if(err != 0) {
+        posix_spawnattr_destroy(&attributes);
+        reportError("Unable to prepare process to execute %s: %s\n", program, strerror(err));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    // Redirect each of the file descriptors of the new process that we've been given. The file descriptors
+    // we're given are marked close-on-exec, so only their duplicates will be left open in the new process.
+    int sources[] = {redirections.input, redirections.output, redirections.error, redirections.status};
+    int destinations[] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, SCRIPT_STATUS_FD};
+
+    for(size_t index = 0; index < sizeof(sources) / sizeof(sources[0]); ++index) {
+        if(sources[index] < 0)
+            continue;
+
+        err = posix_spawn_file_actions_adddup2(&fileActions, sources[index], destinations[index]);
         if(err != 0) {
-            reportError("Unable to create pipe to retrieve output of command %s: %s\n", command, strerror(errno));
+            posix_spawn_file_actions_destroy(&fileActions);
+            posix_spawnattr_destroy(&attributes);
+            reportError("Unable to redirect file descriptor %i of new process: %s\n",
+                        destinations[index], strerror(err));
             return BAKE_ERROR_IO;
         }
     }
 
-    // Fork the process
-    pid_t childPID = fork();
+    // Start the program! posix_spawn avoids copying the memory of bake into the new process,
+    // which fork would have done just for it to be thrown away when the program is executed.
+    err = posix_spawn(pid, program, &fileActions, &attributes, arguments, environ);
 
-    // If there was an error forking the process
-    if(childPID < 0) {
-        reportError("Unable to fork process to execute command %s: %s\n", command, strerror(errno));
+    posix_spawn_file_actions_destroy(&fileActions);
+    posix_spawnattr_destroy(&attributes);
+
+    // If there was an error starting the process, leave it to the caller to report
+    if(err != 0) {
+        *pid = -1;
+        *spawnError = err;
         return BAKE_ERROR_EXECUTION;
     }
 
-    // This is the child process
-    if(childPID == 0) {
-        // If we are storing the output, redirect stdout of this child process to the pipe we created
-        if(output != NULL) {
-            // We don't need the READ end of the pipe on the child end, so close it.
-            close(pipeFDs[PIPE_READ]);
+    countStat(STAT_PROCESSES, 1);
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError forkProgram(char * program, char ** arguments, Redirections redirections, bool newGroup,
+                      Target * target, pid_t * pid, int * spawnError) {
+    // Flush anything we've printed, so that it appears before the output of the program
+    fflush(stdout);
+    *pid = -1;
+    *spawnError = 0;
+
+    // The new process writes back any step that fails before the program is executed. Both ends
+    // of the pipe are close-on-exec, so it is closed in the new process once the program starts.
+    int failureFDs[2];
+    BakeError err = createPipe(failureFDs);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    size_t costCount = target_poolCostCount(target);
+    PoolCost * costs = target_getPoolCosts(target);
+
+    // Block all signals until the program is executed, so that bake's handlers never run in the new process
+    sigset_t signals;
+    sigset_t previousSignals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previousSignals);
+
+    pid_t child = fork();
+    if(child == 0) {
+        // Only calls that are safe to make after fork may be made until the program is executed
+        ChildFailure failure;
+        ssize_t written;
+
+        if(newGroup) {
+            setpgid(0, 0);
+        }
+
+        // Apply the settings of the pools of the target, carrying on if they fail
+        for(size_t index = 0; index < costCount; ++index) {
+            failure.poolIndex = index;
+
+            failure.step = CHILD_STEP_NICE;
+            failure.error = jobpool_applyNice(costs[index].pool);
+            if(failure.error != 0) {
+                written = write(failureFDs[PIPE_WRITE], &failure, sizeof(failure));
+            }
+
+            failure.step = CHILD_STEP_AFFINITY;
+            failure.error = jobpool_applyAffinity(costs[index].pool);
+            if(failure.error != 0) {
+                written = write(failureFDs[PIPE_WRITE], &failure, sizeof(failure));
+            }
+        }
+
+        // Redirect the file descriptors we've been given. Those already in place are kept open for the program.
+        int sources[] = {redirections.input, redirections.output, redirections.error, redirections.status};
+        int destinations[] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, SCRIPT_STATUS_FD};
+
+        failure.step = CHILD_STEP_EXECUTE;
+        failure.poolIndex = 0;
+        failure.error = 0;
+
+        for(size_t index = 0; index < sizeof(sources) / sizeof(sources[0]) && failure.error == 0; ++index) {
+            if(sources[index] < 0)
+                continue;
 
-            // Make stdout write to the pipe we created
-            err = dup2(pipeFDs[PIPE_WRITE], fileno(stdout));
-            if(err < 0) {
-                reportError("Unable to point stdout to the created pipe: %s\n", strerror(errno));
-                return BAKE_ERROR_IO;
+            int result;
+            if(sources[index] == destinations[index]) {
+                result = fcntl(destinations[index], F_SETFD, 0);
+            } else {
+                result = dup2(sources[index], destinations[index]);
             }
 
-            // stdout now points to the write end of our pipe, so we
-            // can close the duplicated write end of the pipe as well
-            close(pipeFDs[PIPE_WRITE]);
+            if(result < 0) {
+                failure.error = errno;
+            }
+        }
+
+        // Start the program without any signals blocked, as with posix_spawn
+        if(failure.error == 0) {
+            sigemptyset(&signals);
+            pthread_sigmask(SIG_SETMASK, &signals, NULL);
+
+            execve(program, arguments, environ);
+            failure.error = errno;
+        }
+
+        written = write(failureFDs[PIPE_WRITE], &failure, sizeof(failure));
+        (void) written;
+        _exit(127);
+    }
+
+    int forkError = errno;
+    pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+    close(failureFDs[PIPE_WRITE]);
+
+    if(child < 0) {
+        close(failureFDs[PIPE_READ]);
+        *spawnError = forkError;
+        return BAKE_ERROR_EXECUTION;
+    }
+
+    // Read the steps that failed, until the program is executed or the new process exits
+    ChildFailure failure;
+    ssize_t bytesRead;
+    while((bytesRead = read(failureFDs[PIPE_READ], &failure, sizeof(failure))) != 0) {
+        if(bytesRead < 0) {
+            if(errno == EINTR)
+                continue;
+
+            break;
+        }
+
+        if(failure.step == CHILD_STEP_EXECUTE) {
+            *spawnError = failure.error;
+            continue;
+        }
+
+        // Settings that can't be applied, such as a negative nice level without permission, only
+        // affect how the process is scheduled. Don't try them again, so that they are only reported once.
+        JobPool * pool = costs[failure.poolIndex].pool;
+        if(failure.step == CHILD_STEP_NICE && pool->nice != 0) {
+            reportError("Warning: Unable to set the nice level of %s to %i: %s\n",
+                        target->name, pool->nice, strerror(failure.error));
+            pool->nice = 0;
+        } else if(failure.step == CHILD_STEP_AFFINITY && pool->affinity.used > 0) {
+            reportError("Warning: Unable to restrict %s to the CPUs of its pool: %s\n",
+                        target->name, strerror(failure.error));
+            pool->affinity.used = 0;
         }
+    }
 
-        // Execute the command!
-        execl("/bin/bash", "/bin/bash", "-c", command, (char *) NULL);
+    close(failureFDs[PIPE_READ]);
 
-        // execl should have taken over control of this process, reaching this point is an error
-        fprintf(stderr, "Control flow reached passed execl call: %s\n", strerror(errno));
+    // If the program couldn't be executed, the new process has already exited, and is left to the caller to report
+    if(*spawnError != 0) {
+        waitpid(child, NULL, 0);
         return BAKE_ERROR_EXECUTION;
     }
 
+    *pid = child;
+    countStat(STAT_PROCESSES, 1);
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError spawnProgram(char * program, char ** arguments, Redirections redirections, bool newGroup,
+                       Target * target, pid_t * pid) {
+    int spawnError;
+    BakeError err = startProgram(program, arguments, redirections, newGroup, target, pid, &spawnError);
+    if(spawnError != 0) {
+        reportError("Unable to start process to execute %s: %s\n", program, strerror(spawnError));
+    }
+
+    return err;
+}
+
+
+BakeError spawnCommand(char * shell, char * command, Redirections redirections, bool newGroup,
+                       Target * target, pid_t * pid) {
+    // Execute the command using the shell
+    char * arguments[] = {shell, "-c", command, NULL};
+
+    BakeError err = spawnProgram(shell, arguments, redirections, newGroup, target, pid);
+    if(err != BAKE_SUCCESS) {
+        reportError(" .. while executing command %s\n", command);
+    }
+
+    return err;
+}
+
+
+BakeError spawnActionLine(Scheduler * scheduler, Target * target, ActionLine * action, Redirections redirections,
+                          pid_t * pid) {
+    // If the command needs a shell, execute it using the shell. The options and escapes of echo differ
+    // between shells and the echo program, so any echo the builtin leaves to us is executed by the shell.
+    if(action->arguments == NULL || !scheduler->posixShell || strcmp(action->arguments[0], "echo") == 0)
+        return spawnCommand(scheduler->shell, action->command, redirections, true, target, pid);
+
+    // Find the program the command executes
+    char * program;
+    BakeError err = findProgram(&scheduler->programPaths, action->arguments[0], &program);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // If the program couldn't be found, leave it to the shell to report the error
+    if(program == NULL)
+        return spawnCommand(scheduler->shell, action->command, redirections, true, target, pid);
+
+    // Otherwise, execute the program directly
+    int spawnError;
+    err = startProgram(program, action->arguments, redirections, true, target, pid, &spawnError);
+
+    // A script without a #! line, or a program that is missing or can't be executed, is left to the
+    // shell. It runs scripts itself, and reports the others with the exit statuses 126 and 127, which
+    // the '-' modifier, -i and -k then treat the same as any other failed command.
+    if(spawnError == ENOEXEC || spawnError == EACCES || spawnError == ENOENT)
+        return spawnCommand(scheduler->shell, action->command, redirections, true, target, pid);
+
+    if(spawnError != 0) {
+        reportError("Unable to start process to execute %s: %s\n", program, strerror(spawnError));
+    }
+
+    return err;
+}
+
+
+int commandExitStatus(int waitStatus) {
+    // If the command was terminated by a signal, report it the same way as the shell does
+    if(WIFSIGNALED(waitStatus))
+        return 128 + WTERMSIG(waitStatus);
+
+    return WEXITSTATUS(waitStatus);
+}
+
+
+BakeError executeCommand(char * command, StringBuilder * output, int * exitStatus) {
+    // Stores when the command was started, for the trace of the build
+    double start = monotonicTime();
+
+    int pipeFDs[2]; // Stores the file descriptors if we open a pipe to retrieve the stdout output
+
+    // If we are storing the output, create a pipe so we can get the output of the command
+    if(output != NULL) {
+        BakeError bakeErr = createPipe(pipeFDs);
+        if(bakeErr != BAKE_SUCCESS) {
+            reportError(" .. while retrieving the output of command %s\n", command);
+            return bakeErr;
+        }
+    }
+
+    // Start the command, writing its output to the WRITE end of the pipe if we are storing it
+    Redirections redirections = noRedirections();
+    if(output != NULL) {
+        redirections.output = pipeFDs[PIPE_WRITE];
+    }
+
+    pid_t childPID;
+    BakeError bakeErr = spawnCommand(DEFAULT_SHELL, command, redirections, false, NULL, &childPID);
+
     // If we are storing the output, read it from the pipe and place it into output
     if(output != NULL) {
         // We don't need the WRITE end of the pipe on the parent end, so close it.
         close(pipeFDs[PIPE_WRITE]);
 
-        // Read the contents of the pipe into output
-        BakeError bakeErr = readPipeContents(pipeFDs[PIPE_READ], output);
+        // Read the contents of the pipe into output, if the command was started
+        if(bakeErr == BAKE_SUCCESS) {
+            bakeErr = readPipeContents(pipeFDs[PIPE_READ], output);
+            if(bakeErr != BAKE_SUCCESS) {
+                reportError("Error reading command output...\n");
+            }
+        }
 
         // Close the READ end of the pipe
         close(pipeFDs[PIPE_READ]);
-
-        // Check if there was an error reading the contents of the pipe
-        if(bakeErr != BAKE_SUCCESS) {
-            reportError("Error reading command output...\n");
-            return bakeErr;
-        }
     }
 
-    // Wait for the child process to complete
-    int completeStatus;
-    pid_t completedPID = wait(&completeStatus);
+    // If we couldn't start the command, there is nothing to wait for
+    if(childPID < 0)
+        return bakeErr;
 
-    // Check that the right process completed
+    // Wait for the child process to complete. Other commands may be
+    // executing concurrently, so we only wait for the one we started.
+    int completeStatus;
+    pid_t completedPID = waitpid(childPID, &completeStatus, 0);
     if(completedPID != childPID) {
-        reportError("Unknown child process %i completed while waiting for process %i to complete\n",
-                    completedPID, childPID);
+        reportError("Unable to wait for process %i to complete: %s\n", childPID, strerror(errno));
         return BAKE_ERROR_EXECUTION;
     }
 
-    // Check that the child process exited normally, and that it completed successfully
-    *exitStatus = WEXITSTATUS(completeStatus);
+    // Check if there was an error reading the output of the command
+    if(bakeErr != BAKE_SUCCESS)
+        return bakeErr;
+
+    // Find the exit status of the command
+    *exitStatus = commandExitStatus(completeStatus);
+    trace_span(trace_currentLane(), "command", "command", command, start, monotonicTime());
 
     // We successfully ran the command! Although, the command may not have been successful itself.
     return BAKE_SUCCESS;
 }
 
 
-BakeError executeTargetDependency(BakeOptions options, Bakefile bakefile, Target * target, bool * executed) {
+BakeError prepareTargetDependency(BakeOptions options, Bakefile bakefile, Scheduler * scheduler,
+                                  Target * target, Target * dependency) {
     // Stores any errors that may occur
     BakeError err;
 
-    switch (target->state) {
+    switch (dependency->state) {
         /**
-         * If the target has not been executed, or if the target
-         * is currently executing, then we want to call executeTarget.
+         * If the dependency has not been prepared, then we want to call prepareTarget.
          */
         case TARGET_NOT_EXECUTED:
-            // Try execute the target
-            err = executeTarget(options, bakefile, target);
+            err = prepareTarget(options, bakefile, scheduler, dependency);
             if(err != BAKE_SUCCESS)
                 return err;
 
-            // If the target was executed, then we should also execute this target
-            if(target->state == TARGET_EXECUTED) {
-                *executed = true;
-            }
-
             break;
 
-
         /**
-         * If we're trying to execute a target that is currently
-         * being executed, then we've found a circular dependency.
+         * If we're trying to prepare a target that is currently
+         * being prepared, then we've found a circular dependency.
          */
-        case TARGET_EXECUTING:
-            reportError("Found circular dependency when attempting to execute target %s\n", target->name);
+        case TARGET_PREPARING:
+            reportError("Found circular dependency when attempting to execute target %s\n", dependency->name);
             return BAKE_ERROR_EXECUTION;
 
         /**
-         * If the target dependency has already been updated,
-         * then we want to update this target also.
+         * If the dependency has already been prepared, we only need to wait for it.
          */
-        case TARGET_EXECUTED:
-            *executed = true;
+        case TARGET_PENDING:
             break;
 
         /**
-         * If the target dependency has been skipped,
-         * we don't want to update this target.
-         */
-        case TARGET_SKIPPED:
-            break;
-
-        /**
-         * If the target is of a state that we don't recognise, its an error.
+         * Targets are only executed once all targets have been prepared.
          */
         default:
-            reportError("Unknown target state %i when executing target dependency %s\n",
-                        target->state, target->name);
+            reportError("Unknown target state %i when preparing target dependency %s\n",
+                        dependency->state, dependency->name);
             return BAKE_ERROR_UNKNOWN;
-
     }
 
+    // Mark that the target has to wait for this dependency to finish before it is executed
+    err = target_addDependent(dependency, target);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    target->pendingDependencies += 1;
     return BAKE_SUCCESS;
 }
 
 
-BakeError executeDependencies(BakeOptions options, Bakefile bakefile, Target * target,
-                              long targetModificationTime, bool * dependenciesUpdated) {
-
+BakeError prepareDependencies(BakeOptions options, Bakefile bakefile, Scheduler * scheduler, Target * target) {
     // Stores any errors that occur during this method
     BakeError err;
 
-    // Loop through, and execute or check the modification time of all the target's dependencies
+    // Loop through and prepare all of the target's dependencies
     size_t dependencyCount = target_dependencyCount(target);
     char ** dependencies = target_getDependencies(target);
 
@@ -168,128 +581,1836 @@ BakeError executeDependencies(BakeOptions options, Bakefile bakefile, Target * t
         // Get the index'th dependency of this target
         char * dependencyName = dependencies[index];
 
-        // Check if this dependency is a target
+        // Check if this dependency is a target, and remember what it resolved to
         Target * dependencyTarget = bakefile_getTarget(&bakefile, dependencyName);
-        if(dependencyTarget != NULL) {
-            // Try execute the dependency
-            executeTargetDependency(options, bakefile, dependencyTarget, dependenciesUpdated);
+        err = target_addDependencyTarget(target, dependencyTarget);
+        if(err != BAKE_SUCCESS)
+            return err;
 
-            // Move on to the next dependency
+        // If it is a file or URL, its modification time will be checked later
+        if(dependencyTarget == NULL)
             continue;
-        }
 
-        // Variable to store the modification time of this dependency
-        time_t dependencyModificationTime;
-
-        // Check if this dependency is a URL
-        if(strncmp(dependencyName, "file://", strlen("file://")) == 0
-           || strncmp(dependencyName, "http://", strlen("http://")) == 0
-           || strncmp(dependencyName, "https://", strlen("https://")) == 0) {
+        // Try prepare the dependency
+        err = prepareTargetDependency(options, bakefile, scheduler, target, dependencyTarget);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
 
-            // If it is, get the last time this URL was modified
-            err = getURLModificationTime(dependencyName, &dependencyModificationTime);
-            if(err != BAKE_SUCCESS)
-                return err;
-        } else {
-            // If its not a target or a URL, then it must be a file dependency. Get the last
-            // modification time of this file dependency to check if we need to re-execute.
-            err = getFileModificationTime(dependencyName, &dependencyModificationTime);
-            if(err != BAKE_SUCCESS)
-                return err;
+    return BAKE_SUCCESS;
+}
 
-            // If the dependency file doesn't exist, we should execute this target
-            if(dependencyModificationTime == -1) {
-                *dependenciesUpdated = true;
-                continue;
-            }
-        }
 
-        // Or if the dependency was modified more recently than this target, we should also execute
-        if(dependencyModificationTime > targetModificationTime) {
-            *dependenciesUpdated = true;
-            continue;
-        }
+BakeError prepareTarget(BakeOptions options, Bakefile bakefile, Scheduler * scheduler, Target * target) {
+    // The target has to have not already been prepared
+    if(target->state != TARGET_NOT_EXECUTED) {
+        reportError("Target cannot be executed if it has already been executed\n");
+        return BAKE_ERROR_EXECUTION;
     }
 
-    return BAKE_SUCCESS;
+    // Mark that this target is being prepared
+    target->state = TARGET_PREPARING;
+
+    // Prepare the dependencies of this target
+    BakeError err = prepareDependencies(options, bakefile, scheduler, target);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Mark that this target is waiting to be executed, in the order a serial walk would have executed it
+    target->state = TARGET_PENDING;
+    target->order = scheduler->nextOrder++;
+
+    return buf_append(&scheduler->targets, &target, sizeof(Target *));
 }
 
 
-BakeError executeActionLines(BakeOptions options, Target * target) {
-    BakeError err;
+double estimateDuration(Target * target, bool willExecute, double defaultDuration) {
+    // Targets that are up to date, or that have nothing to execute, take no time
+    if(!willExecute || target_actionLineCount(target) == 0)
+        return 0;
 
-    // Get the action lines from the target
-    size_t actionCount = target_actionLineCount(target);
-    ActionLine * actions = target_getActionLines(target);
+    if(target->expectedDuration >= 0)
+        return target->expectedDuration;
 
-    for(size_t index = 0; index < actionCount; ++index) {
-        // Get the index'th ActionLine from actions
-        ActionLine action = actions[index];
+    return defaultDuration;
+}
 
-        // If we haven't been passed the silent option, we want to print the command
-        if((!options.silent && !action.skipPrinting) || options.onlyPrintCommands) {
-            printf("%s\n", action.command);
-        }
 
-        // If we only want to print the commands, don't execute it
-        if(options.onlyPrintCommands)
-            continue;
+BakeError prioritiseTargets(Scheduler * scheduler) {
+    size_t targetCount = scheduler->targets.used / sizeof(Target *);
+    Target ** targets = buf_get(&scheduler->targets);
 
-        // Execute the command of the action
-        int exitStatus;
-        err = executeCommand(action.command, NULL, &exitStatus);
-        if(err != BAKE_SUCCESS)
-            return err;
+    // Targets that haven't been recorded before are expected to take the average time of those that have
+    double totalDuration = 0;
+    size_t recordedCount = 0;
 
-        // Check if the command was successful, and whether we care
-        if(exitStatus != EXIT_SUCCESS && options.requireSuccess && action.requireSuccess) {
-            reportError("Command \"%s\" failed, aborting execution...\n", action.command);
-            return BAKE_ERROR_EXECUTION;
+    for(size_t index = 0; index < targetCount; ++index) {
+        if(targets[index]->expectedDuration >= 0) {
+            totalDuration += targets[index]->expectedDuration;
+            recordedCount += 1;
         }
     }
 
-    return BAKE_SUCCESS;
-}
+    double defaultDuration = (recordedCount > 0 ? totalDuration / recordedCount : 1.0);
+
+    // Find which targets will be executed, walking dependencies before the targets that depend on them
+    bool * willExecute = calloc(targetCount, sizeof(bool));
+    if(willExecute == NULL && targetCount > 0) {
+        reportError("Unable to allocate memory to prioritise targets\n");
+        return BAKE_ERROR_MEMORY;
+    }
 
+    for(size_t index = 0; index < targetCount; ++index) {
+        Target * target = targets[index];
+        willExecute[index] = target->dependenciesUpdated;
 
-BakeError executeTarget(BakeOptions options, Bakefile bakefile, Target * target) {
-    // The target has to have not already been executed
-    if(target->state != TARGET_NOT_EXECUTED) {
-        reportError("Target cannot be executed if it has already been executed\n");
-        return BAKE_ERROR_EXECUTION;
+        size_t dependencyCount = target_dependencyCount(target);
+        Target ** dependencyTargets = target_getDependencyTargets(target);
+
+        for(size_t dependencyIndex = 0; dependencyIndex < dependencyCount; ++dependencyIndex) {
+            Target * dependency = dependencyTargets[dependencyIndex];
+            if(dependency != NULL && willExecute[dependency->order]) {
+                willExecute[index] = true;
+            }
+        }
     }
 
-    // Mark that this target is being executed
-    target->state = TARGET_EXECUTING;
+    // Find the longest chain after each target, walking dependents before the targets they depend on
+    for(size_t index = targetCount; index > 0; --index) {
+        Target * target = targets[index - 1];
 
-    // Get the modification time of this target
-    time_t targetModificationTime;
-    BakeError err = getFileModificationTime(target->name, &targetModificationTime);
-    if(err != BAKE_SUCCESS)
-        return err;
+        double longestDependentPath = 0;
+        target->prioritised = target->priorityHint;
 
-    // If we couldn't find the target on disk, then we should execute this target to create it
-    bool shouldExecute = (targetModificationTime == -1 || target_dependencyCount(target) == 0);
+        size_t dependentCount = target_dependentCount(target);
+        Target ** dependents = target_getDependents(target);
 
-    // Execute the dependencies of this target
-    err = executeDependencies(options, bakefile, target, targetModificationTime, &shouldExecute);
-    if(err != BAKE_SUCCESS)
-        return err;
+        for(size_t dependentIndex = 0; dependentIndex < dependentCount; ++dependentIndex) {
+            Target * dependent = dependents[dependentIndex];
 
-    // If none of the dependencies have been updated, then we don't need to execute this target
-    if(!shouldExecute) {
-        // Mark that we have skipped this target
-        target->state = TARGET_SKIPPED;
-        return BAKE_SUCCESS;
-    }
+            if(dependent->criticalPath > longestDependentPath) {
+                longestDependentPath = dependent->criticalPath;
+            }
 
-    // Mark the target as having been executed
-    target->state = TARGET_EXECUTED;
+            target->prioritised |= dependent->prioritised;
+        }
 
-    // Execute all the actions associated with this target
-    err = executeActionLines(options, target);
-    if(err != BAKE_SUCCESS)
-        return err;
+        if(scheduler->criticalPathFirst) {
+            target->criticalPath = estimateDuration(target, willExecute[index - 1], defaultDuration)
+                                   + longestDependentPath;
+        }
+    }
 
-    return BAKE_SUCCESS;
+    free(willExecute);
+
+    // The targets that have no target dependencies are ready to be executed
+    for(size_t index = 0; index < targetCount; ++index) {
+        if(targets[index]->pendingDependencies == 0) {
+            BakeError err = tqueue_push(&scheduler->ready, targets[index]);
+            if(err != BAKE_SUCCESS)
+                return err;
+        }
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError checkDependencies(Scheduler * scheduler, Target * target) {
+    // Stores any errors that occur during this method
+    BakeError err;
+
+    // Targets recorded as not creating a file are compared against when they last finished, as they have no file
+    FileTime targetTime = target->modificationTime;
+    if(targetTime == -1 && target->fingerprintsRecorded && !target->recordedFile) {
+        targetTime = target->recordedTime;
+    }
+
+    // Loop through, and check the modification time of all the target's file and URL dependencies
+    size_t dependencyCount = target_dependencyCount(target);
+    char ** dependencies = target_getDependencies(target);
+    Target ** dependencyTargets = target_getDependencyTargets(target);
+
+    for(size_t index = 0; index < dependencyCount; ++index) {
+        // Get the index'th dependency of this target
+        char * dependencyName = dependencies[index];
+
+        // Target dependencies are checked when they finish executing
+        if(dependencyTargets[index] != NULL)
+            continue;
+
+        // Variable to store the modification time of this dependency
+        FileTime dependencyModificationTime;
+
+        // Check if this dependency is a URL
+        if(isURLDependency(dependencyName)) {
+
+            // If it is, get the last time this URL was modified
+            err = getURLModificationTime(dependencyName, &dependencyModificationTime);
+            if(err != BAKE_SUCCESS)
+                return err;
+        } else {
+            // If its not a target or a URL, then it must be a file dependency. Get the last
+            // modification time of this file dependency to check if we need to re-execute.
+            err = getFileModificationTime(scheduler->statCache, dependencyName, &dependencyModificationTime);
+            if(err != BAKE_SUCCESS)
+                return err;
+
+            // Take the fingerprint of the file, so that it can be recorded for the next build
+            bool changed = false;
+            if(scheduler->freshness == FRESHNESS_HASH) {
+                err = fingerprintInput(scheduler, target, dependencyName, &changed);
+                if(err != BAKE_SUCCESS)
+                    return err;
+            }
+
+            // If the dependency file doesn't exist, we should execute this target
+            if(dependencyModificationTime == -1) {
+                target->dependenciesUpdated = true;
+                continue;
+            }
+
+            // If fingerprints were recorded, then only the contents of the file matter
+            if(scheduler->freshness == FRESHNESS_HASH && target->fingerprintsRecorded) {
+                if(changed) {
+                    target->dependenciesUpdated = true;
+                }
+                continue;
+            }
+        }
+
+        // Or if the dependency was modified more recently than this target, we should also execute
+        if(dependencyModificationTime > targetTime) {
+            target->dependenciesUpdated = true;
+            continue;
+        }
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError fingerprintInput(Scheduler * scheduler, Target * target, char * path, bool * changed) {
+    // Inputs are checked in the same order in every build, so the recorded fingerprint is likely at the same index
+    size_t index = target_currentFingerprintCount(target);
+    Fingerprint * recorded = fingerprints_find(target_getRecordedFingerprints(target),
+                                               target_recordedFingerprintCount(target), path, index);
+
+    Fingerprint fingerprint;
+    BakeError err = fingerprints_take(scheduler->statCache, path, recorded, &fingerprint);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    err = target_addCurrentFingerprint(target, fingerprint);
+    if(err != BAKE_SUCCESS) {
+        free(fingerprint.path);
+        return err;
+    }
+
+    *changed = (recorded == NULL || recorded->hash != fingerprint.hash
+                || (recorded->modificationTime == -1) != (fingerprint.modificationTime == -1));
+    return BAKE_SUCCESS;
+}
+
+
+BakeError checkTargetFingerprints(BakeOptions options, Scheduler * scheduler, Target * target) {
+    size_t dependencyCount = target_dependencyCount(target);
+    Target ** dependencyTargets = target_getDependencyTargets(target);
+
+    for(size_t index = 0; index < dependencyCount; ++index) {
+        Target * dependency = dependencyTargets[index];
+        if(dependency == NULL)
+            continue;
+
+        bool changed;
+        BakeError err = fingerprintInput(scheduler, target, dependency->name, &changed);
+        if(err != BAKE_SUCCESS)
+            return err;
+
+        // Without a record, targets that were executed update their dependents, as with modification times
+        if(!target->fingerprintsRecorded)
+            continue;
+
+        // Targets without a file that were executed always update their dependents, and when we only
+        // print commands, the targets that would have been executed haven't written their files yet.
+        Fingerprint * fingerprints = target_getCurrentFingerprints(target);
+        bool missing = (fingerprints[target_currentFingerprintCount(target) - 1].modificationTime == -1);
+        bool executed = (dependency->state == TARGET_EXECUTED);
+
+        if(changed || (executed && (missing || options.onlyPrintCommands))) {
+            target->dependenciesUpdated = true;
+        }
+    }
+
+    // Targets that have gained or lost inputs since their fingerprints were recorded are out of date
+    if(target->fingerprintsRecorded
+       && target_currentFingerprintCount(target) != target_recordedFingerprintCount(target)) {
+        target->dependenciesUpdated = true;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+bool isURLDependency(char * dependency) {
+    return strncmp(dependency, "file://", strlen("file://")) == 0
+           || strncmp(dependency, "http://", strlen("http://")) == 0
+           || strncmp(dependency, "https://", strlen("https://")) == 0;
+}
+
+
+BakeError prefetchTargetFiles(Scheduler * scheduler) {
+    size_t targetCount = scheduler->targets.used / sizeof(Target *);
+    Target ** targets = buf_get(&scheduler->targets);
+
+    // Collect the files of all the prepared targets, and all of their file dependencies
+    Buffer files;
+    BakeError err = buf_allocate(&files, (targetCount + 1) * sizeof(char *));
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    for(size_t index = 0; index < targetCount && err == BAKE_SUCCESS; ++index) {
+        Target * target = targets[index];
+        err = buf_append(&files, &target->name, sizeof(char *));
+
+        size_t dependencyCount = target_dependencyCount(target);
+        char ** dependencies = target_getDependencies(target);
+        Target ** dependencyTargets = target_getDependencyTargets(target);
+
+        for(size_t dependencyIndex = 0; err == BAKE_SUCCESS && dependencyIndex < dependencyCount;
+            ++dependencyIndex) {
+            if(dependencyTargets[dependencyIndex] == NULL && !isURLDependency(dependencies[dependencyIndex])) {
+                err = buf_append(&files, &dependencies[dependencyIndex], sizeof(char *));
+            }
+        }
+    }
+
+    if(err == BAKE_SUCCESS) {
+        err = prefetchFileStatus(scheduler->statCache, buf_get(&files), files.used / sizeof(char *));
+    }
+
+    buf_free(&files);
+    return err;
+}
+
+
+BakeError checkTargetFreshness(Worker * worker, void * argument) {
+    Scheduler * scheduler = worker->pool->context;
+    Target * target = argument;
+
+    // Place the spans of this worker on its own lane of the trace of the build
+    double start = monotonicTime();
+    trace_setLane(TRACE_WORKER_LANE + (size_t) (worker - worker->pool->workers));
+
+    // Submit tasks to check the target dependencies first, so that idle workers can steal them
+    size_t dependencyCount = target_dependencyCount(target);
+    Target ** dependencyTargets = target_getDependencyTargets(target);
+
+    for(size_t index = 0; index < dependencyCount; ++index) {
+        Target * dependency = dependencyTargets[index];
+
+        // Only check each target once, even if it is depended on by many targets
+        if(dependency == NULL || !pool_claim(worker->pool, &dependency->freshnessChecked))
+            continue;
+
+        BakeError err = pool_submit(worker->pool, worker, checkTargetFreshness, dependency);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    // Get the modification time of this target
+    BakeError err = getFileModificationTime(scheduler->statCache, target->name, &target->modificationTime);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // If we couldn't find the target on disk, then we should execute this target to create it,
+    // unless it was recorded as not creating a file the last time it was executed
+    bool missing = (target->modificationTime == -1 && !(target->fingerprintsRecorded && !target->recordedFile));
+    target->dependenciesUpdated = (missing || dependencyCount == 0);
+
+    // If the commands of the target have been edited since it was recorded, then it should be executed again
+    if(target->fingerprintsRecorded && state_commandHash(target) != target->recordedCommandHash) {
+        target->dependenciesUpdated = true;
+    }
+
+    // Check whether any of the file or URL dependencies of the target have been updated
+    err = checkDependencies(scheduler, target);
+
+    trace_span(trace_currentLane(), "stat", target->name, NULL, start, monotonicTime());
+    return err;
+}
+
+
+BakeError checkFreshness(Scheduler * scheduler, Target ** targets, size_t count) {
+    // Use a worker for each processor, but never more workers than there are targets to check
+    size_t workerCount = findAvailableProcessors();
+    if(workerCount > scheduler->nextOrder) {
+        workerCount = scheduler->nextOrder;
+    }
+
+    // Start the workers, which find the scheduler through the pool
+    ThreadPool pool;
+    BakeError err = pool_allocate(&pool, workerCount, scheduler);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Check the targets, which will in turn submit tasks to check their dependencies.
+    // A target may already have been claimed as a dependency of one of the others.
+    for(size_t index = 0; index < count && err == BAKE_SUCCESS; ++index) {
+        if(pool_claim(&pool, &targets[index]->freshnessChecked)) {
+            err = pool_submit(&pool, NULL, checkTargetFreshness, targets[index]);
+        }
+    }
+
+    // Wait for all the targets to be checked
+    BakeError waitErr = pool_wait(&pool);
+    if(err == BAKE_SUCCESS) {
+        err = waitErr;
+    }
+
+    pool_free(&pool);
+    return err;
+}
+
+
+bool canStartTarget(Scheduler * scheduler, Target * target, size_t allowedSlots) {
+    // Targets that won't be executed don't need anything
+    if(!target->dependenciesUpdated || hasFailedDependency(target))
+        return true;
+
+    return canTakeResources(scheduler, target, allowedSlots);
+}
+
+
+bool canTakeResources(Scheduler * scheduler, Target * target, size_t allowedSlots) {
+    // Targets that need more slots than are allowed may still execute on their own
+    if(scheduler->usedSlots > 0 && scheduler->usedSlots + target->cpus > allowedSlots)
+        return false;
+
+    size_t costCount = target_poolCostCount(target);
+    PoolCost * costs = target_getPoolCosts(target);
+
+    for(size_t index = 0; index < costCount; ++index) {
+        if(!jobpool_canAcquire(costs[index].pool, costs[index].cost))
+            return false;
+    }
+
+    return true;
+}
+
+
+void acquireResources(Scheduler * scheduler, Target * target) {
+    takeResources(scheduler, target);
+    target->holdsResources = true;
+}
+
+
+void releaseResources(Scheduler * scheduler, Target * target) {
+    if(!target->holdsResources)
+        return;
+
+    giveBackResources(scheduler, target);
+    target->holdsResources = false;
+}
+
+
+void takeResources(Scheduler * scheduler, Target * target) {
+    scheduler->usedSlots += target->cpus;
+
+    size_t costCount = target_poolCostCount(target);
+    PoolCost * costs = target_getPoolCosts(target);
+
+    for(size_t index = 0; index < costCount; ++index) {
+        jobpool_acquire(costs[index].pool, costs[index].cost);
+    }
+}
+
+
+void giveBackResources(Scheduler * scheduler, Target * target) {
+    scheduler->usedSlots -= target->cpus;
+
+    size_t costCount = target_poolCostCount(target);
+    PoolCost * costs = target_getPoolCosts(target);
+
+    for(size_t index = 0; index < costCount; ++index) {
+        jobpool_release(costs[index].pool, costs[index].cost);
+    }
+}
+
+
+BakeError acquireLineResources(Scheduler * scheduler, Target * target, bool * acquired) {
+    *acquired = false;
+
+    size_t allowedSlots = limit_allowedJobs(&scheduler->limit, scheduler->usedSlots);
+    if(!canTakeResources(scheduler, target, allowedSlots))
+        return BAKE_SUCCESS;
+
+    // If we share our jobs with other processes, the line also needs a token. The job
+    // executing the target isn't among the running jobs while it starts its lines.
+    BakeError err = acquireJobToken(scheduler, tokenJobCount(scheduler) + 1, acquired);
+    if(err != BAKE_SUCCESS || !*acquired)
+        return err;
+
+    takeResources(scheduler, target);
+    return BAKE_SUCCESS;
+}
+
+
+bool hasPoolSettings(Target * target) {
+    size_t costCount = target_poolCostCount(target);
+    PoolCost * costs = target_getPoolCosts(target);
+
+    for(size_t index = 0; index < costCount; ++index) {
+        if(jobpool_hasSettings(costs[index].pool))
+            return true;
+    }
+
+    return false;
+}
+
+
+BakeError requeueBlockedTargets(Scheduler * scheduler) {
+    size_t blockedCount = scheduler->blocked.used / sizeof(Target *);
+    Target ** blocked = buf_get(&scheduler->blocked);
+
+    for(size_t index = 0; index < blockedCount; ++index) {
+        BakeError err = tqueue_push(&scheduler->ready, blocked[index]);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    buf_reset(&scheduler->blocked);
+    return BAKE_SUCCESS;
+}
+
+
+BakeError finishTarget(Scheduler * scheduler, Target * target) {
+    // Give back the job slots and pool tokens the target took
+    releaseResources(scheduler, target);
+
+    // Record how long the target took to execute
+    double now = monotonicTime();
+    if(target->state == TARGET_EXECUTED) {
+        target->duration = now - target->startTime;
+    }
+
+    // Targets that started executing are given a lane. Their commands may have written
+    // to the file of the target, so its status has to be found again if it is needed.
+    if(target->lane != 0) {
+        trace_span(target->lane, "target", target->name,
+                   (target->state == TARGET_FAILED ? "failed" : NULL), target->startTime, now);
+        invalidateFileStatus(scheduler->statCache, target->name);
+    }
+
+    // Record the outcome of the target straight away, so that it isn't lost if bake is killed
+    if(scheduler->state != NULL) {
+        BakeError err = state_record(scheduler->state, scheduler->statCache, target);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    // Loop through all targets that depend on this target
+    size_t dependentCount = target_dependentCount(target);
+    Target ** dependents = target_getDependents(target);
+
+    for(size_t index = 0; index < dependentCount; ++index) {
+        Target * dependent = dependents[index];
+
+        // If this target was executed, then its dependents should also be executed,
+        // unless they have recorded fingerprints to check whether its file changed
+        bool checksFingerprints = (scheduler->freshness == FRESHNESS_HASH && dependent->fingerprintsRecorded);
+        if(target->state == TARGET_EXECUTED && !checksFingerprints) {
+            dependent->dependenciesUpdated = true;
+        }
+
+        // If this was the last dependency the dependent was waiting on, it is ready to be executed
+        dependent->pendingDependencies -= 1;
+        if(dependent->pendingDependencies == 0) {
+            BakeError err = tqueue_push(&scheduler->ready, dependent);
+            if(err != BAKE_SUCCESS)
+                return err;
+        }
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError failTarget(BakeOptions options, Scheduler * scheduler, Target * target, BakeError err) {
+    // Unless we're keeping going, stop executing targets. Errors other than commands failing always stop us.
+    if(!options.keepGoing || err != BAKE_ERROR_EXECUTION)
+        return err;
+
+    target->state = TARGET_FAILED;
+
+    err = buf_append(&scheduler->failures, &target, sizeof(Target *));
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    return finishTarget(scheduler, target);
+}
+
+
+bool hasFailedDependency(Target * target) {
+    size_t dependencyCount = target_dependencyCount(target);
+    Target ** dependencyTargets = target_getDependencyTargets(target);
+
+    for(size_t index = 0; index < dependencyCount; ++index) {
+        if(dependencyTargets[index] != NULL && dependencyTargets[index]->state == TARGET_FAILED)
+            return true;
+    }
+
+    return false;
+}
+
+
+char * failureResponse(BakeOptions options) {
+    return (options.keepGoing ? "continuing with the targets that don't depend on it" : "aborting execution");
+}
+
+
+void reportFailures(Scheduler * scheduler) {
+    size_t failureCount = scheduler->failures.used / sizeof(Target *);
+    Target ** failures = buf_get(&scheduler->failures);
+
+    reportError("\n%lu target%s failed:\n", (unsigned long) failureCount, (failureCount == 1 ? "" : "s"));
+    for(size_t index = 0; index < failureCount; ++index) {
+        reportError("    %s\n", failures[index]->name);
+    }
+
+    // Count the targets that weren't executed because of the failures
+    size_t targetCount = scheduler->targets.used / sizeof(Target *);
+    Target ** targets = buf_get(&scheduler->targets);
+    size_t notExecutedCount = 0;
+
+    for(size_t index = 0; index < targetCount; ++index) {
+        if(targets[index]->state == TARGET_FAILED) {
+            notExecutedCount += 1;
+        }
+    }
+
+    notExecutedCount -= failureCount;
+    if(notExecutedCount > 0) {
+        reportError("%lu target%s not executed because a target they depend on failed\n",
+                    (unsigned long) notExecutedCount, (notExecutedCount == 1 ? " was" : "s were"));
+    }
+}
+
+
+BakeError executeActionLines(BakeOptions options, Scheduler * scheduler, Job * job, bool * finished) {
+    // Get the action lines from the target
+    size_t actionCount = target_actionLineCount(job->target);
+    ActionLine * actions = target_getActionLines(job->target);
+
+    // If the target wants its action lines executed in one shell, start them all at once as a script
+    if(job->target->oneShell && scheduler->posixShell && !options.onlyPrintCommands
+       && job->nextActionLine == 0 && actionCount > 0) {
+
+        *finished = false;
+        return executeScript(options, scheduler, job);
+    }
+
+    job->waitingForResources = false;
+
+    while(true) {
+        // Before the next action line that isn't concurrent, or the end of the target,
+        // wait for all the concurrent action lines before it to complete
+        bool atEnd = (job->nextActionLine >= actionCount);
+        if(atEnd || !actions[job->nextActionLine].concurrent) {
+            if(job->pendingLines > 0) {
+                job->action = NULL;
+                job->pid = -1;
+                job->deadline = -1;
+                *finished = false;
+                return BAKE_SUCCESS;
+            }
+
+            BakeError err = checkConcurrentLines(options, job);
+            if(err != BAKE_SUCCESS)
+                return err;
+
+            if(atEnd)
+                break;
+        }
+
+        // Get the next ActionLine from actions
+        ActionLine * action = &actions[job->nextActionLine];
+
+        // The first of the concurrent action lines executing at once uses the job slots and tokens of the target,
+        // but each line after it needs its own. If they're taken, wait for one of the lines to complete.
+        bool ownsResources = false;
+        if(action->concurrent && job->pendingLines > 0 && !options.onlyPrintCommands) {
+            BakeError err = acquireLineResources(scheduler, job->target, &ownsResources);
+            if(err != BAKE_SUCCESS)
+                return err;
+
+            if(!ownsResources) {
+                job->action = NULL;
+                job->pid = -1;
+                job->deadline = -1;
+                job->waitingForResources = true;
+                *finished = false;
+                return BAKE_SUCCESS;
+            }
+        }
+
+        job->nextActionLine += 1;
+
+        // If we haven't been passed the silent option, we want to print the command
+        if((!options.silent && !action->skipPrinting) || options.onlyPrintCommands) {
+            BakeError err = printCommand(job, action->command);
+            if(err != BAKE_SUCCESS)
+                return err;
+        }
+
+        // If we only want to print the commands, don't execute it
+        if(options.onlyPrintCommands)
+            continue;
+
+        // If the command is simple enough to execute within bake, do so instead of starting a new process
+        if(options.useBuiltins && scheduler->posixShell && action->arguments != NULL) {
+            bool executed;
+            int exitStatus;
+            double start = monotonicTime();
+            BakeError err = runJobBuiltin(job, action, &executed, &exitStatus);
+
+            // Builtins don't start a process, so they don't need the resources taken for them
+            if(ownsResources && (err != BAKE_SUCCESS || executed)) {
+                giveBackResources(scheduler, job->target);
+            }
+
+            if(err != BAKE_SUCCESS)
+                return err;
+
+            if(executed) {
+                trace_span(job->target->lane, "builtin", action->command,
+                           (exitStatus != EXIT_SUCCESS ? "failed" : NULL), start, monotonicTime());
+                job->failed |= (exitStatus != EXIT_SUCCESS);
+
+                if(exitStatus != EXIT_SUCCESS && options.requireSuccess && action->requireSuccess) {
+                    // The failures of concurrent action lines are reported in order once they have all completed
+                    if(action->concurrent) {
+                        action->failed = true;
+                    } else {
+                        flushJobOutput(job);
+                        reportError("Command \"%s\" failed, %s...\n", action->command, failureResponse(options));
+                        return BAKE_ERROR_EXECUTION;
+                    }
+                }
+
+                if(options.outputSync == OUTPUT_SYNC_LINE) {
+                    err = flushJobOutput(job);
+                    if(err != BAKE_SUCCESS)
+                        return err;
+                }
+
+                continue;
+            }
+        }
+
+        // Start executing a concurrent action line as its own job, and carry on without waiting for it
+        if(action->concurrent) {
+            BakeError err = startConcurrentLine(options, scheduler, job, action, ownsResources);
+            if(err != BAKE_SUCCESS)
+                return err;
+
+            continue;
+        }
+
+        // Start executing the command of the action, and wait for it to complete before executing any more
+        job->action = action;
+        *finished = false;
+
+        BakeError err = spawnActionLine(scheduler, job->target, action, jobRedirections(job), &job->pid);
+        if(err != BAKE_SUCCESS)
+            return err;
+
+        startCommandTimer(options, job);
+        return BAKE_SUCCESS;
+    }
+
+    // There are no more action lines to execute
+    *finished = true;
+    return BAKE_SUCCESS;
+}
+
+
+BakeError startConcurrentLine(BakeOptions options, Scheduler * scheduler, Job * job, ActionLine * action,
+                              bool ownsResources) {
+    Job line;
+    line.target = job->target;
+    line.nextActionLine = job->nextActionLine;
+    line.action = action;
+    line.pid = -1;
+    line.commandStart = -1;
+    line.statusFD = -1;
+    line.outputFDs[PIPE_READ] = -1;
+    line.outputFDs[PIPE_WRITE] = -1;
+    line.errorFDs[PIPE_READ] = -1;
+    line.errorFDs[PIPE_WRITE] = -1;
+    line.failed = false;
+    line.deadline = -1;
+    line.stopping = false;
+    line.timedOut = false;
+    line.concurrent = true;
+    line.ownsResources = ownsResources;
+    line.waitingForResources = false;
+    line.pendingLines = 0;
+    line.firstConcurrentLine = 0;
+
+    // The command writes its output to wherever the output of the job is being collected
+    BakeError err = spawnActionLine(scheduler, job->target, action, jobRedirections(job), &line.pid);
+    if(err != BAKE_SUCCESS) {
+        if(ownsResources) {
+            giveBackResources(scheduler, job->target);
+        }
+
+        return err;
+    }
+
+    startCommandTimer(options, &line);
+
+    err = watchJob(scheduler, &line);
+    if(err == BAKE_SUCCESS) {
+        err = buf_append(&scheduler->jobs, &line, sizeof(Job));
+    }
+
+    // The line's process is still started, so its resources are given back once we stop waiting for it
+    if(err != BAKE_SUCCESS) {
+        if(ownsResources) {
+            giveBackResources(scheduler, job->target);
+        }
+
+        return err;
+    }
+
+    action->failed = false;
+    job->pendingLines += 1;
+    return BAKE_SUCCESS;
+}
+
+
+BakeError finishConcurrentLine(BakeOptions options, Scheduler * scheduler, Job * line, int exitStatus) {
+    // Give back the job slots and tokens the line took of its own
+    if(line->ownsResources) {
+        giveBackResources(scheduler, line->target);
+    }
+
+    // Commands that timed out always fail their target, even if their failure would be ignored
+    line->action->failed = line->timedOut || (exitStatus != EXIT_SUCCESS && options.requireSuccess
+                                              && line->action->requireSuccess);
+
+    // Find the job executing the target of the line, which is gone if the target has already failed
+    Job * job = findTargetJob(scheduler, line->target);
+    if(job == NULL)
+        return BAKE_SUCCESS;
+
+    job->failed |= (exitStatus != EXIT_SUCCESS);
+    job->pendingLines -= 1;
+
+    // Collect the output of the command along with the output of the job
+    BakeError err = readJobOutput(job);
+    if(err == BAKE_SUCCESS && options.outputSync == OUTPUT_SYNC_LINE && !scheduler->stopping) {
+        err = flushJobOutput(job);
+    }
+
+    if(err != BAKE_SUCCESS || job->pid >= 0)
+        return err;
+
+    // Keep waiting for the rest of the concurrent action lines, unless the job
+    // was waiting for the resources that this line has just given back
+    if(job->pendingLines > 0 && (!job->waitingForResources || scheduler->stopping))
+        return BAKE_SUCCESS;
+
+    // Remove the job from the running jobs by moving the last job into its place
+    size_t jobCount = scheduler_jobCount(scheduler);
+    Job * jobs = scheduler_getJobs(scheduler);
+    Job waiting = *job;
+    *job = jobs[jobCount - 1];
+    scheduler->jobs.used -= sizeof(Job);
+
+    // If we're stopping all the jobs, we only need to print what the job has written
+    if(scheduler->stopping) {
+        finishJobOutput(options, scheduler, &waiting);
+        return BAKE_SUCCESS;
+    }
+
+    // Otherwise, carry on with the action lines that were waiting
+    return continueJob(options, scheduler, &waiting);
+}
+
+
+BakeError checkConcurrentLines(BakeOptions options, Job * job) {
+    ActionLine * actions = target_getActionLines(job->target);
+    size_t first = job->firstConcurrentLine;
+    size_t end = job->nextActionLine;
+    job->firstConcurrentLine = end;
+
+    // Find the last of the lines that failed, so that what we'll do now is only reported once
+    size_t lastFailed = end;
+    for(size_t index = first; index < end; ++index) {
+        if(actions[index].concurrent && actions[index].failed) {
+            lastFailed = index;
+        }
+    }
+
+    if(lastFailed == end)
+        return BAKE_SUCCESS;
+
+    // Print the output of the commands before reporting that they failed
+    flushJobOutput(job);
+
+    for(size_t index = first; index < lastFailed; ++index) {
+        if(actions[index].concurrent && actions[index].failed) {
+            reportError("Command \"%s\" failed\n", actions[index].command);
+        }
+    }
+
+    reportError("Command \"%s\" failed, %s...\n", actions[lastFailed].command, failureResponse(options));
+    return BAKE_ERROR_EXECUTION;
+}
+
+
+Job * findTargetJob(Scheduler * scheduler, Target * target) {
+    size_t jobCount = scheduler_jobCount(scheduler);
+    Job * jobs = scheduler_getJobs(scheduler);
+
+    for(size_t index = 0; index < jobCount; ++index) {
+        if(jobs[index].target == target && !jobs[index].concurrent)
+            return &jobs[index];
+    }
+
+    return NULL;
+}
+
+
+size_t tokenJobCount(Scheduler * scheduler) {
+    size_t jobCount = scheduler_jobCount(scheduler);
+    Job * jobs = scheduler_getJobs(scheduler);
+
+    // The first concurrent action line executing at once uses the token of its target
+    size_t count = 0;
+    for(size_t index = 0; index < jobCount; ++index) {
+        if(!jobs[index].concurrent || jobs[index].ownsResources) {
+            count += 1;
+        }
+    }
+
+    return count;
+}
+
+
+BakeError executeScript(BakeOptions options, Scheduler * scheduler, Job * job) {
+    // Build the script of all the action lines of the target
+    StringBuilder script;
+    BakeError err = strbuilder_allocate(&script, 256);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    err = appendScript(options, job->target, &script);
+    if(err != BAKE_SUCCESS) {
+        strbuilder_free(&script);
+        return err;
+    }
+
+    // Create a pipe for the script to tell us which action line failed
+    int pipeFDs[2];
+    err = createPipe(pipeFDs);
+    if(err != BAKE_SUCCESS) {
+        strbuilder_free(&script);
+        return err;
+    }
+
+    // Background processes started by the script inherit its end of the pipe, so the pipe may stay open long
+    // after the script exits. We only read what the script wrote before it exited, without waiting for more.
+    if(fcntl(pipeFDs[PIPE_READ], F_SETFL, O_NONBLOCK) != 0) {
+        reportError("Unable to make status pipe of target %s non-blocking: %s\n", job->target->name, strerror(errno));
+        strbuilder_free(&script);
+        close(pipeFDs[PIPE_READ]);
+        close(pipeFDs[PIPE_WRITE]);
+        return BAKE_ERROR_IO;
+    }
+
+    // Start the script
+    Redirections redirections = jobRedirections(job);
+    redirections.status = pipeFDs[PIPE_WRITE];
+
+    err = spawnCommand(scheduler->shell, strbuilder_get(&script), redirections, true, job->target, &job->pid);
+
+    // Only the shell should hold the WRITE end of the pipe, so that we find the end of the pipe once it exits
+    strbuilder_free(&script);
+    close(pipeFDs[PIPE_WRITE]);
+
+    if(err != BAKE_SUCCESS) {
+        close(pipeFDs[PIPE_READ]);
+        return err;
+    }
+
+    startCommandTimer(options, job);
+
+    // All the action lines have been started
+    job->statusFD = pipeFDs[PIPE_READ];
+    job->action = NULL;
+    job->nextActionLine = target_actionLineCount(job->target);
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError finishScript(BakeOptions options, Job * job, int exitStatus) {
+    // Read the index of the failed action line, if the script wrote one
+    StringBuilder status;
+    BakeError err = strbuilder_allocate(&status, 16);
+    if(err == BAKE_SUCCESS) {
+        err = readPipeContents(job->statusFD, &status);
+    }
+
+    close(job->statusFD);
+    job->statusFD = -1;
+
+    if(err != BAKE_SUCCESS || exitStatus == EXIT_SUCCESS || !options.requireSuccess) {
+        strbuilder_free(&status);
+        return err;
+    }
+
+    // Find which action line failed
+    char * end;
+    size_t actionCount = target_actionLineCount(job->target);
+    ActionLine * actions = target_getActionLines(job->target);
+    unsigned long index = strtoul(strbuilder_get(&status), &end, 10);
+
+    if(end != strbuilder_get(&status) && index < actionCount) {
+        reportError("Command \"%s\" (action line %lu of target %s) failed, %s...\n",
+                    actions[index].command, index + 1, job->target->name, failureResponse(options));
+    } else {
+        reportError("The shell executing target %s failed with exit status %i, %s...\n",
+                    job->target->name, exitStatus, failureResponse(options));
+    }
+
+    strbuilder_free(&status);
+    return BAKE_ERROR_EXECUTION;
+}
+
+
+BakeError startJob(BakeOptions options, Scheduler * scheduler, Target * target) {
+    // If a target this target depends on failed, then this target can't be executed either
+    if(hasFailedDependency(target)) {
+        target->state = TARGET_FAILED;
+        return finishTarget(scheduler, target);
+    }
+
+    // Check whether the contents of the files of its target dependencies changed
+    if(scheduler->freshness == FRESHNESS_HASH) {
+        BakeError err = checkTargetFingerprints(options, scheduler, target);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    // If none of the dependencies have been updated, then we don't need to execute this target
+    if(!target->dependenciesUpdated) {
+        // Mark that we have skipped this target
+        target->state = TARGET_SKIPPED;
+        return finishTarget(scheduler, target);
+    }
+
+    // Mark that this target is being executed
+    target->state = TARGET_EXECUTING;
+    target->startTime = monotonicTime();
+    target->lane = findFreeLane(scheduler);
+    acquireResources(scheduler, target);
+
+    // Start executing the action lines of the target
+    Job job;
+    job.target = target;
+    job.nextActionLine = 0;
+    job.action = NULL;
+    job.pid = -1;
+    job.commandStart = -1;
+    job.statusFD = -1;
+    job.failed = false;
+    job.deadline = -1;
+    job.stopping = false;
+    job.timedOut = false;
+    job.concurrent = false;
+    job.ownsResources = false;
+    job.waitingForResources = false;
+    job.pendingLines = 0;
+    job.firstConcurrentLine = 0;
+
+    BakeError err = startJobOutput(options, scheduler, &job);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    return continueJob(options, scheduler, &job);
+}
+
+
+BakeError continueJob(BakeOptions options, Scheduler * scheduler, Job * job) {
+    bool finished;
+    BakeError err = executeActionLines(options, scheduler, job, &finished);
+    if(err != BAKE_SUCCESS) {
+        job->failed = true;
+        finishJobOutput(options, scheduler, job);
+        return failTarget(options, scheduler, job->target, err);
+    }
+
+    // If all the action lines have been executed, then the target has been executed
+    if(finished) {
+        finishJobOutput(options, scheduler, job);
+        job->target->state = TARGET_EXECUTED;
+        return finishTarget(scheduler, job->target);
+    }
+
+    // Otherwise, add the job to be waited on
+    err = watchJob(scheduler, job);
+    if(err == BAKE_SUCCESS) {
+        err = buf_append(&scheduler->jobs, job, sizeof(Job));
+    }
+
+    if(err != BAKE_SUCCESS) {
+        finishJobOutput(options, scheduler, job);
+    }
+
+    return err;
+}
+
+
+size_t findFreeLane(Scheduler * scheduler) {
+    size_t jobCount = scheduler_jobCount(scheduler);
+    Job * jobs = scheduler_getJobs(scheduler);
+
+    // Find the lowest lane that isn't taken by one of the running jobs
+    size_t lane = 1;
+    bool taken = true;
+    while(taken) {
+        taken = false;
+        for(size_t index = 0; index < jobCount; ++index) {
+            if(jobs[index].target->lane == lane) {
+                taken = true;
+                lane += 1;
+                break;
+            }
+        }
+    }
+
+    return lane;
+}
+
+
+BakeError watchJob(Scheduler * scheduler, Job * job) {
+    // Jobs that are waiting for their concurrent action lines have no process of their own
+    if(job->pid < 0)
+        return BAKE_SUCCESS;
+
+    return events_watchChild(&scheduler->events, job->pid);
+}
+
+
+BakeError startJobOutput(BakeOptions options, Scheduler * scheduler, Job * job) {
+    job->outputFDs[PIPE_READ] = -1;
+    job->outputFDs[PIPE_WRITE] = -1;
+    job->errorFDs[PIPE_READ] = -1;
+    job->errorFDs[PIPE_WRITE] = -1;
+
+    // If we're not synchronising output, the commands of the job write straight to our stdout and stderr
+    if(options.outputSync == OUTPUT_SYNC_NONE)
+        return BAKE_SUCCESS;
+
+    BakeError err = startJobStream(scheduler, job->outputFDs, &job->output);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // If our stdout and stderr go to the same place, like a terminal, collect them together to keep their order
+    if(output_isSameFile(STDOUT_FILENO, STDERR_FILENO))
+        return BAKE_SUCCESS;
+
+    err = startJobStream(scheduler, job->errorFDs, &job->errors);
+    if(err != BAKE_SUCCESS) {
+        finishJobStream(scheduler, job->outputFDs, &job->output);
+        return err;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError startJobStream(Scheduler * scheduler, int fds[2], OutputBuffer * output) {
+    // Create the pipe the commands of the job will write their output to
+    int pipeFDs[2];
+    BakeError err = createPipe(pipeFDs);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // We only read the output that is available, so that a command that leaves
+    // a process running in the background can't stop us from continuing
+    fcntl(pipeFDs[PIPE_READ], F_SETFL, O_NONBLOCK);
+
+    err = output_allocate(output);
+    if(err != BAKE_SUCCESS) {
+        close(pipeFDs[PIPE_READ]);
+        close(pipeFDs[PIPE_WRITE]);
+        return err;
+    }
+
+    // Read the output as it is written, so that the commands never block on a full pipe
+    err = events_watchFD(&scheduler->events, pipeFDs[PIPE_READ]);
+    if(err != BAKE_SUCCESS) {
+        output_free(output);
+        close(pipeFDs[PIPE_READ]);
+        close(pipeFDs[PIPE_WRITE]);
+        return err;
+    }
+
+    fds[PIPE_READ] = pipeFDs[PIPE_READ];
+    fds[PIPE_WRITE] = pipeFDs[PIPE_WRITE];
+    return BAKE_SUCCESS;
+}
+
+
+Redirections jobRedirections(Job * job) {
+    Redirections redirections = noRedirections();
+
+    // If the output of the job is being collected, send stdout and stderr to their pipes
+    if(job->outputFDs[PIPE_WRITE] >= 0) {
+        redirections.output = job->outputFDs[PIPE_WRITE];
+        redirections.error = (job->errorFDs[PIPE_WRITE] >= 0 ? job->errorFDs[PIPE_WRITE] : job->outputFDs[PIPE_WRITE]);
+    }
+
+    return redirections;
+}
+
+
+BakeError printCommand(Job * job, char * command) {
+    // If the output of the job is not being collected, print it straight away
+    if(job->outputFDs[PIPE_READ] < 0) {
+        printf("%s\n", command);
+        return BAKE_SUCCESS;
+    }
+
+    BakeError err = output_append(&job->output, command, strlen(command));
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    return output_append(&job->output, "\n", 1);
+}
+
+
+BakeError runJobBuiltin(Job * job, ActionLine * action, bool * executed, int * exitStatus) {
+    // If the output of the job is not being collected, the builtin can print straight to our stdout and stderr
+    if(job->outputFDs[PIPE_READ] < 0) {
+        // Flush what we've printed, so that it appears before any errors reported by the builtin
+        fflush(stdout);
+
+        runBuiltin(action->arguments, stdout, stderr, executed, exitStatus);
+        return BAKE_SUCCESS;
+    }
+
+    // Otherwise, collect the output of the builtin in memory and add it to the output of the job
+    char * data = NULL;
+    size_t length = 0;
+    FILE * stream = open_memstream(&data, &length);
+    if(stream == NULL) {
+        reportError("Unable to collect output of command %s: %s\n", action->command, strerror(errno));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    // The errors of the builtin are collected separately if the job's stderr is
+    char * errorData = NULL;
+    size_t errorLength = 0;
+    FILE * errorStream = stream;
+    if(job->errorFDs[PIPE_READ] >= 0) {
+        errorStream = open_memstream(&errorData, &errorLength);
+        if(errorStream == NULL) {
+            reportError("Unable to collect errors of command %s: %s\n", action->command, strerror(errno));
+            fclose(stream);
+            free(data);
+            return BAKE_ERROR_MEMORY;
+        }
+    }
+
+    runBuiltin(action->arguments, stream, errorStream, executed, exitStatus);
+    fclose(stream);
+
+    BakeError err = output_append(&job->output, data, length);
+    free(data);
+
+    if(errorStream != stream) {
+        fclose(errorStream);
+        if(err == BAKE_SUCCESS) {
+            err = output_append(&job->errors, errorData, errorLength);
+        }
+
+        free(errorData);
+    }
+
+    return err;
+}
+
+
+BakeError readJobOutput(Job * job) {
+    if(job->outputFDs[PIPE_READ] < 0)
+        return BAKE_SUCCESS;
+
+    BakeError err = readJobStream(job, job->outputFDs[PIPE_READ], &job->output);
+    if(err != BAKE_SUCCESS || job->errorFDs[PIPE_READ] < 0)
+        return err;
+
+    return readJobStream(job, job->errorFDs[PIPE_READ], &job->errors);
+}
+
+
+BakeError readJobStream(Job * job, int fd, OutputBuffer * output) {
+    // Read all the output that is available, without blocking
+    char buf[JOB_OUTPUT_BUFFER_SIZE];
+    ssize_t charsRead;
+    while((charsRead = read(fd, buf, sizeof(buf))) > 0) {
+        BakeError err = output_append(output, buf, (size_t) charsRead);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    if(charsRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        reportError("Unable to read output of target %s: %s\n", job->target->name, strerror(errno));
+        return BAKE_ERROR_IO;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError flushJobOutput(Job * job) {
+    if(job->outputFDs[PIPE_READ] < 0)
+        return BAKE_SUCCESS;
+
+    BakeError err = output_flush(&job->output, stdout);
+    if(job->errorFDs[PIPE_READ] < 0)
+        return err;
+
+    BakeError errorsErr = output_flush(&job->errors, stderr);
+    return (err != BAKE_SUCCESS ? err : errorsErr);
+}
+
+
+void finishJobOutput(BakeOptions options, Scheduler * scheduler, Job * job) {
+    if(job->outputFDs[PIPE_READ] < 0)
+        return;
+
+    // Print the rest of the output of the job, unless we only print the output of jobs that failed
+    readJobOutput(job);
+    if(options.outputSync != OUTPUT_SYNC_FAILED || job->failed) {
+        flushJobOutput(job);
+    }
+
+    finishJobStream(scheduler, job->outputFDs, &job->output);
+    if(job->errorFDs[PIPE_READ] >= 0) {
+        finishJobStream(scheduler, job->errorFDs, &job->errors);
+    }
+}
+
+
+void finishJobStream(Scheduler * scheduler, int fds[2], OutputBuffer * output) {
+    events_unwatchFD(&scheduler->events, fds[PIPE_READ]);
+    close(fds[PIPE_READ]);
+    close(fds[PIPE_WRITE]);
+    fds[PIPE_READ] = -1;
+    fds[PIPE_WRITE] = -1;
+
+    output_free(output);
+}
+
+
+BakeError waitForJob(BakeOptions options, Scheduler * scheduler, double timeout) {
+    size_t jobCount = scheduler_jobCount(scheduler);
+    Job * jobs = scheduler_getJobs(scheduler);
+
+    // Wait for any of the commands we've started to complete, or to write output
+    Event event;
+    BakeError err = events_wait(&scheduler->events, timeout, &event);
+    if(err != BAKE_SUCCESS) {
+        // We can't wait for any of the running jobs, so forget about them
+        for(size_t index = 0; index < jobCount; ++index) {
+            finishJobOutput(options, scheduler, &jobs[index]);
+        }
+
+        buf_reset(&scheduler->jobs);
+        return err;
+    }
+
+    // If a job wrote output, collect it
+    if(event.type == EVENT_READABLE) {
+        for(size_t index = 0; index < jobCount; ++index) {
+            if(jobs[index].outputFDs[PIPE_READ] == event.fd || jobs[index].errorFDs[PIPE_READ] == event.fd)
+                return readJobOutput(&jobs[index]);
+        }
+
+        return BAKE_SUCCESS;
+    }
+
+    // If no command completed before the timeout, there's nothing to do
+    if(event.type != EVENT_CHILD_EXITED)
+        return BAKE_SUCCESS;
+
+    // Find the job whose command completed
+    size_t index = 0;
+    while(index < jobCount && jobs[index].pid != event.pid) {
+        index += 1;
+    }
+
+    // If the process wasn't started by one of our jobs, ignore it
+    if(index == jobCount)
+        return BAKE_SUCCESS;
+
+    Job job = jobs[index];
+
+    // Remove the job from the running jobs by moving the last job into its place
+    jobs[index] = jobs[jobCount - 1];
+    scheduler->jobs.used -= sizeof(Job);
+
+    // Collect the rest of the output of the command
+    err = readJobOutput(&job);
+    if(err != BAKE_SUCCESS) {
+        finishJobOutput(options, scheduler, &job);
+        return err;
+    }
+
+    // Check if the command was successful, and whether we care. Scripts
+    // check whether each of their action lines were successful themselves.
+    int exitStatus = commandExitStatus(event.waitStatus);
+    trace_span(job.target->lane, "command", (job.action != NULL ? job.action->command : "(all action lines)"),
+               (exitStatus != EXIT_SUCCESS ? "failed" : NULL), job.commandStart, monotonicTime());
+
+    // Record the resources the command used, if they are to be reported
+    if(options.usageReportCount > 0 || options.usageJSON != NULL) {
+        err = usage_record(&scheduler->usage, job.target->name, (job.action != NULL ? job.action->command : NULL),
+                           exitStatus, monotonicTime() - job.commandStart, &event.resources);
+        if(err != BAKE_SUCCESS) {
+            finishJobOutput(options, scheduler, &job);
+            return err;
+        }
+    }
+
+    // Concurrent action lines are reported on by the job of their target once they have all completed
+    if(job.concurrent)
+        return finishConcurrentLine(options, scheduler, &job, exitStatus);
+
+    bool aborting = (exitStatus != EXIT_SUCCESS && options.requireSuccess
+                     && (job.statusFD >= 0 || job.action->requireSuccess));
+
+    job.failed |= (exitStatus != EXIT_SUCCESS);
+
+    // If we're stopping all the jobs, we only need to print what the job has written
+    if(scheduler->stopping) {
+        if(job.statusFD >= 0) {
+            close(job.statusFD);
+        }
+
+        finishJobOutput(options, scheduler, &job);
+        return BAKE_SUCCESS;
+    }
+
+    // Commands that timed out always fail their target, even if their failure would be ignored
+    if(job.timedOut) {
+        flushJobOutput(&job);
+        if(job.statusFD >= 0) {
+            close(job.statusFD);
+        }
+
+        reportError("Target %s timed out, %s...\n", job.target->name, failureResponse(options));
+        finishJobOutput(options, scheduler, &job);
+        return failTarget(options, scheduler, job.target, BAKE_ERROR_EXECUTION);
+    }
+
+    // Print the output of the command before reporting that it failed
+    if(options.outputSync == OUTPUT_SYNC_LINE || aborting) {
+        err = flushJobOutput(&job);
+        if(err != BAKE_SUCCESS) {
+            finishJobOutput(options, scheduler, &job);
+            return err;
+        }
+    }
+
+    if(job.statusFD >= 0) {
+        err = finishScript(options, &job, exitStatus);
+        if(err != BAKE_SUCCESS) {
+            finishJobOutput(options, scheduler, &job);
+            return failTarget(options, scheduler, job.target, err);
+        }
+
+    } else if(aborting) {
+        reportError("Command \"%s\" failed, %s...\n", job.action->command, failureResponse(options));
+        finishJobOutput(options, scheduler, &job);
+        return failTarget(options, scheduler, job.target, BAKE_ERROR_EXECUTION);
+    }
+
+    // Continue executing the action lines of the job
+    return continueJob(options, scheduler, &job);
+}
+
+
+double commandTimeout(BakeOptions options, Target * target) {
+    return (target->timeout > 0 ? target->timeout : options.timeout);
+}
+
+
+void startCommandTimer(BakeOptions options, Job * job) {
+    job->commandStart = monotonicTime();
+
+    double timeout = commandTimeout(options, job->target);
+    job->deadline = (timeout > 0 ? job->commandStart + timeout : -1);
+}
+
+
+void signalJob(Job * job, int signal) {
+    // Jobs that are waiting for their concurrent action lines have no process of their own to signal
+    if(job->pid <= 0)
+        return;
+
+    // Signal the whole process group of the job, so that the children of its command are signalled as well
+    kill(-job->pid, signal);
+
+    if(signal == SIGKILL) {
+        job->deadline = -1;
+    } else if(!job->stopping) {
+        // Kill the job if it doesn't stop in time
+        job->stopping = true;
+        job->deadline = monotonicTime() + KILL_GRACE_PERIOD;
+    }
+}
+
+
+void stopJobs(Scheduler * scheduler, int signal) {
+    size_t jobCount = scheduler_jobCount(scheduler);
+    Job * jobs = scheduler_getJobs(scheduler);
+
+    for(size_t index = 0; index < jobCount; ++index) {
+        signalJob(&jobs[index], signal);
+    }
+}
+
+
+double timeUntilDeadline(Scheduler * scheduler) {
+    size_t jobCount = scheduler_jobCount(scheduler);
+    Job * jobs = scheduler_getJobs(scheduler);
+
+    double earliest = -1;
+    for(size_t index = 0; index < jobCount; ++index) {
+        if(jobs[index].deadline >= 0 && (earliest < 0 || jobs[index].deadline < earliest)) {
+            earliest = jobs[index].deadline;
+        }
+    }
+
+    if(earliest < 0)
+        return -1;
+
+    double remaining = earliest - monotonicTime();
+    return (remaining > 0 ? remaining : 0);
+}
+
+
+void checkDeadlines(BakeOptions options, Scheduler * scheduler) {
+    size_t jobCount = scheduler_jobCount(scheduler);
+    Job * jobs = scheduler_getJobs(scheduler);
+    double now = monotonicTime();
+
+    for(size_t index = 0; index < jobCount; ++index) {
+        Job * job = &jobs[index];
+        if(job->deadline < 0 || now < job->deadline)
+            continue;
+
+        // If the job was already asked to stop, it has had long enough
+        if(job->stopping) {
+            reportError("Target %s did not stop within %g seconds, killing it...\n",
+                        job->target->name, KILL_GRACE_PERIOD);
+            signalJob(job, SIGKILL);
+            continue;
+        }
+
+        if(job->action != NULL) {
+            reportError("Command \"%s\" timed out after %g seconds, stopping it...\n",
+                        job->action->command, commandTimeout(options, job->target));
+        } else {
+            reportError("The commands of target %s timed out after %g seconds, stopping them...\n",
+                        job->target->name, commandTimeout(options, job->target));
+        }
+
+        job->timedOut = true;
+        signalJob(job, SIGTERM);
+    }
+}
+
+
+BakeError acquireJobToken(Scheduler * scheduler, size_t runningJobs, bool * acquired) {
+    // Every process may run one job without a token
+    if(scheduler->jobServer == NULL || runningJobs < jobserver_tokenCount(scheduler->jobServer) + 1) {
+        *acquired = true;
+        return BAKE_SUCCESS;
+    }
+
+    return jobserver_acquire(scheduler->jobServer, acquired);
+}
+
+
+BakeError releaseJobTokens(Scheduler * scheduler) {
+    if(scheduler->jobServer == NULL)
+        return BAKE_SUCCESS;
+
+    // Give back the tokens of jobs that have finished, or that were skipped without starting
+    size_t jobCount = tokenJobCount(scheduler);
+    while(jobserver_tokenCount(scheduler->jobServer) > 0 && jobserver_tokenCount(scheduler->jobServer) + 1 > jobCount) {
+        BakeError err = jobserver_release(scheduler->jobServer);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError runScheduler(BakeOptions options, Scheduler * scheduler) {
+    // Stores the first error that occurs, after which we stop starting new jobs
+    BakeError result = BAKE_SUCCESS;
+
+    // Wake up when a signal asks us to stop
+    int interruptFD = interrupts_fd();
+    if(interruptFD >= 0) {
+        result = events_watchFD(&scheduler->events, interruptFD);
+    }
+
+    while(true) {
+        // If we were interrupted, pass the signal on to all the running jobs
+        int signal = interrupts_received();
+        if(signal != 0) {
+            drainFD(interruptFD);
+        }
+
+        if(signal != 0 && !scheduler->interrupted) {
+            if(result == BAKE_SUCCESS) {
+                reportError("Interrupted, stopping all running commands...\n");
+                result = BAKE_ERROR_EXECUTION;
+            }
+
+            scheduler->interrupted = true;
+            scheduler->stopping = true;
+            stopJobs(scheduler, signal);
+        }
+
+        // Start as many ready targets as we are allowed to run at once
+        bool waitingForToken = false;
+        while(result == BAKE_SUCCESS && tqueue_size(&scheduler->ready) > 0) {
+            size_t allowedSlots = limit_allowedJobs(&scheduler->limit, scheduler->usedSlots);
+            if(scheduler->usedSlots >= allowedSlots)
+                break;
+
+            // Hold back targets whose pools are full, so that the targets after them can be started instead
+            Target * target = tqueue_pop(&scheduler->ready);
+            if(!canStartTarget(scheduler, target, allowedSlots)) {
+                result = buf_append(&scheduler->blocked, &target, sizeof(Target *));
+                continue;
+            }
+
+            // If we share our jobs with other processes, we need a token to start another job
+            bool acquired;
+            result = acquireJobToken(scheduler, tokenJobCount(scheduler), &acquired);
+            if(result == BAKE_SUCCESS && !acquired) {
+                waitingForToken = true;
+                result = tqueue_push(&scheduler->ready, target);
+                break;
+            }
+
+            if(result == BAKE_SUCCESS) {
+                result = startJob(options, scheduler, target);
+            }
+        }
+
+        // Return the targets that were held back to be started once the resources they need are free
+        BakeError err = requeueBlockedTargets(scheduler);
+        if(err != BAKE_SUCCESS && result == BAKE_SUCCESS) {
+            result = err;
+        }
+
+        // Give back any tokens we no longer need
+        err = releaseJobTokens(scheduler);
+        if(err != BAKE_SUCCESS && result == BAKE_SUCCESS) {
+            result = err;
+        }
+
+        // Once a job has failed, stop all the other running jobs instead of waiting for them to finish
+        if(result != BAKE_SUCCESS && !scheduler->stopping) {
+            scheduler->stopping = true;
+            stopJobs(scheduler, SIGTERM);
+        }
+
+        // If there are no jobs left running, we're done
+        if(scheduler_jobCount(scheduler) == 0)
+            break;
+
+        // If ready targets are held back by the load of the machine, check the load again periodically
+        double timeout = -1;
+        if(result == BAKE_SUCCESS && tqueue_size(&scheduler->ready) > 0
+           && (scheduler->limit.automatic || scheduler->limit.maxLoad > 0)) {
+            timeout = LOAD_SAMPLE_INTERVAL;
+        }
+
+        // Wake up when a job has executed for too long
+        double untilDeadline = timeUntilDeadline(scheduler);
+        if(untilDeadline >= 0 && (timeout < 0 || untilDeadline < timeout)) {
+            timeout = untilDeadline;
+        }
+
+        // If ready targets are waiting for a token, also wake up when one is written to the jobserver
+        waitingForToken &= (result == BAKE_SUCCESS);
+        if(waitingForToken) {
+            err = events_watchFD(&scheduler->events, scheduler->jobServer->readFD);
+            if(err != BAKE_SUCCESS && result == BAKE_SUCCESS) {
+                result = err;
+                waitingForToken = false;
+            }
+        }
+
+        // Wait for one of the running jobs to make progress
+        err = waitForJob(options, scheduler, timeout);
+        if(err != BAKE_SUCCESS && result == BAKE_SUCCESS) {
+            result = err;
+        }
+
+        if(waitingForToken) {
+            events_unwatchFD(&scheduler->events, scheduler->jobServer->readFD);
+        }
+
+        // Stop the jobs that have executed for too long, and kill those that didn't stop in time
+        checkDeadlines(options, scheduler);
+    }
+
+    if(interruptFD >= 0) {
+        events_unwatchFD(&scheduler->events, interruptFD);
+    }
+
+    // If we kept going after targets failed, report all of them now that everything else has finished
+    if(result == BAKE_SUCCESS && scheduler->failures.used > 0) {
+        reportFailures(scheduler);
+        result = BAKE_ERROR_EXECUTION;
+    }
+
+    return result;
+}
+
+
+BakeError reportUsage(BakeOptions options, Scheduler * scheduler) {
+    if(options.usageReportCount > 0) {
+        BakeError err = usage_print(&scheduler->usage, stdout, options.usageReportCount);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    if(options.usageJSON != NULL)
+        return usage_writeJSON(&scheduler->usage, options.usageJSON);
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError executeTargets(BakeOptions options, Bakefile bakefile, JobServer * jobServer, Target ** targets, size_t count) {
+    // Remember the status of each file we check, so that files many targets depend on are only checked once
+    StatCache statCache;
+    BakeError err = statcache_allocate(&statCache);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Load what was recorded about the targets in previous builds, to decide whether they are still up to date
+    BuildState state;
+    err = state_open(&state, &bakefile, STATE_FILE, !options.onlyPrintCommands,
+                     (options.freshness == FRESHNESS_HASH));
+    if(err != BAKE_SUCCESS) {
+        statcache_free(&statCache);
+        return err;
+    }
+
+    // Allocate the scheduler that will execute the targets
+    Scheduler scheduler;
+    err = scheduler_allocate(&scheduler, options, bakefile);
+    if(err == BAKE_SUCCESS) {
+        scheduler.state = &state;
+        scheduler.jobServer = jobServer;
+        scheduler.statCache = &statCache;
+        err = scheduleTargets(options, bakefile, &scheduler, targets, count);
+        scheduler_free(&scheduler);
+    }
+
+    // Stop recording the targets, compacting the state if most of it is out of date
+    BakeError stateErr = state_close(&state, &bakefile, STATE_FILE);
+    if(err == BAKE_SUCCESS) {
+        err = stateErr;
+    }
+
+    statcache_free(&statCache);
+    return err;
+}
+
+
+BakeError scheduleTargets(BakeOptions options, Bakefile bakefile, Scheduler * scheduler,
+                          Target ** targets, size_t count) {
+    BakeError err;
+
+    // Prepare the targets and all of their dependencies, skipping those that were already prepared
+    double start = monotonicTime();
+    for(size_t index = 0; index < count; ++index) {
+        if(targets[index]->state != TARGET_NOT_EXECUTED)
+            continue;
+
+        err = prepareTarget(options, bakefile, scheduler, targets[index]);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    double end = monotonicTime();
+    trace_span(TRACE_MAIN_LANE, "phase", "prepare", NULL, start, end);
+    stats_addTime(STAT_PHASE_PREPARE, end - start);
+
+    // Check which of the targets are out of date, finding the status of all their files at once first
+    start = monotonicTime();
+    err = prefetchTargetFiles(scheduler);
+    if(err == BAKE_SUCCESS) {
+        err = checkFreshness(scheduler, targets, count);
+    }
+
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    end = monotonicTime();
+    trace_span(TRACE_MAIN_LANE, "phase", "check freshness", NULL, start, end);
+    stats_addTime(STAT_PHASE_FRESHNESS, end - start);
+
+    // Decide which targets to start first, from how long they took the last time they were executed
+    if(scheduler->criticalPathFirst) {
+        err = history_load(&bakefile, HISTORY_FILE);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    err = prioritiseTargets(scheduler);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Execute all the targets that need to be executed
+    start = monotonicTime();
+    err = runScheduler(options, scheduler);
+    end = monotonicTime();
+    trace_span(TRACE_MAIN_LANE, "phase", "execute", NULL, start, end);
+    stats_addTime(STAT_PHASE_EXECUTE, end - start);
+
+    // Report the resources used by the commands that were executed
+    BakeError usageErr = reportUsage(options, scheduler);
+    if(err == BAKE_SUCCESS) {
+        err = usageErr;
+    }
+
+    // Record how long the targets took to execute for the next parallel build, unless they were only printed.
+    // The targets were still built, so failing to record them doesn't fail the build.
+    if(scheduler->criticalPathFirst && !options.onlyPrintCommands) {
+        if(history_save(&bakefile, HISTORY_FILE) != BAKE_SUCCESS) {
+            reportError("Warning: How long the targets took to execute was not recorded in %s\n", HISTORY_FILE);
+        }
+    }
+
+    return err;
 }
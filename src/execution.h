@@ -14,50 +14,895 @@
 #ifndef CITS2002_EXECUTION_H
 #define CITS2002_EXECUTION_H
 
+#include <sys/types.h>
 #include "errors.h"
 #include "stringbuilder.h"
 #include "main.h"
 #include "targets.h"
+#include "targetqueue.h"
+#include "threadpool.h"
+#include "load.h"
+#include "command.h"
+#include "builtins.h"
+#include "events.h"
+#include "output.h"
+#include "history.h"
+#include "jobserver.h"
+#include "interrupts.h"
+#include "usage.h"
+#include "trace.h"
+#include "stats.h"
+#include "statcache.h"
+#include "fingerprints.h"
+#include "state.h"
 
 
 /**
- * Execute the command {@param command}, storing its stdout output into
- * {@param output} and its exit status into {@param exitStatus};
+ * The number of seconds a command is given to exit after it is asked to stop, before it is killed.
+ */
+#define KILL_GRACE_PERIOD  5.0
+
+
+/**
+ * A step of starting a process in forkProgram that may fail in the new process.
+ */
+typedef enum {
+    /**
+     * Giving the process the nice level of one of the pools of its target.
+     */
+    CHILD_STEP_NICE,
+
+    /**
+     * Restricting the process to the CPUs of one of the pools of its target.
+     */
+    CHILD_STEP_AFFINITY,
+
+    /**
+     * Redirecting the file descriptors of the process and executing its program.
+     */
+    CHILD_STEP_EXECUTE
+} ChildStep;
+
+
+/**
+ * A step that failed in a new process started by forkProgram, written back to bake before the program is executed.
+ */
+typedef struct {
+    /**
+     * The step that failed.
+     */
+    ChildStep step;
+
+    /**
+     * The index of the pool whose settings couldn't be applied, among the pool costs of the target.
+     */
+    size_t poolIndex;
+
+    /**
+     * The errno of the failure.
+     */
+    int error;
+} ChildFailure;
+
+
+/**
+ * The file descriptors to give to a new process, each of which is -1 to leave it the same as bake's.
+ */
+typedef struct {
+    /**
+     * The file descriptor to use as stdin.
+     */
+    int input;
+
+    /**
+     * The file descriptor to use as stdout.
+     */
+    int output;
+
+    /**
+     * The file descriptor to use as stderr.
+     */
+    int error;
+
+    /**
+     * The file descriptor to give the process as SCRIPT_STATUS_FD.
+     */
+    int status;
+} Redirections;
+
+
+/**
+ * A target whose action lines are currently being executed.
+ */
+typedef struct {
+    /**
+     * The target being executed.
+     */
+    Target * target;
+
+    /**
+     * The index of the next action line of target to be executed.
+     */
+    size_t nextActionLine;
+
+    /**
+     * The action line whose command is currently executing.
+     */
+    ActionLine * action;
+
+    /**
+     * The process executing the command of action.
+     */
+    pid_t pid;
+
+    /**
+     * The monotonicTime at which the process of the job was started.
+     */
+    double commandStart;
+
+    /**
+     * If all the action lines of target are being executed in one shell, the read end of
+     * the pipe the shell writes the index of a failed action line to. Otherwise -1.
+     */
+    int statusFD;
+
+    /**
+     * If the output of the job is being collected, the pipe its commands write
+     * their stdout to. Otherwise both file descriptors are -1.
+     */
+    int outputFDs[2];
+
+    /**
+     * If the output of the job is being collected and our stderr is not the same file as our stdout,
+     * the pipe its commands write their stderr to. Otherwise both file descriptors are -1, and the
+     * commands write their stderr to outputFDs if the output of the job is being collected.
+     */
+    int errorFDs[2];
+
+    /**
+     * The collected stdout output of the job that has not been printed yet, if its output is being collected.
+     */
+    OutputBuffer output;
+
+    /**
+     * The collected stderr output of the job that has not been printed yet, if it has its own errorFDs.
+     */
+    OutputBuffer errors;
+
+    /**
+     * Whether any of the commands of the job have failed.
+     */
+    bool failed;
+
+    /**
+     * The monotonicTime at which the process of the job is to be stopped if it is still executing,
+     * or killed if it has already been asked to stop. Negative if there is no such time.
+     */
+    double deadline;
+
+    /**
+     * Whether the process of the job has been asked to stop.
+     */
+    bool stopping;
+
+    /**
+     * Whether the process of the job was stopped because it executed for longer than its timeout.
+     */
+    bool timedOut;
+
+    /**
+     * Whether the job executes a single concurrent action line on behalf of the job executing its target.
+     */
+    bool concurrent;
+
+    /**
+     * Whether the job executes a concurrent action line that took job slots, pool tokens and a jobserver
+     * token of its own, rather than using those of its target.
+     */
+    bool ownsResources;
+
+    /**
+     * Whether the job is waiting for one of its concurrent action lines to complete, so that it can
+     * take the resources it needs to start its next concurrent action line.
+     */
+    bool waitingForResources;
+
+    /**
+     * The number of concurrent action lines started by the job that are still executing.
+     */
+    size_t pendingLines;
+
+    /**
+     * The index of the first action line of target whose failure, if it was executed concurrently,
+     * has not yet been checked for.
+     */
+    size_t firstConcurrentLine;
+} Job;
+
+
+/**
+ * Schedules the execution of targets once all of their target dependencies have finished.
+ */
+typedef struct {
+    /**
+     * The targets whose target dependencies have all finished, and are ready to be executed.
+     */
+    TargetQueue ready;
+
+    /**
+     * A buffer containing a list of the Job's that are currently executing.
+     */
+    Buffer jobs;
+
+    /**
+     * The number of job slots taken by the targets that are currently executing,
+     * where each target takes as many slots as its cpus.
+     */
+    size_t usedSlots;
+
+    /**
+     * A buffer containing a list of the ready targets that were held back because
+     * the job slots or pool tokens they need were taken, to be returned to ready.
+     */
+    Buffer blocked;
+
+    /**
+     * The order to be given to the next target that is prepared.
+     */
+    size_t nextOrder;
+
+    /**
+     * A buffer containing a list of the targets that have been prepared, indexed by their order.
+     */
+    Buffer targets;
+
+    /**
+     * A buffer containing a list of the targets whose commands failed, in the order they failed.
+     */
+    Buffer failures;
+
+    /**
+     * Whether ready targets are started in order of the length of the chain of targets after them,
+     * rather than in the order a serial walk would execute them. Hints from .PRIORITY always apply.
+     */
+    bool criticalPathFirst;
+
+    /**
+     * Whether all the running jobs have been asked to stop, after which no more jobs are started.
+     */
+    bool stopping;
+
+    /**
+     * Whether the running jobs have been sent the signal that interrupted bake.
+     */
+    bool interrupted;
+
+    /**
+     * The resources used by each of the commands that have been executed, if they are to be reported.
+     */
+    UsageReport usage;
+
+    /**
+     * Limits the number of jobs that are executed at once.
+     */
+    JobLimit limit;
+
+    /**
+     * Waits for the processes of the jobs to exit.
+     */
+    EventLoop events;
+
+    /**
+     * The shell used to execute commands that can't be executed directly.
+     */
+    char * shell;
+
+    /**
+     * Whether shell behaves like a POSIX shell, so that simple commands can be
+     * executed directly, and action lines can be executed as one shell script.
+     */
+    bool posixShell;
+
+    /**
+     * A map from the names of programs to their paths found from PATH, as found by findProgram.
+     */
+    StringMap programPaths;
+
+    /**
+     * The database that the outcome of each target is recorded in as soon as it finishes,
+     * or NULL if the state of targets is not being kept between builds.
+     */
+    BuildState * state;
+
+    /**
+     * The jobserver that a token must be read from before starting each job after the
+     * first, and written back to once the job has finished, or NULL if there is none.
+     */
+    JobServer * jobServer;
+
+    /**
+     * Remembers the status and hash of each file found during the build, or NULL to stat files every time.
+     */
+    StatCache * statCache;
+
+    /**
+     * How targets are decided to be out of date.
+     */
+    FreshnessMode freshness;
+} Scheduler;
+
+
+/**
+ * Allocate a new Scheduler, limiting its jobs using {@param options} and executing commands
+ * using the shell of {@param bakefile}, and place it in {@param out}.
+ */
+BakeError scheduler_allocate(Scheduler * out, BakeOptions options, Bakefile bakefile);
+
+
+/**
+ * Free the resources of {@param scheduler} and mark it as invalid.
+ */
+void scheduler_free(Scheduler * scheduler);
+
+
+/**
+ * @return the number of jobs that are currently executing in {@param scheduler}
+ */
+size_t scheduler_jobCount(Scheduler * scheduler);
+
+
+/**
+ * @return a pointer to the array of jobs that are currently executing in {@param scheduler}
+ */
+Job * scheduler_getJobs(Scheduler * scheduler);
+
+
+/**
+ * @return Redirections that leave all the file descriptors of a new process the same as bake's
+ */
+Redirections noRedirections(void);
+
+
+/**
+ * Start executing the program at {@param program} with the NULL terminated {@param arguments} in a new
+ * process, the same as spawnProgram. If the program can't be started, the error is stored into
+ * {@param spawnError} and is not reported, so that the caller can decide how to handle it. Otherwise,
+ * {@param spawnError} is set to 0.
+ */
+BakeError startProgram(char * program, char ** arguments, Redirections redirections, bool newGroup,
+                       Target * target, pid_t * pid, int * spawnError);
+
+
+/**
+ * Start executing the program at {@param program} in the same way as startProgram, using fork so that
+ * the new process can be given the nice level and CPU affinity of the pools of {@param target} before
+ * the program is executed. Settings that can't be applied are reported as warnings, and are not
+ * tried again for later processes.
+ */
+BakeError forkProgram(char * program, char ** arguments, Redirections redirections, bool newGroup,
+                      Target * target, pid_t * pid, int * spawnError);
+
+
+/**
+ * Start executing the program at {@param program} with the NULL terminated {@param arguments} in a new
+ * process, placing the ID of the process into {@param pid}. The file descriptors of the new process are
+ * redirected using {@param redirections}. If {@param newGroup} is true, the new process is placed into a
+ * new process group with the same ID as the process, so that it and all of its children can be signalled
+ * at once, and so that signals from the terminal are only passed on to it by bake. If {@param target} is
+ * not NULL, the process is given the nice level and CPU affinity of its pools before the program starts,
+ * so that any processes it starts have them too.
+ */
+BakeError spawnProgram(char * program, char ** arguments, Redirections redirections, bool newGroup,
+                       Target * target, pid_t * pid);
+
+
+/**
+ * Start executing the command {@param command} using {@param shell} in a new process, placing the
+ * ID of the process into {@param pid}. The file descriptors of the new process are redirected
+ * using {@param redirections}, it is placed into a new process group if {@param newGroup} is true,
+ * and it is given the settings of the pools of {@param target} as in spawnProgram.
+ */
+BakeError spawnCommand(char * shell, char * command, Redirections redirections, bool newGroup,
+                       Target * target, pid_t * pid);
+
+
+/**
+ * Start executing the command of {@param action} of {@param target} in a new process, placing the ID of
+ * the process into {@param pid}. Commands that were split into their arguments when they were parsed are
+ * executed directly, and all other commands are executed using the shell of {@param scheduler}.
+ * Programs that can't be executed directly, such as scripts without a #! line, are also left to
+ * the shell. The file descriptors of the new process are redirected using {@param redirections}, it
+ * is placed into a new process group, and it is given the settings of the pools of {@param target}.
+ */
+BakeError spawnActionLine(Scheduler * scheduler, Target * target, ActionLine * action, Redirections redirections,
+                          pid_t * pid);
+
+
+/**
+ * @return the exit status of a command from the status {@param waitStatus} reported by wait.
+ *
+ * Commands that were terminated by a signal are given the exit status 128 plus the signal number.
+ */
+int commandExitStatus(int waitStatus);
+
+
+/**
+ * Execute the command {@param command} using DEFAULT_SHELL, storing its stdout
+ * output into {@param output} and its exit status into {@param exitStatus};
  */
 BakeError executeCommand(char * command, StringBuilder * output, int * exitStatus);
 
 
 /**
- * Run the target {@param target} if it has not already been executed.
+ * Prepare the target dependency {@param dependency} of {@param target} if it has not already been prepared,
+ * and mark that {@param target} cannot be executed until {@param dependency} has finished.
+ */
+BakeError prepareTargetDependency(BakeOptions options, Bakefile bakefile, Scheduler * scheduler,
+                                  Target * target, Target * dependency);
+
+
+/**
+ * Runs through all the dependencies of {@param target}, and resolves which of them are targets. Target
+ * dependencies are prepared, so that {@param target} will be executed once they have all finished, and
+ * will be marked as having its dependencies updated if any of them were executed.
+ */
+BakeError prepareDependencies(BakeOptions options, Bakefile bakefile, Scheduler * scheduler, Target * target);
+
+
+/**
+ * Prepare {@param target} and all of its target dependencies to be executed by {@param scheduler}.
+ *
+ * Targets are added to the ready queue of {@param scheduler} by prioritiseTargets.
+ */
+BakeError prepareTarget(BakeOptions options, Bakefile bakefile, Scheduler * scheduler, Target * target);
+
+
+/**
+ * @return the number of seconds that the prepared target {@param target} is expected to take to execute, given
+ *         whether it will be executed in {@param willExecute}. Targets without a recorded duration that have
+ *         action lines are expected to take {@param defaultDuration} seconds.
+ */
+double estimateDuration(Target * target, bool willExecute, double defaultDuration);
+
+
+/**
+ * Find the length of the longest chain of targets after each prepared target of {@param scheduler}, from
+ * the recorded durations of the targets, and mark the targets that lead to targets listed by .PRIORITY. The
+ * prepared targets that have no target dependencies are then added to the ready queue of {@param scheduler}.
+ *
+ * The modification times of the targets must have already been checked, as targets that won't be
+ * executed are not expected to take any time.
+ */
+BakeError prioritiseTargets(Scheduler * scheduler);
+
+
+/**
+ * Find the modification date of each of the File/URL dependencies of the prepared target {@param target},
+ * and compare it to the modification time of {@param target}. If any were modified more recently, or if
+ * a file dependency does not exist, mark the dependencies of {@param target} as updated.
+ *
+ * With FRESHNESS_HASH, the fingerprint of each file dependency is taken, and if fingerprints were
+ * recorded for {@param target} its file dependencies are only updated if their contents changed.
+ */
+BakeError checkDependencies(Scheduler * scheduler, Target * target);
+
+
+/**
+ * Take the fingerprint of the input file {@param path} of {@param target}, adding it to the fingerprints of
+ * the inputs of {@param target} in this build, and place whether it differs from the fingerprint recorded
+ * for it into {@param changed}. Inputs that weren't recorded have changed.
+ */
+BakeError fingerprintInput(Scheduler * scheduler, Target * target, char * path, bool * changed);
+
+
+/**
+ * Take the fingerprints of the files of the target dependencies of the ready target {@param target}, and
+ * if fingerprints were recorded for {@param target}, mark its dependencies as updated if any of them changed,
+ * or if it no longer has the same inputs. When only printing commands, target dependencies that would
+ * have been executed are assumed to have changed.
+ */
+BakeError checkTargetFingerprints(BakeOptions options, Scheduler * scheduler, Target * target);
+
+
+/**
+ * @return whether the dependency {@param dependency} is a URL rather than a file
+ */
+bool isURLDependency(char * dependency);
+
+
+/**
+ * Find the status of the files of all the prepared targets of {@param scheduler}, and of all their file
+ * dependencies, at once, so that checking the freshness of the targets doesn't have to wait for each of them.
+ */
+BakeError prefetchTargetFiles(Scheduler * scheduler);
+
+
+/**
+ * A task that finds the modification time of the prepared target {@param argument}, and checks
+ * its File/URL dependencies. Submits tasks to {@param worker} to check each of its target
+ * dependencies that have not already been checked. The context of the pool of {@param worker}
+ * must be the Scheduler the target was prepared by.
+ *
+ * Targets with a record that didn't create a file are not executed just because their file doesn't
+ * exist, while targets whose commands have changed since they were recorded are always executed.
+ */
+BakeError checkTargetFreshness(Worker * worker, void * argument);
+
+
+/**
+ * Check the modification times of the {@param count} targets {@param targets} prepared by {@param scheduler}
+ * and all of their target dependencies in parallel, to find which targets are out of date. Each target is
+ * only checked once, however many of {@param targets} depend on it.
+ *
+ * All modification times are found before any targets are executed.
+ */
+BakeError checkFreshness(Scheduler * scheduler, Target ** targets, size_t count);
+
+
+/**
+ * @return whether the ready target {@param target} can be started by {@param scheduler} while {@param allowedSlots}
+ *         job slots may be used, given the job slots and pool tokens it needs. Targets that won't be executed
+ *         can always be started, and a target is always allowed to start if nothing it needs is in use.
+ */
+bool canStartTarget(Scheduler * scheduler, Target * target, size_t allowedSlots);
+
+
+/**
+ * @return whether the job slots and pool tokens that {@param target} needs to execute are free in
+ *         {@param scheduler} while {@param allowedSlots} job slots may be used. They are always
+ *         free if none of the job slots are in use.
+ */
+bool canTakeResources(Scheduler * scheduler, Target * target, size_t allowedSlots);
+
+
+/**
+ * Take the job slots and pool tokens that {@param target} needs to execute in {@param scheduler}.
+ */
+void acquireResources(Scheduler * scheduler, Target * target);
+
+
+/**
+ * Give back the job slots and pool tokens that {@param target} took to execute in {@param scheduler}, if it has any.
+ */
+void releaseResources(Scheduler * scheduler, Target * target);
+
+
+/**
+ * Take the job slots and pool tokens that one process of {@param target} needs in {@param scheduler}.
+ */
+void takeResources(Scheduler * scheduler, Target * target);
+
+
+/**
+ * Give back the job slots and pool tokens that one process of {@param target} took in {@param scheduler}.
+ */
+void giveBackResources(Scheduler * scheduler, Target * target);
+
+
+/**
+ * Take the job slots, pool tokens and jobserver token needed to execute another concurrent action line of
+ * {@param target} in {@param scheduler}, placing whether they were all free into {@param acquired}.
+ * Does not block.
+ */
+BakeError acquireLineResources(Scheduler * scheduler, Target * target, bool * acquired);
+
+
+/**
+ * @return whether the processes of {@param target} are given a nice level or CPU affinity by its pools
+ */
+bool hasPoolSettings(Target * target);
+
+
+/**
+ * Return the ready targets of {@param scheduler} that were held back to its ready queue.
+ */
+BakeError requeueBlockedTargets(Scheduler * scheduler);
+
+
+/**
+ * Mark {@param target} as finished, record how long it took to execute, and add any targets that
+ * depend on it, and that are now ready, to {@param scheduler}.
+ */
+BakeError finishTarget(Scheduler * scheduler, Target * target);
+
+
+/**
+ * If we are keeping going and {@param err} is from a command of {@param target} failing, mark {@param target}
+ * as failed so that the targets that depend on it won't be executed, and carry on executing the other targets
+ * of {@param scheduler}. Otherwise {@param err} is returned, and no more targets will be executed.
+ */
+BakeError failTarget(BakeOptions options, Scheduler * scheduler, Target * target, BakeError err);
+
+
+/**
+ * @return whether any of the target dependencies of {@param target} failed
+ */
+bool hasFailedDependency(Target * target);
+
+
+/**
+ * @return what bake will do now that a command has failed, to be reported along with the failure
+ */
+char * failureResponse(BakeOptions options);
+
+
+/**
+ * Report each of the targets of {@param scheduler} that failed, and how many
+ * targets weren't executed because a target they depend on failed.
+ */
+void reportFailures(Scheduler * scheduler);
+
+
+/**
+ * Print and start the commands of the action lines of {@param job} until one has been
+ * started in a new process, or until the last action line has been executed. If there
+ * are no more action lines to be executed, true will be placed into {@param finished}.
  *
- * If {@param target} has been executed (in this call or previously), true will be placed into {@param executed}.
+ * Concurrent action lines are each started as a separate job, and the following action lines are executed
+ * without waiting for them. The next action line that isn't concurrent, or the end of the target, waits
+ * for them to complete before any failures among them are reported, in the order of the action lines.
+ *
+ * Simple commands that have a builtin are executed within bake, without starting a new process. If the
+ * target of {@param job} is marked to use one shell, all its action lines are started at once.
+ */
+BakeError executeActionLines(BakeOptions options, Scheduler * scheduler, Job * job, bool * finished);
+
+
+/**
+ * Start executing the concurrent action line {@param action} of the target of {@param job} as a separate job,
+ * without waiting for it to complete. Its output is collected along with the output of {@param job}. If
+ * {@param ownsResources}, the line has taken resources of its own, which are given back once it completes.
+ */
+BakeError startConcurrentLine(BakeOptions options, Scheduler * scheduler, Job * job, ActionLine * action,
+                              bool ownsResources);
+
+
+/**
+ * Record that the concurrent action line executed by {@param line} completed with the exit status
+ * {@param exitStatus}, and give back any resources it took. Continues executing the action lines of
+ * its target if it was the last of the concurrent action lines being waited for, or if the target
+ * was waiting for resources to start another.
  */
-BakeError executeTargetDependency(BakeOptions options, Bakefile bakefile, Target * target, bool * executed);
+BakeError finishConcurrentLine(BakeOptions options, Scheduler * scheduler, Job * line, int exitStatus);
 
 
 /**
- * Runs through all the dependencies of {@param target}, and performs the following:
+ * Report each of the concurrent action lines of {@param job} that failed since they were last checked,
+ * in the order they appear in its target.
  *
- *    Targets = If a target dependency has not already been executed, and it
- *              should be, execute it and set dependenciesUpdated to true.
+ * @return BAKE_ERROR_EXECUTION if any of them failed, otherwise BAKE_SUCCESS
+ */
+BakeError checkConcurrentLines(BakeOptions options, Job * job);
+
+
+/**
+ * @return the running job of {@param scheduler} that is executing {@param target}, or NULL if there isn't one
+ */
+Job * findTargetJob(Scheduler * scheduler, Target * target);
+
+
+/**
+ * @return the number of running jobs of {@param scheduler} that each need a jobserver token, which are
+ *         the jobs executing targets and the concurrent action lines that took resources of their own
+ */
+size_t tokenJobCount(Scheduler * scheduler);
+
+
+/**
+ * Start executing all the action lines of the target of {@param job} as a single script in one shell.
+ */
+BakeError executeScript(BakeOptions options, Scheduler * scheduler, Job * job);
+
+
+/**
+ * Read which action line failed from the one shell script of {@param job}, if its exit status
+ * {@param exitStatus} was not successful, and report it. Closes the statusFD of {@param job}.
+ */
+BakeError finishScript(BakeOptions options, Job * job, int exitStatus);
+
+
+/**
+ * Start executing the ready target {@param target}, or skip it if none of its dependencies have been updated.
+ * If any of its target dependencies failed, it is marked as failed without being executed.
+ */
+BakeError startJob(BakeOptions options, Scheduler * scheduler, Target * target);
+
+
+/**
+ * Continue executing the action lines of {@param job}, finishing its target if they have all been
+ * executed, or otherwise adding it to the running jobs of {@param scheduler} to be waited on.
+ */
+BakeError continueJob(BakeOptions options, Scheduler * scheduler, Job * job);
+
+
+/**
+ * @return the lowest job slot, numbered from 1, that isn't used by any of the running jobs of {@param scheduler}
+ */
+size_t findFreeLane(Scheduler * scheduler);
+
+
+/**
+ * Start watching for the process of {@param job} to exit, if it started one.
+ */
+BakeError watchJob(Scheduler * scheduler, Job * job);
+
+
+/**
+ * If the output of jobs is to be synchronised, create the pipes that the commands of {@param job}
+ * write their stdout and stderr to, and start collecting it. If our stdout and stderr are the same
+ * file, a single pipe is used for both, so that the order of what is written to them is kept.
+ */
+BakeError startJobOutput(BakeOptions options, Scheduler * scheduler, Job * job);
+
+
+/**
+ * Create the pipe {@param fds} that the commands of a job write one of their outputs to, and start
+ * collecting what is written to it in {@param output}, watching for it in {@param scheduler}.
+ */
+BakeError startJobStream(Scheduler * scheduler, int fds[2], OutputBuffer * output);
+
+
+/**
+ * @return the Redirections that send the output of the commands of {@param job} to where it is being collected
+ */
+Redirections jobRedirections(Job * job);
+
+
+/**
+ * Print the command {@param command} of {@param job} before it is executed.
+ */
+BakeError printCommand(Job * job, char * command);
+
+
+/**
+ * Execute the command of {@param action} within bake if there is a builtin that supports it, collecting
+ * its output into the output of {@param job}. Places whether it was executed into {@param executed},
+ * and its exit status into {@param exitStatus}.
+ */
+BakeError runJobBuiltin(Job * job, ActionLine * action, bool * executed, int * exitStatus);
+
+
+/**
+ * Collect all the output of {@param job} that is available, without blocking.
+ */
+BakeError readJobOutput(Job * job);
+
+
+/**
+ * Collect all the output of {@param job} that is available from the pipe {@param fd} into {@param output}, without blocking.
+ */
+BakeError readJobStream(Job * job, int fd, OutputBuffer * output);
+
+
+/**
+ * Print all the output that has been collected from {@param job}, its stdout output to our stdout
+ * and its stderr output to our stderr.
+ */
+BakeError flushJobOutput(Job * job);
+
+
+/**
+ * Print the rest of the output of {@param job}, unless only the output of failed jobs is to be printed
+ * and none of its commands failed, and then stop collecting its output.
+ */
+void finishJobOutput(BakeOptions options, Scheduler * scheduler, Job * job);
+
+
+/**
+ * Stop watching for output written to the pipe {@param fds} in {@param scheduler}, close it, and free {@param output}.
+ */
+void finishJobStream(Scheduler * scheduler, int fds[2], OutputBuffer * output);
+
+
+/**
+ * Wait up to {@param timeout} seconds, or forever if {@param timeout} is negative, for the command of any
+ * of the executing jobs of {@param scheduler} to complete, and then continue executing the action lines of
+ * that job. Finishes the job's target if it has completed. Output written by the jobs is collected as it arrives.
+ */
+BakeError waitForJob(BakeOptions options, Scheduler * scheduler, double timeout);
+
+
+/**
+ * @return the number of seconds each command of {@param target} may execute for, or 0 if there is no limit
+ */
+double commandTimeout(BakeOptions options, Target * target);
+
+
+/**
+ * Start timing the command of {@param job} that has just been started, to record how long it executed
+ * for, and to stop it if it executes for too long.
+ */
+void startCommandTimer(BakeOptions options, Job * job);
+
+
+/**
+ * Send {@param signal} to the process group of the command of {@param job}, if it is executing one. Unless
+ * {@param signal} is SIGKILL, the job is killed if it is still executing KILL_GRACE_PERIOD seconds after
+ * it was first asked to stop.
+ */
+void signalJob(Job * job, int signal);
+
+
+/**
+ * Send {@param signal} to the process groups of the commands of all the running jobs of {@param scheduler}.
+ */
+void stopJobs(Scheduler * scheduler, int signal);
+
+
+/**
+ * @return the number of seconds until the earliest deadline of the running jobs of {@param scheduler},
+ *         or -1 if none of them have a deadline
+ */
+double timeUntilDeadline(Scheduler * scheduler);
+
+
+/**
+ * Ask each of the running jobs of {@param scheduler} whose command has timed out to stop,
+ * and kill each of the jobs that were asked to stop but didn't within KILL_GRACE_PERIOD seconds.
+ */
+void checkDeadlines(BakeOptions options, Scheduler * scheduler);
+
+
+/**
+ * Make sure a token is held from the jobserver in use, if there is one, for another job to be started by
+ * {@param scheduler} while {@param runningJobs} jobs that need tokens are running, placing whether the
+ * job may be started into {@param acquired}. Does not block.
+ */
+BakeError acquireJobToken(Scheduler * scheduler, size_t runningJobs, bool * acquired);
+
+
+/**
+ * Write back the tokens held from the jobserver in use, if there is one,
+ * that are no longer needed by the running jobs of {@param scheduler}.
+ */
+BakeError releaseJobTokens(Scheduler * scheduler);
+
+
+/**
+ * Execute the ready targets of {@param scheduler}, running as many jobs at once as its limit allows,
+ * until all targets have finished. If a job fails, no more jobs will be started, and the running jobs are
+ * sent SIGTERM and waited for before returning. If we are keeping going, only the targets that depend on a
+ * failed target are not executed, and the failures are reported once every other target has finished.
  *
- *    Files & URLs = Find the modification date of the File/URL and compare it to {@param targetModificationTime}.
- *                   If it was modified more recently, set dependenciesUpdated to true.
+ * If bake is interrupted by a signal, the signal is passed on to the running jobs in the same way. Commands
+ * that time out are sent SIGTERM, and any job that was sent a signal is killed if it hasn't stopped
+ * within KILL_GRACE_PERIOD seconds.
+ *
+ * If ready targets are held back by a limit that depends on the load of the machine, the limit is
+ * checked again every LOAD_SAMPLE_INTERVAL seconds, even if no jobs complete. If a jobserver is in
+ * use, a token is read from it for each job after the first, and ready targets that are waiting
+ * for a token are started as soon as one is written back. Ready targets that need job slots or
+ * pool tokens that are taken are held back, while later ready targets are started in their place.
+ */
+BakeError runScheduler(BakeOptions options, Scheduler * scheduler);
+
+
+/**
+ * Print the table of the commands executed by {@param scheduler} that used the most CPU time,
+ * and write the resources used by all of them as JSON, if either were asked for in {@param options}.
  */
-BakeError executeDependencies(BakeOptions options, Bakefile bakefile, Target * target,
-                              long targetModificationTime, bool * dependenciesUpdated);
+BakeError reportUsage(BakeOptions options, Scheduler * scheduler);
 
 
 /**
- * Execute the commands of all the action lines in {@param target}.
+ * Execute the {@param count} targets {@param targets}, and any targets that they have as dependencies, together
+ * in one schedule. Targets that more than one of them depend on are only checked and executed once, and the
+ * status of each file is remembered for the whole build, until a target that writes to it is executed.
+ *
+ * The targets recorded in STATE_FILE are loaded first, and the outcome of each target is recorded as it
+ * finishes, unless commands are only being printed. The fingerprints of inputs are only taken with FRESHNESS_HASH.
+ *
+ * If {@param jobServer} is not NULL, a token is read from it before starting each job after the first.
  */
-BakeError executeActionLines(BakeOptions options, Target * target);
+BakeError executeTargets(BakeOptions options, Bakefile bakefile, JobServer * jobServer, Target ** targets, size_t count);
 
 
 /**
- * Execute the target {@param target}, and any targets that it has as dependencies.
+ * Prepare the {@param count} targets {@param targets} and their dependencies in {@param scheduler}, check
+ * which of them are out of date, and execute those that are.
  */
-BakeError executeTarget(BakeOptions options, Bakefile bakefile, Target * target);
+BakeError scheduleTargets(BakeOptions options, Bakefile bakefile, Scheduler * scheduler,
+                          Target ** targets, size_t count);
 
 
 #endif //CITS2002_EXECUTION_H
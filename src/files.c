@@ -3,14 +3,23 @@
    Student number(s):	22494652
  */
 
+// strptime, timegm and O_CLOEXEC are outside C99, and glibc only declares them when a feature-test macro is defined
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdbool.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <memory.h>
 #include <errno.h>
 #include <time.h>
 #include <ctype.h>
 #include "files.h"
 #include "execution.h"
+#include "stats.h"
+#include "statbatch.h"
 
 
 /**
@@ -19,6 +28,34 @@
 #define PIPE_BUFFER_SIZE  1024
 
 
+/**
+ * The buffer size we want to use when we read the contents of a file to hash it.
+ */
+#define HASH_BUFFER_SIZE  65536
+
+
+BakeError createPipe(int pipeFDs[2]) {
+    int err = pipe(pipeFDs);
+    if(err != 0) {
+        reportError("Unable to create pipe: %s\n", strerror(errno));
+        return BAKE_ERROR_IO;
+    }
+
+    // Mark both ends of the pipe to be closed when a command is executed
+    for(int index = 0; index < 2; ++index) {
+        err = fcntl(pipeFDs[index], F_SETFD, FD_CLOEXEC);
+        if(err != 0) {
+            reportError("Unable to mark pipe as close-on-exec: %s\n", strerror(errno));
+            close(pipeFDs[PIPE_READ]);
+            close(pipeFDs[PIPE_WRITE]);
+            return BAKE_ERROR_IO;
+        }
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
 BakeError readPipeContents(int pipeReadFD, StringBuilder * output) {
     // The buffer to use when reading data
     ssize_t charsRead;
@@ -29,8 +66,9 @@ BakeError readPipeContents(int pipeReadFD, StringBuilder * output) {
         strbuilder_appendSubstring(output, buf, (size_t) charsRead);
     }
 
-    // If charsRead is 0, then the pipe was closed
-    if(charsRead == 0)
+    // If charsRead is 0, then the pipe was closed. If the pipe is non-blocking
+    // and would block, then we have read everything written to it so far.
+    if(charsRead == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
         return BAKE_SUCCESS;
 
     // Otherwise, an error occurred
@@ -39,34 +77,136 @@ BakeError readPipeContents(int pipeReadFD, StringBuilder * output) {
 }
 
 
-BakeError getFileModificationTime(char * file, time_t * modTime) {
+void invalidateFileStatus(StatCache * cache, char * file) {
+    if(cache != NULL) {
+        statcache_invalidate(cache, file);
+    }
+}
+
+
+BakeError getFileStatus(StatCache * cache, char * file, FileStatus * out) {
+    // Check whether we already know about the file
+    if(cache != NULL && statcache_lookup(cache, file, out))
+        return BAKE_SUCCESS;
+
     // Get information about the file
     struct stat result;
     int err = stat(file, &result);
+    countStat(STAT_FILE_STATS, 1);
     if(err != 0) {
-        // If the file doesn't exist, we want to set the time to -1
-        if(errno == ENOENT) {
-            errno = 0; // Clear the error
-            *modTime = -1;
-            return BAKE_SUCCESS;
+        // If the file doesn't exist, then it has no other information
+        if(errno != ENOENT) {
+            reportError("Error getting modification time of file %s: %s\n", file, strerror(errno));
+            return BAKE_ERROR_IO;
         }
 
-        reportError("Error getting modification time of file %s: %s\n", file, strerror(errno));
+        errno = 0; // Clear the error
+    }
+
+    statcache_convert((err == 0 ? &result : NULL), out);
+
+    // Remember what we found, so that we don't have to stat the file again
+    if(cache != NULL)
+        return statcache_store(cache, file, *out);
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError prefetchFileStatus(StatCache * cache, char ** files, size_t count) {
+    if(cache == NULL)
+        return BAKE_SUCCESS;
+
+    return statbatch_run(cache, files, count);
+}
+
+
+BakeError getFileModificationTime(StatCache * cache, char * file, FileTime * modTime) {
+    FileStatus status;
+    BakeError err = getFileStatus(cache, file, &status);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // If the file doesn't exist, we want to set the time to -1
+    *modTime = (status.exists ? status.modificationTime : -1);
+    return BAKE_SUCCESS;
+}
+
+
+BakeError hashFile(char * file, uint64_t * out) {
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        reportError("Unable to open %s to hash its contents: %s\n", file, strerror(errno));
         return BAKE_ERROR_IO;
     }
 
-    // Get the modification time of the file in nanoseconds
-    *modTime = result.st_mtimespec.tv_sec;
+    // The buffer is kept off the stack, as files are hashed on the threads that check freshness
+    unsigned char * buf = malloc(HASH_BUFFER_SIZE);
+    if(buf == NULL) {
+        reportError("Unable to allocate memory to hash %s: %s\n", file, strerror(errno));
+        close(fd);
+        return BAKE_ERROR_MEMORY;
+    }
+
+    Hasher hasher;
+    hash_start(&hasher);
+
+    // Hash the file in pieces until we reach its end
+    ssize_t bytesRead;
+    while((bytesRead = read(fd, buf, HASH_BUFFER_SIZE)) != 0) {
+        if(bytesRead < 0) {
+            if(errno == EINTR)
+                continue;
+
+            // Directories have no contents to hash, and hash the same as an empty file
+            if(errno == EISDIR)
+                break;
+
+            reportError("Unable to read %s to hash its contents: %s\n", file, strerror(errno));
+            free(buf);
+            close(fd);
+            return BAKE_ERROR_IO;
+        }
+
+        hash_update(&hasher, buf, (size_t) bytesRead);
+        countStat(STAT_BYTES_HASHED, (size_t) bytesRead);
+    }
+
+    countStat(STAT_FILES_HASHED, 1);
+
+    free(buf);
+    close(fd);
+    *out = hash_finish(&hasher);
     return BAKE_SUCCESS;
 }
 
 
-BakeError findLastModifiedHeader(char * url, char * responseHeader, time_t * modTime) {
+BakeError getFileHash(StatCache * cache, char * file, uint64_t * out) {
+    // Check whether we have already hashed the file in this build
+    if(cache != NULL && statcache_lookupHash(cache, file, out))
+        return BAKE_SUCCESS;
+
+    BakeError err = hashFile(file, out);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Remember the hash, so that other targets that depend on the file don't have to read it again
+    if(cache != NULL) {
+        statcache_storeHash(cache, file, *out);
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError findLastModifiedHeader(char * url, char * responseHeader, FileTime * modTime) {
     const char * lastModifiedPrefix = "Last-Modified: ";
     const size_t lastModifiedLength = strlen(lastModifiedPrefix);
 
-    // Split the responseHeader line by line
-    char * line = strtok(responseHeader, "\n");
+    // Split the responseHeader line by line. strtok_r is used as
+    // URLs may have their modification times found concurrently.
+    char * savePointer;
+    char * line = strtok_r(responseHeader, "\n", &savePointer);
 
     // Loop through all lines of the responseHeader
     do {
@@ -90,6 +230,7 @@ BakeError findLastModifiedHeader(char * url, char * responseHeader, time_t * mod
 
             // Extract the actual time from the date string
             struct tm time;
+            memset(&time, 0, sizeof(time));
             char * excess = strptime(date, "%a, %d %b %Y %H:%M:%S %Z", &time);
 
             // If there was an error getting the time, or we did not consume the whole date, then error
@@ -98,27 +239,29 @@ BakeError findLastModifiedHeader(char * url, char * responseHeader, time_t * mod
                 return BAKE_ERROR_FORMAT;
             }
 
-            // Convert time to the number of seconds since the epoch, and store it into modTime
-            *modTime = mktime(&time);
+            // Convert the time to the number of seconds since the epoch. HTTP dates are always in GMT.
+            time_t seconds = timegm(&time);
 
             // Check if the conversion was successful
-            if(*modTime == -1) {
+            if(seconds == -1) {
                 reportError("There was an error converting time to seconds since the epoch: %s\n", strerror(errno));
                 return BAKE_ERROR_UNKNOWN;
             }
 
+            // HTTP dates only have whole seconds, which compare as the start of that second
+            *modTime = fileTimeFromSeconds(seconds);
             return BAKE_SUCCESS;
         }
 
-        // Call with NULL uses state from first strtok call
-    } while((line = strtok(NULL, "\n")) != NULL);
+        // Call with NULL uses state from first strtok_r call
+    } while((line = strtok_r(NULL, "\n", &savePointer)) != NULL);
 
     reportError("Couldn't find Last-Modified property from header of URL %s\n", url);
     return BAKE_ERROR_FORMAT;
 }
 
 
-BakeError getURLModificationTime(char * url, time_t * modTime) {
+BakeError getURLModificationTime(char * url, FileTime * modTime) {
     /*
      * The curl command we want to run.
      *
@@ -127,6 +270,7 @@ BakeError getURLModificationTime(char * url, time_t * modTime) {
      *   --head   = Only read the header of the URL, not the body
      */
     char * curlCommandPrefix = "curl --silent --head ";
+    countStat(STAT_URL_REQUESTS, 1);
 
     // Allocate a builder to store the command we want to execute
     StringBuilder command;
@@ -311,6 +455,9 @@ BakeError readWholeLine(FILE * file, StringBuilder * lineBuilder, StringBuilder
         char * line = strbuilder_get(lineBuilder);
         size_t lineLength = strlen(line);
 
+        countStat(STAT_LINES_PARSED, 1);
+        countStat(STAT_BYTES_PARSED, lineLength + 1);
+
         // If this is a continuation line, we want to remove all leading whitespace
         if(linesRead > 0) {
             while(isspace(*line)) {
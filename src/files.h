@@ -17,6 +17,8 @@
 #include <sys/stat.h>
 #include "main.h"
 #include "stringbuilder.h"
+#include "statcache.h"
+#include "hash.h"
 
 
 /**
@@ -31,31 +33,77 @@
 #define PIPE_WRITE  1
 
 
+/**
+ * Create a pipe, placing its read and write file descriptors into {@param pipeFDs}.
+ *
+ * Both ends of the pipe are marked close-on-exec, so that they are not
+ * leaked into any of the other commands that are executed concurrently.
+ */
+BakeError createPipe(int pipeFDs[2]);
+
+
 /**
  * Read all the contents from {@param pipeReadFD} and write it into {@param output}.
+ *
+ * If {@param pipeReadFD} is non-blocking, only the contents already written to the pipe are read.
  */
 BakeError readPipeContents(int pipeReadFD, StringBuilder * output);
 
 
 /**
- * Get the modification time of the file {@param file} and place it into {@param mtimeNS}.
+ * Stop remembering the status of the file {@param file} in {@param cache}, as it may have been written to.
+ * Does nothing if {@param cache} is NULL.
+ */
+void invalidateFileStatus(StatCache * cache, char * file);
+
+
+/**
+ * Get the status of the file {@param file} and place it into {@param out}, only calling stat if it
+ * isn't remembered by {@param cache}. If {@param cache} is NULL, the file is stat'ed every time.
+ */
+BakeError getFileStatus(StatCache * cache, char * file, FileStatus * out);
+
+
+/**
+ * Find the status of each of the {@param count} files {@param files} at once, and place them into
+ * {@param cache} so that getFileStatus won't have to stat them. Does nothing if {@param cache} is NULL.
+ */
+BakeError prefetchFileStatus(StatCache * cache, char ** files, size_t count);
+
+
+/**
+ * Get the modification time of the file {@param file} and place it into {@param modTime},
+ * using {@param cache} as in getFileStatus.
  *
- * If the file does not exist, -1 will be placed into {@param mtimeNS}.
+ * If the file does not exist, -1 will be placed into {@param modTime}.
+ */
+BakeError getFileModificationTime(StatCache * cache, char * file, FileTime * modTime);
+
+
+/**
+ * Hash the contents of the file {@param file}, and place the hash into {@param out}.
+ */
+BakeError hashFile(char * file, uint64_t * out);
+
+
+/**
+ * Get the hash of the contents of the existing file {@param file} and place it into {@param out},
+ * only reading the file if its hash isn't remembered by {@param cache}, which may be NULL.
  */
-BakeError getFileModificationTime(char * file, time_t * modTime);
+BakeError getFileHash(StatCache * cache, char * file, uint64_t * out);
 
 
 /**
  * Find the value of the "Last-Modified" header from the URL response
  * {@param responseHeader}, and place its value into {@param modTime}.
  */
-BakeError findLastModifiedHeader(char * url, char * responseHeader, time_t * modTime);
+BakeError findLastModifiedHeader(char * url, char * responseHeader, FileTime * modTime);
 
 
 /**
- * Get the modification time of the file found at the URL {@param url} and place it into {@param mtimeNS}.
+ * Get the modification time of the file found at the URL {@param url} and place it into {@param modTime}.
  */
-BakeError getURLModificationTime(char * url, time_t * modTime);
+BakeError getURLModificationTime(char * url, FileTime * modTime);
 
 
 /**
@@ -0,0 +1,57 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === filetime ===
+//
+// The times that files and URLs were last modified, keeping the nanoseconds of the times
+// recorded by the file system, so that files written within the same second are still ordered.
+//
+
+#ifndef CITS2002_FILETIME_H
+#define CITS2002_FILETIME_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+
+
+/**
+ * The number of nanoseconds in a second.
+ */
+#define NANOSECONDS_PER_SECOND  1000000000
+
+
+/**
+ * The time a file or URL was last modified, as the number of nanoseconds since the epoch,
+ * or -1 if it doesn't exist. Times can be compared directly with each other.
+ */
+typedef int64_t FileTime;
+
+
+/**
+ * @return the FileTime of the time {@param seconds}, in seconds since the epoch
+ */
+#define fileTimeFromSeconds(seconds)  ((FileTime) (seconds) * NANOSECONDS_PER_SECOND)
+
+
+/**
+ * @return the FileTime of the struct timespec {@param spec}
+ */
+#define fileTimeFromTimespec(spec)  (fileTimeFromSeconds((spec).tv_sec) + (FileTime) (spec).tv_nsec)
+
+
+/**
+ * @return the struct timespec of the modification time in the struct stat pointed to by {@param result}
+ */
+#ifdef __APPLE__
+#define statModificationTime(result)  ((result)->st_mtimespec)
+#else
+#define statModificationTime(result)  ((result)->st_mtim)
+#endif
+
+
+#endif //CITS2002_FILETIME_H
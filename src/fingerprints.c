@@ -0,0 +1,97 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+// strdup is POSIX rather than C99, so glibc needs a feature-test macro to declare it
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "fingerprints.h"
+#include "files.h"
+
+
+bool fingerprints_parse(char * line, char * lineEnd, Fingerprint * out) {
+    if(lineEnd - line < 2 || strncmp(line, "I\t", 2) != 0)
+        return false;
+
+    // Each number is followed by a tab, which stops it from being read past the end of the line
+    char * end;
+    errno = 0;
+    out->hash = strtoull(&line[2], &end, 16);
+    if(*end != '\t')
+        return false;
+
+    out->modificationTime = strtoll(end + 1, &end, 10);
+    if(*end != '\t')
+        return false;
+
+    out->size = (off_t) strtoll(end + 1, &end, 10);
+    if(*end != '\t')
+        return false;
+
+    out->inode = (ino_t) strtoull(end + 1, &end, 10);
+    if(*end != '\t' || end >= lineEnd || errno != 0)
+        return false;
+
+    out->path = end + 1;
+    return true;
+}
+
+
+BakeError fingerprints_format(StringBuilder * builder, Fingerprint * fingerprint) {
+    return strbuilder_appendFormat(builder, "I\t%016" PRIx64 "\t%" PRId64 "\t%lld\t%llu\t%s\n",
+                                   fingerprint->hash, fingerprint->modificationTime, (long long) fingerprint->size,
+                                   (unsigned long long) fingerprint->inode, fingerprint->path);
+}
+
+
+Fingerprint * fingerprints_find(Fingerprint * fingerprints, size_t count, char * path, size_t hint) {
+    if(hint < count && strcmp(fingerprints[hint].path, path) == 0)
+        return &fingerprints[hint];
+
+    for(size_t index = 0; index < count; ++index) {
+        if(strcmp(fingerprints[index].path, path) == 0)
+            return &fingerprints[index];
+    }
+
+    return NULL;
+}
+
+
+BakeError fingerprints_take(StatCache * cache, char * path, Fingerprint * recorded, Fingerprint * out) {
+    FileStatus status;
+    BakeError err = getFileStatus(cache, path, &status);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    out->hash = 0;
+    out->modificationTime = (status.exists ? status.modificationTime : -1);
+    out->size = (status.exists ? status.size : 0);
+    out->inode = (status.exists ? status.inode : 0);
+
+    // Only read the file if it may have changed since its hash was recorded
+    if(status.exists) {
+        if(recorded != NULL && recorded->modificationTime == out->modificationTime
+           && recorded->size == out->size && recorded->inode == out->inode) {
+            out->hash = recorded->hash;
+        } else {
+            err = getFileHash(cache, path, &out->hash);
+            if(err != BAKE_SUCCESS)
+                return err;
+        }
+    }
+
+    out->path = strdup(path);
+    if(out->path == NULL) {
+        reportError("Unable to allocate memory for fingerprint of %s: %s\n", path, strerror(errno));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    return BAKE_SUCCESS;
+}
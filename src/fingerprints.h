@@ -0,0 +1,62 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === fingerprints ===
+//
+// Takes a fingerprint of each input of a target, holding a hash of its contents, so that with
+// --freshness=hash a target is only executed again if the contents of one of its inputs changed.
+// The modification time, size and inode of each input are kept alongside its hash, so that inputs
+// that haven't been touched since their fingerprint was recorded don't have to be read again.
+//
+// Fingerprints are recorded in the build state as a line for each input, holding "I", the hash
+// in hexadecimal, the modification time in nanoseconds, the size, the inode and the path,
+// separated by tabs.
+//
+
+#ifndef CITS2002_FINGERPRINTS_H
+#define CITS2002_FINGERPRINTS_H
+
+#include <stdbool.h>
+#include "errors.h"
+#include "targets.h"
+#include "statcache.h"
+#include "stringbuilder.h"
+
+
+/**
+ * Read the line {@param line} describing one input, which ends at {@param lineEnd}, into {@param out}.
+ * The path placed into {@param out} is not copied, and runs from within {@param line} up to {@param lineEnd}.
+ *
+ * @return whether the line was well formed
+ */
+bool fingerprints_parse(char * line, char * lineEnd, Fingerprint * out);
+
+
+/**
+ * Append the line describing {@param fingerprint} to {@param builder}.
+ */
+BakeError fingerprints_format(StringBuilder * builder, Fingerprint * fingerprint);
+
+
+/**
+ * Find the fingerprint of {@param path} among the {@param count} fingerprints {@param fingerprints}, checking
+ * the fingerprint at {@param hint} first, as inputs are usually recorded in the same order they are checked.
+ *
+ * @return the fingerprint of {@param path}, or NULL if there is none
+ */
+Fingerprint * fingerprints_find(Fingerprint * fingerprints, size_t count, char * path, size_t hint);
+
+
+/**
+ * Find the fingerprint of the file {@param path} as it is now, and place it into {@param out}. If the file has
+ * the same modification time, size and inode as in {@param recorded}, which may be NULL, then its recorded hash
+ * is used instead of reading it again. The status and hash of the file are looked up in {@param cache} first.
+ */
+BakeError fingerprints_take(StatCache * cache, char * path, Fingerprint * recorded, Fingerprint * out);
+
+
+#endif //CITS2002_FINGERPRINTS_H
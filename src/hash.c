@@ -0,0 +1,145 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+#include <string.h>
+#include "hash.h"
+
+
+/**
+ * The primes used by XXH64.
+ */
+#define PRIME_1  0x9E3779B185EBCA87ULL
+#define PRIME_2  0xC2B2AE3D27D4EB4FULL
+#define PRIME_3  0x165667B19E3779F9ULL
+#define PRIME_4  0x85EBCA77C2B2AE63ULL
+#define PRIME_5  0x27D4EB2F165667C5ULL
+
+
+void hash_start(Hasher * hasher) {
+    hasher->length = 0;
+    hasher->lanes[0] = PRIME_1 + PRIME_2;
+    hasher->lanes[1] = PRIME_2;
+    hasher->lanes[2] = 0;
+    hasher->lanes[3] = -PRIME_1;
+    hasher->stripeUsed = 0;
+}
+
+
+void hash_update(Hasher * hasher, const void * data, size_t length) {
+    const unsigned char * bytes = data;
+    hasher->length += length;
+
+    // Fill up the stripe left over from the last update first
+    if(hasher->stripeUsed > 0) {
+        size_t needed = HASH_STRIPE_SIZE - hasher->stripeUsed;
+        size_t copied = (length < needed ? length : needed);
+
+        memcpy(&hasher->stripe[hasher->stripeUsed], bytes, copied);
+        hasher->stripeUsed += copied;
+        bytes += copied;
+        length -= copied;
+
+        if(hasher->stripeUsed < HASH_STRIPE_SIZE)
+            return;
+
+        hash_stripe(hasher, hasher->stripe);
+        hasher->stripeUsed = 0;
+    }
+
+    // Hash the whole stripes straight from the data
+    while(length >= HASH_STRIPE_SIZE) {
+        hash_stripe(hasher, bytes);
+        bytes += HASH_STRIPE_SIZE;
+        length -= HASH_STRIPE_SIZE;
+    }
+
+    // Keep the rest until there is a whole stripe, or the hash is finished
+    memcpy(hasher->stripe, bytes, length);
+    hasher->stripeUsed = length;
+}
+
+
+uint64_t hash_finish(Hasher * hasher) {
+    uint64_t hash;
+
+    if(hasher->length >= HASH_STRIPE_SIZE) {
+        uint64_t * lanes = hasher->lanes;
+        hash = hash_rotate(lanes[0], 1) + hash_rotate(lanes[1], 7)
+               + hash_rotate(lanes[2], 12) + hash_rotate(lanes[3], 18);
+
+        // Merge each of the lanes into the hash
+        for(int index = 0; index < 4; ++index) {
+            hash ^= hash_round(0, lanes[index]);
+            hash = hash * PRIME_1 + PRIME_4;
+        }
+    } else {
+        hash = PRIME_5;
+    }
+
+    hash += hasher->length;
+
+    // Add the bytes that didn't fill a stripe
+    const unsigned char * bytes = hasher->stripe;
+    size_t remaining = hasher->stripeUsed;
+
+    for(; remaining >= 8; bytes += 8, remaining -= 8) {
+        hash ^= hash_round(0, hash_read64(bytes));
+        hash = hash_rotate(hash, 27) * PRIME_1 + PRIME_4;
+    }
+
+    if(remaining >= 4) {
+        hash ^= (uint64_t) hash_read32(bytes) * PRIME_1;
+        hash = hash_rotate(hash, 23) * PRIME_2 + PRIME_3;
+        bytes += 4;
+        remaining -= 4;
+    }
+
+    for(; remaining > 0; bytes += 1, remaining -= 1) {
+        hash ^= *bytes * PRIME_5;
+        hash = hash_rotate(hash, 11) * PRIME_1;
+    }
+
+    // Mix the bits of the hash so that every bit of the data affects all of them
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+
+uint64_t hash_round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * PRIME_2;
+    accumulator = hash_rotate(accumulator, 31);
+    return accumulator * PRIME_1;
+}
+
+
+void hash_stripe(Hasher * hasher, const unsigned char * stripe) {
+    for(int index = 0; index < 4; ++index) {
+        hasher->lanes[index] = hash_round(hasher->lanes[index], hash_read64(&stripe[index * 8]));
+    }
+}
+
+
+uint64_t hash_read64(const unsigned char * bytes) {
+    uint64_t value = 0;
+    for(int index = 7; index >= 0; --index) {
+        value = (value << 8) | bytes[index];
+    }
+
+    return value;
+}
+
+
+uint32_t hash_read32(const unsigned char * bytes) {
+    return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+
+uint64_t hash_rotate(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
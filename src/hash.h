@@ -0,0 +1,102 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === hash ===
+//
+// Computes the 64-bit XXH64 hash of data that is given in pieces, such as the contents
+// of a file as it is read. XXH64 hashes several gigabytes a second, so that hashing the
+// inputs of targets costs little more than reading them.
+//
+
+#ifndef CITS2002_HASH_H
+#define CITS2002_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * The number of bytes that are hashed at a time, in four lanes of eight bytes.
+ */
+#define HASH_STRIPE_SIZE  32
+
+
+/**
+ * The state of a hash of data that is given in pieces.
+ */
+typedef struct {
+    /**
+     * The total number of bytes that have been hashed.
+     */
+    uint64_t length;
+
+    /**
+     * The accumulators of each of the four lanes of a stripe.
+     */
+    uint64_t lanes[4];
+
+    /**
+     * The bytes that have been given that don't yet fill a stripe.
+     */
+    unsigned char stripe[HASH_STRIPE_SIZE];
+
+    /**
+     * The number of bytes in stripe.
+     */
+    size_t stripeUsed;
+} Hasher;
+
+
+/**
+ * Start a new hash in {@param hasher}.
+ */
+void hash_start(Hasher * hasher);
+
+
+/**
+ * Add the {@param length} bytes of {@param data} to the hash in {@param hasher}.
+ */
+void hash_update(Hasher * hasher, const void * data, size_t length);
+
+
+/**
+ * @return the hash of all the data given to {@param hasher}
+ */
+uint64_t hash_finish(Hasher * hasher);
+
+
+/**
+ * @return the accumulator {@param accumulator} of a lane after adding the eight bytes {@param input} to it
+ */
+uint64_t hash_round(uint64_t accumulator, uint64_t input);
+
+
+/**
+ * Add the stripe of HASH_STRIPE_SIZE bytes {@param stripe} to the lanes of {@param hasher}.
+ */
+void hash_stripe(Hasher * hasher, const unsigned char * stripe);
+
+
+/**
+ * @return the eight bytes at {@param bytes} read as a little-endian integer
+ */
+uint64_t hash_read64(const unsigned char * bytes);
+
+
+/**
+ * @return the four bytes at {@param bytes} read as a little-endian integer
+ */
+uint32_t hash_read32(const unsigned char * bytes);
+
+
+/**
+ * @return {@param value} rotated left by {@param bits} bits
+ */
+uint64_t hash_rotate(uint64_t value, int bits);
+
+
+#endif //CITS2002_HASH_H
@@ -0,0 +1,125 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "history.h"
+#include "files.h"
+
+
+BakeError history_load(Bakefile * bakefile, char * path) {
+    FILE * file = fopen(path, "r");
+    if(file == NULL) {
+        // If no targets have been recorded yet, there is nothing to load
+        if(errno == ENOENT)
+            return BAKE_SUCCESS;
+
+        reportError("Unable to open history file %s: %s\n", path, strerror(errno));
+        return BAKE_ERROR_IO;
+    }
+
+    StringBuilder line;
+    BakeError err = strbuilder_allocate(&line, 64);
+    if(err != BAKE_SUCCESS) {
+        fclose(file);
+        return err;
+    }
+
+    while(true) {
+        strbuilder_reset(&line);
+
+        err = readSingleLine(file, &line);
+        if(err != BAKE_SUCCESS) {
+            // Reaching the end of the file is not an error
+            if(err == BAKE_ERROR_EOF) {
+                err = BAKE_SUCCESS;
+            }
+            break;
+        }
+
+        // Split the line into the duration and the name of the target
+        char * contents = strbuilder_get(&line);
+        char * name = strchr(contents, '\t');
+        if(name == NULL)
+            continue;
+
+        *name = '\0';
+        name += 1;
+
+        char * end;
+        double duration = strtod(contents, &end);
+
+        // Lines that are malformed, or for targets that no longer exist, are ignored
+        Target * target = bakefile_getTarget(bakefile, name);
+        if(target == NULL || *end != '\0' || end == contents || duration < 0)
+            continue;
+
+        target->expectedDuration = duration;
+    }
+
+    strbuilder_free(&line);
+    fclose(file);
+    return err;
+}
+
+
+BakeError history_save(Bakefile * bakefile, char * path) {
+    // Write the history to a temporary file first, and then move it over the old history
+    StringBuilder tempPath;
+    BakeError err = strbuilder_allocate(&tempPath, 64);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    err = strbuilder_appendFormat(&tempPath, "%s.tmp", path);
+    if(err != BAKE_SUCCESS) {
+        strbuilder_free(&tempPath);
+        return err;
+    }
+
+    FILE * file = fopen(strbuilder_get(&tempPath), "w");
+    if(file == NULL) {
+        reportError("Unable to create history file %s: %s\n", strbuilder_get(&tempPath), strerror(errno));
+        strbuilder_free(&tempPath);
+        return BAKE_ERROR_IO;
+    }
+
+    size_t targetCount = strmap_size(&bakefile->targets);
+    StringMapEntry * entries = strmap_entries(&bakefile->targets);
+
+    for(size_t index = 0; index < targetCount; ++index) {
+        Target * target = entries[index].value;
+
+        // Prefer the duration from this build over the one previously recorded
+        double duration = (target->duration >= 0 ? target->duration : target->expectedDuration);
+        if(duration < 0)
+            continue;
+
+        fprintf(file, "%.6f\t%s\n", duration, target->name);
+    }
+
+    if(ferror(file)) {
+        reportError("Unable to write history file %s: %s\n", strbuilder_get(&tempPath), strerror(errno));
+        err = BAKE_ERROR_IO;
+    }
+
+    if(fclose(file) != 0 && err == BAKE_SUCCESS) {
+        reportError("Unable to write history file %s: %s\n", strbuilder_get(&tempPath), strerror(errno));
+        err = BAKE_ERROR_IO;
+    }
+
+    if(err == BAKE_SUCCESS && rename(strbuilder_get(&tempPath), path) != 0) {
+        reportError("Unable to replace history file %s: %s\n", path, strerror(errno));
+        err = BAKE_ERROR_IO;
+    }
+
+    if(err != BAKE_SUCCESS) {
+        remove(strbuilder_get(&tempPath));
+    }
+
+    strbuilder_free(&tempPath);
+    return err;
+}
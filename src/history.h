@@ -0,0 +1,46 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === history ===
+//
+// Records how long each target took to execute in a small file, so that the next
+// build can start the targets on its longest chains of dependencies first.
+//
+// Each line of the file holds the number of seconds a target took to execute,
+// followed by a tab and the name of the target.
+//
+
+#ifndef CITS2002_HISTORY_H
+#define CITS2002_HISTORY_H
+
+#include "errors.h"
+#include "targets.h"
+
+
+/**
+ * The file, relative to the directory bake is run in, that the durations of targets are recorded in.
+ */
+#define HISTORY_FILE  ".bake_history"
+
+
+/**
+ * Read the durations recorded in the history file {@param path} into the expectedDuration of each
+ * target of {@param bakefile}. It is not an error for the file to not exist, or for it to mention
+ * targets that are no longer in {@param bakefile}.
+ */
+BakeError history_load(Bakefile * bakefile, char * path);
+
+
+/**
+ * Write the duration of each target of {@param bakefile} into the history file {@param path}. Targets that
+ * were not executed keep the duration that was previously recorded for them. The file is replaced atomically,
+ * so that it is never left half written.
+ */
+BakeError history_save(Bakefile * bakefile, char * path);
+
+
+#endif //CITS2002_HISTORY_H
@@ -0,0 +1,136 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+// SA_RESTART is an X/Open extension that glibc only declares when a feature-test macro asks for it
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "interrupts.h"
+#include "files.h"
+
+
+/**
+ * The signals that are caught.
+ */
+static const int caughtSignals[INTERRUPT_SIGNAL_COUNT] = {SIGINT, SIGTERM, SIGHUP};
+
+
+/**
+ * How each of caughtSignals was handled before we started catching them.
+ */
+static struct sigaction previousActions[INTERRUPT_SIGNAL_COUNT];
+
+
+/**
+ * The first signal that was caught, or 0 if none have been.
+ */
+static volatile sig_atomic_t receivedSignal = 0;
+
+
+/**
+ * The pipe that is written to whenever a signal is caught, or -1's if signals aren't being caught.
+ */
+static int interruptPipe[2] = {-1, -1};
+
+
+void notifyInterrupted(int signal) {
+    if(receivedSignal == 0) {
+        receivedSignal = signal;
+    }
+
+    int savedErrno = errno;
+    ssize_t written = write(interruptPipe[PIPE_WRITE], "", 1);
+    (void) written;
+    errno = savedErrno;
+}
+
+
+BakeError interrupts_install(void) {
+    BakeError err = createPipe(interruptPipe);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    fcntl(interruptPipe[PIPE_READ], F_SETFL, O_NONBLOCK);
+    fcntl(interruptPipe[PIPE_WRITE], F_SETFL, O_NONBLOCK);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = notifyInterrupted;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    for(size_t index = 0; index < INTERRUPT_SIGNAL_COUNT; ++index) {
+        // Signals that were ignored when we were started, such as SIGINT in background jobs, stay ignored
+        if(sigaction(caughtSignals[index], NULL, &previousActions[index]) == 0
+           && previousActions[index].sa_handler == SIG_IGN) {
+            continue;
+        }
+
+        if(sigaction(caughtSignals[index], &action, NULL) != 0) {
+            reportError("Unable to handle signal %i: %s\n", caughtSignals[index], strerror(errno));
+
+            // Put back the handlers we've already replaced
+            while(index > 0) {
+                index -= 1;
+                sigaction(caughtSignals[index], &previousActions[index], NULL);
+            }
+
+            close(interruptPipe[PIPE_READ]);
+            close(interruptPipe[PIPE_WRITE]);
+            interruptPipe[PIPE_READ] = -1;
+            interruptPipe[PIPE_WRITE] = -1;
+            return BAKE_ERROR_UNKNOWN;
+        }
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+void interrupts_restore(void) {
+    if(interruptPipe[PIPE_READ] < 0)
+        return;
+
+    for(size_t index = 0; index < INTERRUPT_SIGNAL_COUNT; ++index) {
+        sigaction(caughtSignals[index], &previousActions[index], NULL);
+    }
+
+    close(interruptPipe[PIPE_READ]);
+    close(interruptPipe[PIPE_WRITE]);
+    interruptPipe[PIPE_READ] = -1;
+    interruptPipe[PIPE_WRITE] = -1;
+}
+
+
+int interrupts_received(void) {
+    return receivedSignal;
+}
+
+
+int interrupts_fd(void) {
+    return interruptPipe[PIPE_READ];
+}
+
+
+void interrupts_reraise(void) {
+    if(receivedSignal == 0)
+        return;
+
+    // Make sure the signal isn't ignored or blocked, so that it terminates us
+    signal(receivedSignal, SIG_DFL);
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, receivedSignal);
+    sigprocmask(SIG_UNBLOCK, &signals, NULL);
+
+    raise(receivedSignal);
+}
@@ -0,0 +1,65 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === interrupts ===
+//
+// Catches the signals that ask bake to stop, such as SIGINT when Ctrl-C is pressed, so that
+// bake can stop all the commands it is executing before it exits. The commands of jobs are
+// started in their own process groups, so they only receive these signals through bake.
+//
+
+#ifndef CITS2002_INTERRUPTS_H
+#define CITS2002_INTERRUPTS_H
+
+#include "errors.h"
+
+
+/**
+ * The number of signals that are caught.
+ */
+#define INTERRUPT_SIGNAL_COUNT  3
+
+
+/**
+ * Start catching SIGINT, SIGTERM and SIGHUP, instead of letting them terminate bake.
+ */
+BakeError interrupts_install(void);
+
+
+/**
+ * Stop catching signals, restoring how they were handled before interrupts_install was called.
+ */
+void interrupts_restore(void);
+
+
+/**
+ * @return the first signal that has been caught, or 0 if none have been caught
+ */
+int interrupts_received(void);
+
+
+/**
+ * @return a non-blocking file descriptor that becomes readable whenever a signal is caught, or -1 if
+ *         signals aren't being caught. Once read from, it only becomes readable again on the next signal.
+ */
+int interrupts_fd(void);
+
+
+/**
+ * If a signal was caught, terminate bake with that signal, so that whatever started
+ * bake can tell that it was interrupted. Signals must no longer be caught.
+ */
+void interrupts_reraise(void);
+
+
+/**
+ * Handles a signal by recording it, and writing to the pipe of interrupts_fd so that the event loop wakes up.
+ */
+void notifyInterrupted(int signal);
+
+
+#endif //CITS2002_INTERRUPTS_H
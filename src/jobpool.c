@@ -0,0 +1,141 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+// sched_setaffinity and the CPU_* macros are only declared by glibc when _GNU_SOURCE is defined
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/resource.h>
+#include "jobpool.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+
+BakeError jobpool_allocate(JobPool * out, size_t depth) {
+    out->depth = depth;
+    out->used = 0;
+    out->nice = 0;
+
+    return buf_allocate(&out->affinity, 4 * sizeof(int));
+}
+
+
+void jobpool_free(JobPool * pool) {
+    buf_free(&pool->affinity);
+}
+
+
+bool jobpool_canAcquire(JobPool * pool, size_t cost) {
+    return pool->used == 0 || pool->used + cost <= pool->depth;
+}
+
+
+void jobpool_acquire(JobPool * pool, size_t cost) {
+    pool->used += cost;
+}
+
+
+void jobpool_release(JobPool * pool, size_t cost) {
+    pool->used -= cost;
+}
+
+
+BakeError jobpool_parseAffinity(JobPool * pool, char * list) {
+    char * position = list;
+
+    while(true) {
+        // Read the first CPU of the range
+        char * end;
+        long first = strtol(position, &end, 10);
+        if(end == position || first < 0) {
+            reportError("Expected a list of CPUs such as 0-3,6 for affinity, found \"%s\"\n", list);
+            return BAKE_ERROR_PARSING;
+        }
+
+        // Read the last CPU of the range, if it is a range
+        long last = first;
+        position = end;
+        if(*position == '-') {
+            position += 1;
+            last = strtol(position, &end, 10);
+            if(end == position || last < first) {
+                reportError("Expected a list of CPUs such as 0-3,6 for affinity, found \"%s\"\n", list);
+                return BAKE_ERROR_PARSING;
+            }
+
+            position = end;
+        }
+
+        for(long cpu = first; cpu <= last; ++cpu) {
+            int value = (int) cpu;
+            BakeError err = buf_append(&pool->affinity, &value, sizeof(int));
+            if(err != BAKE_SUCCESS)
+                return err;
+        }
+
+        if(*position == '\0')
+            return BAKE_SUCCESS;
+
+        if(*position != ',') {
+            reportError("Expected a list of CPUs such as 0-3,6 for affinity, found \"%s\"\n", list);
+            return BAKE_ERROR_PARSING;
+        }
+
+        position += 1;
+    }
+}
+
+
+bool jobpool_hasSettings(JobPool * pool) {
+#ifdef __linux__
+    if(pool->affinity.used > 0)
+        return true;
+#endif
+
+    return pool->nice != 0;
+}
+
+
+int jobpool_applyNice(JobPool * pool) {
+    if(pool->nice == 0)
+        return 0;
+
+    // A process ID of 0 refers to the calling process
+    if(setpriority(PRIO_PROCESS, 0, pool->nice) != 0)
+        return errno;
+
+    return 0;
+}
+
+
+int jobpool_applyAffinity(JobPool * pool) {
+#ifdef __linux__
+    size_t cpuCount = pool->affinity.used / sizeof(int);
+    if(cpuCount == 0)
+        return 0;
+
+    int * cpus = buf_get(&pool->affinity);
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(size_t index = 0; index < cpuCount; ++index) {
+        if(cpus[index] < CPU_SETSIZE) {
+            CPU_SET(cpus[index], &set);
+        }
+    }
+
+    if(sched_setaffinity(0, sizeof(set), &set) != 0)
+        return errno;
+#else
+    (void) pool;
+#endif
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === jobpool ===
+//
+// Named pools that limit how many of the targets using them are executed at once,
+// such as a pool of depth 2 for linkers. Targets may take more than one token from
+// a pool, so that pools can also stand for resources such as megabytes of memory.
+//
+// The processes of the targets in a pool can also be given a nice level, and be
+// restricted to a set of CPUs, to keep background jobs out of the way of others.
+//
+
+#ifndef CITS2002_JOBPOOL_H
+#define CITS2002_JOBPOOL_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "errors.h"
+#include "buffer.h"
+
+
+/**
+ * The name of the pool of megabytes of memory, which is created with the memory of the
+ * machine as its depth if a target uses it without the bakefile declaring it.
+ */
+#define MEMORY_POOL  "memory"
+
+
+/**
+ * A limited number of tokens shared by the targets that use the pool.
+ */
+typedef struct {
+    /**
+     * The number of tokens in the pool.
+     */
+    size_t depth;
+
+    /**
+     * The number of tokens held by targets that are currently executing.
+     */
+    size_t used;
+
+    /**
+     * The nice level to give the processes of targets in the pool, or 0 to leave it unchanged.
+     */
+    int nice;
+
+    /**
+     * A buffer containing a list of the int CPUs that the processes of targets in the
+     * pool are restricted to. If it is empty, the CPUs they may use are left unchanged.
+     */
+    Buffer affinity;
+} JobPool;
+
+
+/**
+ * The tokens that a target takes from a pool while it executes.
+ */
+typedef struct {
+    /**
+     * The pool the tokens are taken from.
+     */
+    JobPool * pool;
+
+    /**
+     * The number of tokens taken.
+     */
+    size_t cost;
+} PoolCost;
+
+
+/**
+ * Allocate a new JobPool with {@param depth} tokens, and place it into {@param out}.
+ */
+BakeError jobpool_allocate(JobPool * out, size_t depth);
+
+
+/**
+ * Free the resources of {@param pool} and mark it as invalid.
+ */
+void jobpool_free(JobPool * pool);
+
+
+/**
+ * @return whether {@param cost} tokens can be taken from {@param pool}. A target that
+ *         costs more than the depth of the pool may only execute while the pool is unused.
+ */
+bool jobpool_canAcquire(JobPool * pool, size_t cost);
+
+
+/**
+ * Take {@param cost} tokens from {@param pool}.
+ */
+void jobpool_acquire(JobPool * pool, size_t cost);
+
+
+/**
+ * Give back {@param cost} tokens to {@param pool}.
+ */
+void jobpool_release(JobPool * pool, size_t cost);
+
+
+/**
+ * Restrict the processes of targets in {@param pool} to the CPUs in {@param list}, a comma
+ * separated list of CPU numbers and ranges of CPU numbers, such as "0-3,6".
+ */
+BakeError jobpool_parseAffinity(JobPool * pool, char * list);
+
+
+/**
+ * @return whether the processes of targets in {@param pool} are given a nice level or CPU affinity.
+ *         CPU affinity is only set on Linux.
+ */
+bool jobpool_hasSettings(JobPool * pool);
+
+
+/**
+ * Give the calling process the nice level of {@param pool}, if it has one. This is called in a new
+ * process before it executes a command, so it only makes calls that are safe to make after fork.
+ *
+ * @return 0 if the nice level was set or there is none, otherwise the errno of the failure
+ */
+int jobpool_applyNice(JobPool * pool);
+
+
+/**
+ * Restrict the calling process to the CPUs of {@param pool}, if it has any, in the same way as jobpool_applyNice.
+ *
+ * @return 0 if the CPUs were set or there are none, otherwise the errno of the failure
+ */
+int jobpool_applyAffinity(JobPool * pool);
+
+
+#endif //CITS2002_JOBPOOL_H
@@ -0,0 +1,340 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+// O_CLOEXEC, mkfifo, setenv and strndup are POSIX, which glibc does not declare under -std=c99 without a feature-test macro
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "jobserver.h"
+#include "load.h"
+#include "files.h"
+
+
+BakeError jobserver_setup(BakeOptions * options, JobServer * out, bool * using) {
+    *using = false;
+
+    // If we were started by make, and weren't told how many jobs to run, share the jobs of make
+    char * makeflags = getenv("MAKEFLAGS");
+    char * auth = (makeflags != NULL ? findJobServerAuth(makeflags) : NULL);
+
+    if(auth != NULL && !options->explicitJobs) {
+        bool connected;
+        BakeError err = jobserver_connect(out, auth, &connected);
+        free(auth);
+
+        if(err != BAKE_SUCCESS)
+            return err;
+
+        // If the jobserver wasn't passed to us, we can only safely run the one job we're given
+        if(!connected) {
+            reportError("Warning: Unable to use the jobserver from MAKEFLAGS, executing one job at a time\n");
+            return BAKE_SUCCESS;
+        }
+
+        // The jobserver decides how many jobs may execute at once
+        options->jobs = SIZE_MAX;
+        options->automaticJobs = false;
+
+        *using = true;
+        return BAKE_SUCCESS;
+    }
+
+    free(auth);
+
+    // There's no need for a jobserver if only one job will execute at once
+    if(options->onlyPrintCommands || (!options->automaticJobs && options->jobs <= 1))
+        return BAKE_SUCCESS;
+
+    size_t jobs = (options->automaticJobs ? findAvailableProcessors() : options->jobs);
+    BakeError err = jobserver_create(out, jobs, options->jobServerStyle);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    *using = true;
+    return BAKE_SUCCESS;
+}
+
+
+BakeError jobserver_create(JobServer * out, size_t jobs, JobServerStyle style) {
+    out->readFD = -1;
+    out->writeFD = -1;
+    out->childFDs[PIPE_READ] = -1;
+    out->childFDs[PIPE_WRITE] = -1;
+    out->path = NULL;
+
+    BakeError err = buf_allocate(&out->tokens, 16);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    char * directory = getenv("TMPDIR");
+    if(directory == NULL || *directory == '\0') {
+        directory = "/tmp";
+    }
+
+    // Find a name for the FIFO that isn't already taken
+    for(unsigned int attempt = 0; out->path == NULL; ++attempt) {
+        size_t length = strlen(directory) + 64;
+        char * path = malloc(length);
+        if(path == NULL) {
+            reportError("Unable to allocate memory for the path of the jobserver\n");
+            jobserver_free(out);
+            return BAKE_ERROR_MEMORY;
+        }
+
+        snprintf(path, length, "%s/bake-jobserver-%i-%u", directory, (int) getpid(), attempt);
+
+        if(mkfifo(path, 0600) == 0) {
+            out->path = path;
+            break;
+        }
+
+        int errorNumber = errno;
+        free(path);
+
+        if(errorNumber != EEXIST) {
+            reportError("Unable to create the jobserver FIFO in %s: %s\n", directory, strerror(errorNumber));
+            jobserver_free(out);
+            return BAKE_ERROR_IO;
+        }
+    }
+
+    // Open the FIFO for both reading and writing, so that it is never closed while children come and go
+    out->readFD = open(out->path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if(out->readFD == -1) {
+        reportError("Unable to open the jobserver FIFO %s: %s\n", out->path, strerror(errno));
+        jobserver_free(out);
+        return BAKE_ERROR_IO;
+    }
+
+    out->writeFD = out->readFD;
+
+    // Add a token for each job after the first, which every process may run without a token
+    char token = JOBSERVER_TOKEN;
+    for(size_t index = 1; index < jobs; ++index) {
+        if(write(out->writeFD, &token, 1) != 1) {
+            reportError("Unable to add tokens to the jobserver: %s\n", strerror(errno));
+            jobserver_free(out);
+            return BAKE_ERROR_IO;
+        }
+    }
+
+    // Older versions of make can only be passed the jobserver as file descriptors that they inherit. These are
+    // opened separately from our own connection, so that they stay blocking as make expects.
+    if(style == JOBSERVER_STYLE_PIPE) {
+        out->childFDs[PIPE_READ] = open(out->path, O_RDONLY);
+        out->childFDs[PIPE_WRITE] = open(out->path, O_WRONLY);
+
+        if(out->childFDs[PIPE_READ] == -1 || out->childFDs[PIPE_WRITE] == -1) {
+            reportError("Unable to open the jobserver FIFO %s: %s\n", out->path, strerror(errno));
+            jobserver_free(out);
+            return BAKE_ERROR_IO;
+        }
+    }
+
+    // Pass the jobserver to the commands we execute, after any flags already passed to us by make
+    char * makeflags = getenv("MAKEFLAGS");
+    if(makeflags == NULL) {
+        makeflags = "";
+    }
+
+    size_t length = strlen(makeflags) + strlen(out->path) + 64;
+    char * newMakeflags = malloc(length);
+    if(newMakeflags == NULL) {
+        reportError("Unable to allocate memory for MAKEFLAGS\n");
+        jobserver_free(out);
+        return BAKE_ERROR_MEMORY;
+    }
+
+    if(style == JOBSERVER_STYLE_PIPE) {
+        snprintf(newMakeflags, length, "%s -j%zu --jobserver-auth=%i,%i", makeflags, jobs,
+                 out->childFDs[PIPE_READ], out->childFDs[PIPE_WRITE]);
+    } else {
+        snprintf(newMakeflags, length, "%s -j%zu --jobserver-auth=fifo:%s", makeflags, jobs, out->path);
+    }
+
+    int result = setenv("MAKEFLAGS", newMakeflags, 1);
+    int errorNumber = errno;
+    free(newMakeflags);
+
+    if(result != 0) {
+        reportError("Unable to set MAKEFLAGS: %s\n", strerror(errorNumber));
+        jobserver_free(out);
+        return BAKE_ERROR_UNKNOWN;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError jobserver_connect(JobServer * out, char * auth, bool * connected) {
+    *connected = false;
+    out->readFD = -1;
+    out->writeFD = -1;
+    out->childFDs[PIPE_READ] = -1;
+    out->childFDs[PIPE_WRITE] = -1;
+    out->path = NULL;
+
+    if(strncmp(auth, "fifo:", strlen("fifo:")) == 0) {
+        // Open our own connection to the FIFO, so that it can be made non-blocking without affecting others
+        out->readFD = open(auth + strlen("fifo:"), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if(out->readFD == -1)
+            return BAKE_SUCCESS;
+
+        out->writeFD = out->readFD;
+    } else {
+        // Otherwise, the jobserver is a pipe whose file descriptors were passed to us
+        char * end;
+        long readFD = strtol(auth, &end, 10);
+        if(*end != ',')
+            return BAKE_SUCCESS;
+
+        char * writeStart = end + 1;
+        long writeFD = strtol(writeStart, &end, 10);
+        if(*end != '\0' || end == writeStart || readFD < 0 || writeFD < 0)
+            return BAKE_SUCCESS;
+
+        // The descriptors are only valid if make marked the command that started us as recursive
+        if(fcntl((int) readFD, F_GETFD) == -1 || fcntl((int) writeFD, F_GETFD) == -1)
+            return BAKE_SUCCESS;
+
+        // Re-open the read end as a new non-blocking file description, so that others are left blocking
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/fd/%li", readFD);
+
+        out->readFD = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if(out->readFD == -1)
+            return BAKE_SUCCESS;
+
+        out->writeFD = (int) writeFD;
+    }
+
+    BakeError err = buf_allocate(&out->tokens, 16);
+    if(err != BAKE_SUCCESS) {
+        close(out->readFD);
+        return err;
+    }
+
+    *connected = true;
+    return BAKE_SUCCESS;
+}
+
+
+char * findJobServerAuth(char * makeflags) {
+    // If the jobserver is given more than once, the last one is used
+    char * start = NULL;
+    char * options[] = {"--jobserver-auth=", "--jobserver-fds="};
+
+    for(size_t index = 0; index < sizeof(options) / sizeof(options[0]); ++index) {
+        for(char * found = strstr(makeflags, options[index]); found != NULL;
+            found = strstr(found + 1, options[index])) {
+
+            char * value = found + strlen(options[index]);
+            if(start == NULL || value > start) {
+                start = value;
+            }
+        }
+    }
+
+    if(start == NULL)
+        return NULL;
+
+    return strndup(start, strcspn(start, " \t"));
+}
+
+
+void jobserver_free(JobServer * jobServer) {
+    // Give back the tokens that we still hold
+    while(jobserver_tokenCount(jobServer) > 0 && jobServer->writeFD >= 0) {
+        if(jobserver_release(jobServer) != BAKE_SUCCESS)
+            break;
+    }
+
+    if(jobServer->readFD >= 0) {
+        close(jobServer->readFD);
+        jobServer->readFD = -1;
+        jobServer->writeFD = -1;
+    }
+
+    for(int index = 0; index < 2; ++index) {
+        if(jobServer->childFDs[index] >= 0) {
+            close(jobServer->childFDs[index]);
+            jobServer->childFDs[index] = -1;
+        }
+    }
+
+    if(jobServer->path != NULL) {
+        unlink(jobServer->path);
+        free(jobServer->path);
+        jobServer->path = NULL;
+    }
+
+    buf_free(&jobServer->tokens);
+}
+
+
+size_t jobserver_tokenCount(JobServer * jobServer) {
+    return jobServer->tokens.used;
+}
+
+
+BakeError jobserver_acquire(JobServer * jobServer, bool * acquired) {
+    *acquired = false;
+
+    char token;
+    ssize_t charsRead;
+    do {
+        charsRead = read(jobServer->readFD, &token, 1);
+    } while(charsRead == -1 && errno == EINTR);
+
+    // If no tokens are available, we have to wait for another job to finish
+    if(charsRead != 1) {
+        if(charsRead == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            reportError("Unable to read a token from the jobserver: %s\n", strerror(errno));
+            return BAKE_ERROR_IO;
+        }
+
+        return BAKE_SUCCESS;
+    }
+
+    BakeError err = buf_append(&jobServer->tokens, &token, 1);
+    if(err != BAKE_SUCCESS) {
+        // Don't lose the token, or the whole build will have one fewer job
+        write(jobServer->writeFD, &token, 1);
+        return err;
+    }
+
+    *acquired = true;
+    return BAKE_SUCCESS;
+}
+
+
+BakeError jobserver_release(JobServer * jobServer) {
+    char * tokens = buf_get(&jobServer->tokens);
+    char token = tokens[jobServer->tokens.used - 1];
+
+    ssize_t charsWritten;
+    do {
+        charsWritten = write(jobServer->writeFD, &token, 1);
+    } while(charsWritten == -1 && errno == EINTR);
+
+    // Forget the token even if it couldn't be written, so that we don't try again forever
+    jobServer->tokens.used -= 1;
+
+    if(charsWritten != 1) {
+        reportError("Unable to return a token to the jobserver: %s\n", strerror(errno));
+        return BAKE_ERROR_IO;
+    }
+
+    return BAKE_SUCCESS;
+}
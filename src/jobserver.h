@@ -0,0 +1,125 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === jobserver ===
+//
+// Shares one budget of jobs between bake, the make that started it, and any make or
+// cargo sub-builds started by its action lines, using the GNU make jobserver protocol.
+//
+// The jobserver is a named FIFO or pipe holding one byte, or token, for each job that
+// may execute beyond the first. Each process may always run one job without a token,
+// and must read a token before starting each job after that, and write it back once
+// the job has finished. The FIFO or pipe is passed to children in MAKEFLAGS.
+//
+
+#ifndef CITS2002_JOBSERVER_H
+#define CITS2002_JOBSERVER_H
+
+#include <stdbool.h>
+#include "errors.h"
+#include "buffer.h"
+#include "main.h"
+
+
+/**
+ * The token written into the jobservers that bake creates.
+ */
+#define JOBSERVER_TOKEN  '+'
+
+
+/**
+ * A connection to a jobserver, created by bake or inherited from the make that started bake.
+ */
+typedef struct {
+    /**
+     * The non-blocking file descriptor that tokens are read from.
+     */
+    int readFD;
+
+    /**
+     * The file descriptor that tokens are written back to.
+     */
+    int writeFD;
+
+    /**
+     * If the jobserver was created by bake and is passed to commands as file descriptors, the
+     * read and write file descriptors that are inherited by the commands. Otherwise both are -1.
+     */
+    int childFDs[2];
+
+    /**
+     * The path of the FIFO if it was created by bake, to be removed once bake is done with it. Otherwise NULL.
+     */
+    char * path;
+
+    /**
+     * A buffer containing the tokens that bake has read and not yet written back.
+     */
+    Buffer tokens;
+} JobServer;
+
+
+/**
+ * If -j was not passed in {@param options}, and bake was started by a make with a jobserver, connect to
+ * that jobserver and let it decide how many jobs execute at once. Otherwise, if more than one job may
+ * execute at once, create a new jobserver with a token for each job, and pass it to the commands bake
+ * executes. Whether a jobserver is being used is placed into {@param using}, and if so it is placed
+ * into {@param out}.
+ */
+BakeError jobserver_setup(BakeOptions * options, JobServer * out, bool * using);
+
+
+/**
+ * Create a new jobserver as a FIFO holding a token for each of {@param jobs} jobs after the first, pass
+ * it to the commands bake executes through MAKEFLAGS in the style {@param style}, and place a connection
+ * to it into {@param out}.
+ */
+BakeError jobserver_create(JobServer * out, size_t jobs, JobServerStyle style);
+
+
+/**
+ * Connect to the jobserver described by the value {@param auth} of --jobserver-auth in MAKEFLAGS, which is
+ * either fifo:PATH or the read and write file descriptors of a pipe separated by a comma. Whether the jobserver
+ * could be connected to is placed into {@param connected}, and if so the connection is placed into {@param out}.
+ */
+BakeError jobserver_connect(JobServer * out, char * auth, bool * connected);
+
+
+/**
+ * @return the value of the last --jobserver-auth or --jobserver-fds in {@param makeflags} as a newly
+ *         allocated string, or NULL if there is none or it could not be allocated
+ */
+char * findJobServerAuth(char * makeflags);
+
+
+/**
+ * Write back all the tokens held from {@param jobServer}, free its resources, and remove
+ * it if it was created by bake. Commands using the jobserver should have finished.
+ */
+void jobserver_free(JobServer * jobServer);
+
+
+/**
+ * @return the number of tokens currently held from {@param jobServer}
+ */
+size_t jobserver_tokenCount(JobServer * jobServer);
+
+
+/**
+ * Try to read a token from {@param jobServer} without blocking,
+ * placing whether one was read into {@param acquired}.
+ */
+BakeError jobserver_acquire(JobServer * jobServer, bool * acquired);
+
+
+/**
+ * Write one of the tokens held from {@param jobServer} back to it.
+ */
+BakeError jobserver_release(JobServer * jobServer);
+
+
+#endif //CITS2002_JOBSERVER_H
@@ -0,0 +1,235 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+ */
+
+// sched_getaffinity and CPU_COUNT are only declared by glibc when _GNU_SOURCE is defined
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "load.h"
+
+
+void limit_initialise(JobLimit * out, BakeOptions options) {
+    out->automatic = options.automaticJobs;
+    out->maxLoad = options.maxLoad;
+    out->lastSampled = -LOAD_SAMPLE_INTERVAL;
+
+    // In automatic mode, run a job for each processor we're allowed to use
+    out->maxJobs = (options.automaticJobs ? findAvailableProcessors() : options.jobs);
+    out->jobLimit = out->maxJobs;
+}
+
+
+size_t limit_allowedJobs(JobLimit * limit, size_t runningJobs) {
+    // Adjust the limit from the pressure on the machine if we are in automatic mode
+    if(limit->automatic) {
+        limit_adjust(limit, runningJobs);
+    }
+
+    size_t allowed = limit->jobLimit;
+
+    // If the machine is already loaded, don't start any more jobs than are already running
+    double load;
+    if(limit->maxLoad > 0 && runningJobs > 0 && allowed > runningJobs
+       && readLoad(&load) && load >= limit->maxLoad) {
+        allowed = runningJobs;
+    }
+
+    // We always want to allow at least one job, so that the build can progress
+    return (allowed > 0 ? allowed : 1);
+}
+
+
+void limit_adjust(JobLimit * limit, size_t runningJobs) {
+    // The pressure files are averaged over seconds, so there is no use re-reading them too often
+    double now = monotonicTime();
+    if(now - limit->lastSampled < LOAD_SAMPLE_INTERVAL)
+        return;
+
+    limit->lastSampled = now;
+
+    // The processors available to us may have changed
+    limit->maxJobs = findAvailableProcessors();
+
+    // The limit can't be brought below the number of jobs already running, only held at or below it
+    size_t current = (limit->jobLimit < runningJobs ? limit->jobLimit : runningJobs);
+
+    double cpuStalled, memoryStalled, ioStalled;
+    bool memoryPressure = (readPressure("memory", &memoryStalled) && memoryStalled > PRESSURE_MEMORY_LIMIT)
+                          || isNearMemoryLimit();
+    bool cpuPressure = (readPressure("cpu", &cpuStalled) && cpuStalled > PRESSURE_CPU_LIMIT);
+    bool ioPressure = (readPressure("io", &ioStalled) && ioStalled > PRESSURE_IO_LIMIT);
+
+    if(memoryPressure) {
+        // Running out of memory is far worse than running slowly, so back off quickly
+        limit->jobLimit = current / 2;
+    } else if(cpuPressure || ioPressure) {
+        // Give up one of the jobs we're running
+        limit->jobLimit = (current > 0 ? current - 1 : 0);
+    } else {
+        // Otherwise, grow back towards the maximum
+        limit->jobLimit += 1 + limit->jobLimit / 4;
+    }
+
+    // Keep the limit between one job and the maximum
+    if(limit->jobLimit > limit->maxJobs) {
+        limit->jobLimit = limit->maxJobs;
+    }
+    if(limit->jobLimit < 1) {
+        limit->jobLimit = 1;
+    }
+}
+
+
+double monotonicTime(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+size_t findAvailableProcessors(void) {
+    size_t processors = 0;
+
+#ifdef __linux__
+    // Find the number of processors we are allowed to be scheduled on
+    cpu_set_t processorSet;
+    if(sched_getaffinity(0, sizeof(processorSet), &processorSet) == 0) {
+        processors = (size_t) CPU_COUNT(&processorSet);
+    }
+#endif
+
+    // Otherwise, fall back to the number of processors that are online
+    if(processors == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        processors = (online > 0 ? (size_t) online : 1);
+    }
+
+    // A CPU quota of "max" means there is no quota, which will not be matched
+    char line[64];
+    long long quota, period;
+    if(readCgroupFile("cpu.max", line, sizeof(line))
+       && sscanf(line, "%lld %lld", &quota, &period) == 2 && quota > 0 && period > 0) {
+
+        // A quota of 1.5 periods allows us to keep 2 processors partly busy
+        size_t quotaProcessors = (size_t) ((quota + period - 1) / period);
+        if(quotaProcessors < processors) {
+            processors = quotaProcessors;
+        }
+    }
+
+    return processors;
+}
+
+
+size_t findAvailableMemory(void) {
+    size_t megabytes = SIZE_MAX;
+
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if(pages > 0 && pageSize > 0) {
+        megabytes = (size_t) ((long long) pages * pageSize / (1024 * 1024));
+    }
+
+    // A memory.max of "max" means there is no limit, which will not be matched
+    char line[64];
+    long long maxMemory;
+    if(readCgroupFile("memory.max", line, sizeof(line)) && sscanf(line, "%lld", &maxMemory) == 1 && maxMemory > 0) {
+        size_t maxMegabytes = (size_t) (maxMemory / (1024 * 1024));
+        if(maxMegabytes < megabytes) {
+            megabytes = maxMegabytes;
+        }
+    }
+
+    return (megabytes > 0 ? megabytes : 1);
+}
+
+
+bool readFirstLine(const char * path, char * buffer, size_t size) {
+    FILE * file = fopen(path, "r");
+    if(file == NULL)
+        return false;
+
+    char * line = fgets(buffer, (int) size, file);
+    fclose(file);
+
+    return line != NULL;
+}
+
+
+bool readCgroupFile(const char * name, char * buffer, size_t size) {
+    // Find the cgroup v2 entry for this process, which is the line starting with "0::"
+    FILE * file = fopen("/proc/self/cgroup", "r");
+    if(file == NULL)
+        return false;
+
+    char line[PATH_MAX];
+    bool found = false;
+    while(fgets(line, sizeof(line), file) != NULL) {
+        if(strncmp(line, "0::", 3) == 0) {
+            found = true;
+            break;
+        }
+    }
+
+    fclose(file);
+    if(!found)
+        return false;
+
+    // Remove the newline from the end of the cgroup's path
+    char * cgroup = &line[3];
+    cgroup[strcspn(cgroup, "\n")] = '\0';
+
+    // cgroup v2 is mounted at /sys/fs/cgroup, or at /sys/fs/cgroup/unified on hybrid systems
+    const char * mounts[] = {"/sys/fs/cgroup", "/sys/fs/cgroup/unified"};
+
+    for(size_t index = 0; index < sizeof(mounts) / sizeof(mounts[0]); ++index) {
+        char path[PATH_MAX];
+        int length = snprintf(path, sizeof(path), "%s%s/%s", mounts[index], cgroup, name);
+        if(length < 0 || (size_t) length >= sizeof(path))
+            continue;
+
+        if(readFirstLine(path, buffer, size))
+            return true;
+    }
+
+    return false;
+}
+
+
+bool readLoad(double * load) {
+    // Like make, -l is compared against the load average over the last minute
+    return getloadavg(load, 1) == 1;
+}
+
+
+bool readPressure(const char * resource, double * stalled) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/pressure/%s", resource);
+
+    // The first line is of the form "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+    char line[128];
+    return readFirstLine(path, line, sizeof(line)) && sscanf(line, "some avg10=%lf", stalled) == 1;
+}
+
+
+bool isNearMemoryLimit(void) {
+    // A memory.max of "max" means there is no limit, which will not be matched
+    char line[64];
+    long long maxMemory, currentMemory;
+    if(!readCgroupFile("memory.max", line, sizeof(line)) || sscanf(line, "%lld", &maxMemory) != 1)
+        return false;
+
+    if(!readCgroupFile("memory.current", line, sizeof(line)) || sscanf(line, "%lld", &currentMemory) != 1)
+        return false;
+
+    return (double) currentMemory > MEMORY_USAGE_LIMIT * (double) maxMemory;
+}
@@ -0,0 +1,156 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === load ===
+//
+// Decides how many jobs may be executed at once, from the processors
+// available to bake and from how loaded the machine currently is.
+//
+
+#ifndef CITS2002_LOAD_H
+#define CITS2002_LOAD_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+#include "main.h"
+
+
+/**
+ * The minimum number of seconds between re-reading the pressure and cgroup files in automatic mode.
+ */
+#define LOAD_SAMPLE_INTERVAL  1.0
+
+
+/**
+ * The share of time, as a percentage over the last 10 seconds, that some tasks may be stalled
+ * waiting on the cpu, memory or io before we stop starting new jobs in automatic mode.
+ */
+#define PRESSURE_CPU_LIMIT     25.0
+#define PRESSURE_MEMORY_LIMIT  10.0
+#define PRESSURE_IO_LIMIT      30.0
+
+
+/**
+ * The fraction of the cgroup's memory.max that may be used before we stop starting new jobs in automatic mode.
+ */
+#define MEMORY_USAGE_LIMIT  0.9
+
+
+/**
+ * Limits the number of jobs that are executed at once.
+ */
+typedef struct {
+    /**
+     * The most jobs that may ever be executed at once.
+     */
+    size_t maxJobs;
+
+    /**
+     * The number of jobs that may currently be executed at once in automatic
+     * mode, which is grown and shrunk as the pressure on the machine changes.
+     */
+    size_t jobLimit;
+
+    /**
+     * The load above which no new jobs will be started, or 0 if there is no limit.
+     */
+    double maxLoad;
+
+    /**
+     * Whether jobLimit should be adjusted from the pressure on the machine.
+     */
+    bool automatic;
+
+    /**
+     * The monotonic time in seconds that jobLimit was last adjusted.
+     */
+    double lastSampled;
+} JobLimit;
+
+
+/**
+ * Initialise the job limit {@param out} from the -j and -l options in {@param options}.
+ */
+void limit_initialise(JobLimit * out, BakeOptions options);
+
+
+/**
+ * @return the number of jobs that may be running at once, given {@param runningJobs} jobs are running now.
+ *
+ * This will always allow at least one job to be running.
+ */
+size_t limit_allowedJobs(JobLimit * limit, size_t runningJobs);
+
+
+/**
+ * Adjust the job limit of {@param limit} from the pressure on the machine, if it has not been recently.
+ */
+void limit_adjust(JobLimit * limit, size_t runningJobs);
+
+
+/**
+ * @return the current monotonic time in seconds.
+ */
+double monotonicTime(void);
+
+
+/**
+ * @return the number of processors this process is allowed to run on, further limited by the CPU quota
+ *         of its cgroup. If neither can be found, the number of online processors is used instead.
+ */
+size_t findAvailableProcessors(void);
+
+
+/**
+ * @return the megabytes of memory this process may use, which is the physical memory of the machine
+ *         further limited by the memory.max of its cgroup. If neither can be found, SIZE_MAX is returned.
+ */
+size_t findAvailableMemory(void);
+
+
+/**
+ * Read the first line of the file at {@param path} into {@param buffer} of size {@param size}.
+ *
+ * @return whether the line could be read
+ */
+bool readFirstLine(const char * path, char * buffer, size_t size);
+
+
+/**
+ * Read the cgroup v2 interface file {@param name} of the cgroup this process belongs to into
+ * {@param buffer} of size {@param size}.
+ *
+ * @return whether the file could be read
+ */
+bool readCgroupFile(const char * name, char * buffer, size_t size);
+
+
+/**
+ * Read the load average of the machine over the last minute into {@param load}.
+ *
+ * @return whether the load could be found
+ */
+bool readLoad(double * load);
+
+
+/**
+ * Read the share of time that some tasks were stalled on {@param resource} over the last 10
+ * seconds, as a percentage, from /proc/pressure into {@param stalled}.
+ *
+ * @return whether the pressure could be read
+ */
+bool readPressure(const char * resource, double * stalled);
+
+
+/**
+ * @return whether the cgroup of this process is close to its memory.max limit.
+ */
+bool isNearMemoryLimit(void);
+
+
+#endif //CITS2002_LOAD_H
@@ -7,6 +7,7 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include <memory.h>
+#include <limits.h>
 #include "main.h"
 #include "parser.h"
 #include "execution.h"
@@ -36,6 +37,21 @@ int main(int argc, char * argv[]) {
         }
     }
 
+    // Start counting the work we do, to be printed however we exit
+    if(options.printStats) {
+        stats_enable();
+        atexit(stats_printAtExit);
+    }
+
+    // Start writing the timeline of the build, finishing it however we exit
+    if(options.tracePath != NULL) {
+        bakeErr = trace_start(options.tracePath);
+        if(bakeErr != BAKE_SUCCESS)
+            return EXIT_FAILURE;
+
+        atexit(trace_finish);
+    }
+
     // Open the bakefile
     FILE * file;
     bakeErr = openBakefile(options, &file);
@@ -83,24 +99,42 @@ int main(int argc, char * argv[]) {
         return EXIT_FAILURE;
     }
 
-    // Find the target we want to execute
-    Target * target = bakefile.firstTarget;
+    // Find the targets we want to execute
+    Buffer targets;
+    bakeErr = findTargets(options, &bakefile, &targets);
+    if(bakeErr != BAKE_SUCCESS) {
+        bakefile_free(&bakefile);
+        return EXIT_FAILURE;
+    }
 
-    // If a target was specified through the command-line, use it instead of the first target
-    if(options.target != NULL) {
-        // Try find the target specified
-        target = bakefile_getTarget(&bakefile, options.target);
-        if(target == NULL) {
-            bakefile_free(&bakefile);
-            reportError("Could not find the target %s to execute\n", options.target);
-            return EXIT_FAILURE;
+    // Share a budget of jobs with make, and with any sub-builds started by the action lines
+    JobServer jobServer;
+    bool usingJobServer;
+    bakeErr = jobserver_setup(&options, &jobServer, &usingJobServer);
+
+    // Execute the targets, catching the signals that ask us to stop so that we can stop their commands first
+    if(bakeErr == BAKE_SUCCESS) {
+        bakeErr = interrupts_install();
+        if(bakeErr == BAKE_SUCCESS) {
+            bakeErr = executeTargets(options, bakefile, (usingJobServer ? &jobServer : NULL),
+                                     buf_get(&targets), targets.used / sizeof(Target *));
+            interrupts_restore();
         }
     }
 
-    // Execute the target
-    bakeErr = executeTarget(options, bakefile, target);
+    buf_free(&targets);
+
+    // Stop using the jobserver, removing it if we created it
+    if(usingJobServer) {
+        jobserver_free(&jobServer);
+    }
+
     if(bakeErr != BAKE_SUCCESS) {
         bakefile_free(&bakefile);
+
+        // If we were interrupted, exit the same way we would have if we hadn't caught the signal
+        trace_finish();
+        interrupts_reraise();
         return EXIT_FAILURE;
     }
 
@@ -116,16 +150,51 @@ BakeError readCommandLineOptions(int argc, char * argv[], BakeOptions * options)
     options->directory = NULL;
     options->bakefile = NULL;
     options->requireSuccess = true;
+    options->keepGoing = false;
     options->onlyPrintCommands = false;
     options->expandVariablesAndExit = false;
     options->silent = false;
-    options->target = NULL;
+    options->jobs = 1;
+    options->automaticJobs = false;
+    options->explicitJobs = false;
+    options->maxLoad = 0;
+    options->useBuiltins = true;
+    options->outputSync = OUTPUT_SYNC_NONE;
+    options->jobServerStyle = JOBSERVER_STYLE_PIPE;
+    options->timeout = 0;
+    options->usageReportCount = 0;
+    options->usageJSON = NULL;
+    options->tracePath = NULL;
+    options->printStats = false;
+    options->freshness = FRESHNESS_MTIME;
+    options->targets = NULL;
+    options->targetCount = 0;
+
+    // The long names of command-line options, each of which is equivalent to a short option
+    const struct option longOptions[] = {
+        {"output-sync", required_argument, NULL, 'O'},
+        {"jobserver-style", required_argument, NULL, OPTION_JOBSERVER_STYLE},
+        {"timeout", required_argument, NULL, OPTION_TIMEOUT},
+        {"rusage-report", optional_argument, NULL, OPTION_RUSAGE_REPORT},
+        {"rusage-json", required_argument, NULL, OPTION_RUSAGE_JSON},
+        {"trace", required_argument, NULL, OPTION_TRACE},
+        {"stats", no_argument, NULL, OPTION_STATS},
+        {"freshness", required_argument, NULL, OPTION_FRESHNESS},
+        {NULL, 0, NULL, 0}
+    };
 
     // Read the command-line options
     int opt;
-    const char * commandLineOptions = "inpsC:f:";
-    while((opt = getopt(argc, argv, commandLineOptions)) != -1) {
+    const char * commandLineOptions = "biknpsC:f:j:l:O:";
+    while((opt = getopt_long(argc, argv, commandLineOptions, longOptions, NULL)) != -1) {
         switch(opt) {
+            /**
+             * Option to execute every command in a new process, instead of executing simple commands within bake.
+             */
+            case 'b':
+                options->useBuiltins = false;
+                break;
+
             /**
              * Option to change the working directory before execution
              */
@@ -147,6 +216,44 @@ BakeError readCommandLineOptions(int argc, char * argv[], BakeOptions * options)
                 options->requireSuccess = false;
                 break;
 
+            /**
+             * Option to keep executing the targets that don't depend on a target that failed.
+             */
+            case 'k':
+                options->keepGoing = true;
+                break;
+
+            /**
+             * Option to execute up to the given number of jobs at once, or "auto" to adjust
+             * the number of jobs from the processors available and the pressure on the machine.
+             */
+            case 'j': {
+                options->explicitJobs = true;
+
+                if(strcmp(optarg, "auto") == 0) {
+                    options->automaticJobs = true;
+                    break;
+                }
+
+                options->automaticJobs = false;
+                BakeError err = readCountOption('j', optarg, &options->jobs);
+                if(err != BAKE_SUCCESS)
+                    return err;
+
+                break;
+            }
+
+            /**
+             * Option to not start new jobs while the load of the machine is at least the given load.
+             */
+            case 'l': {
+                BakeError err = readDecimalOption('l', optarg, &options->maxLoad);
+                if(err != BAKE_SUCCESS)
+                    return err;
+
+                break;
+            }
+
             /**
              * Option to only print the commands that would be executed, and not execute them.
              */
@@ -154,6 +261,17 @@ BakeError readCommandLineOptions(int argc, char * argv[], BakeOptions * options)
                 options->onlyPrintCommands = true;
                 break;
 
+            /**
+             * Option to collect the output of each command or target, and print it all at once.
+             */
+            case 'O': {
+                BakeError err = readOutputSyncOption(optarg, &options->outputSync);
+                if(err != BAKE_SUCCESS)
+                    return err;
+
+                break;
+            }
+
             /**
              * Option to expand all variables in the bakefile, print the resulting file, and skip executing anything.
              */
@@ -168,10 +286,81 @@ BakeError readCommandLineOptions(int argc, char * argv[], BakeOptions * options)
                 options->silent = true;
                 break;
 
+            /**
+             * Option to choose how a jobserver created by bake is passed to the commands it executes.
+             */
+            case OPTION_JOBSERVER_STYLE: {
+                BakeError err = readJobServerStyleOption(optarg, &options->jobServerStyle);
+                if(err != BAKE_SUCCESS)
+                    return err;
+
+                break;
+            }
+
+            /**
+             * Option to stop each command that executes for longer than the given number of seconds.
+             */
+            case OPTION_TIMEOUT: {
+                BakeError err = readTimeoutOption(optarg, &options->timeout);
+                if(err != BAKE_SUCCESS)
+                    return err;
+
+                break;
+            }
+
+            /**
+             * Option to print the commands that used the most CPU time once execution has finished.
+             */
+            case OPTION_RUSAGE_REPORT: {
+                BakeError err = readUsageReportOption(optarg, &options->usageReportCount);
+                if(err != BAKE_SUCCESS)
+                    return err;
+
+                break;
+            }
+
+            /**
+             * Option to write the resources used by each command to a file as JSON.
+             */
+            case OPTION_RUSAGE_JSON:
+                options->usageJSON = optarg;
+                break;
+
+            /**
+             * Option to write a timeline of the build to a file, to be viewed in Perfetto or chrome://tracing.
+             */
+            case OPTION_TRACE:
+                options->tracePath = optarg;
+                break;
+
+            /**
+             * Option to print how long each phase took, and counters of the work bake did itself, when we exit.
+             */
+            case OPTION_STATS:
+                options->printStats = true;
+                break;
+
+            /**
+             * Option to choose whether targets are executed when their inputs are newer, or when their contents changed.
+             */
+            case OPTION_FRESHNESS: {
+                BakeError err = readFreshnessOption(optarg, &options->freshness);
+                if(err != BAKE_SUCCESS)
+                    return err;
+
+                break;
+            }
+
             /**
              * If we found an unknown option, or we are missing a value for an option.
              */
             case '?':
+                // Long options are reported by their name
+                if(optopt == 0 || optopt > CHAR_MAX) {
+                    reportError("Unknown or invalid command-line option %s\n", argv[optind - 1]);
+                    return BAKE_ERROR_ARGUMENTS;
+                }
+
                 // If its a valid option and we got here, then musn't have been passed a value
                 if(strchr(commandLineOptions, optopt) != NULL) {
                     reportError("Expected value for command-line option %c\n", optopt);
@@ -191,18 +380,146 @@ BakeError readCommandLineOptions(int argc, char * argv[], BakeOptions * options)
         }
     }
 
-    // If there are more arguments after the command-line options, then a targetName may have been supplied
+    // The arguments after the command-line options are the names of the targets to execute
     if(optind < argc) {
-        // If there was more than one extra argument, then the command was incorrect
-        if(optind + 1 < argc) {
-            reportError("Expected only a single target parameter");
+        options->targets = &argv[optind];
+        options->targetCount = (size_t) (argc - optind);
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError findTargets(BakeOptions options, Bakefile * bakefile, Buffer * out) {
+    BakeError err = buf_allocate(out, 4 * sizeof(Target *));
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // If no targets were specified through the command-line, execute the first target
+    if(options.targetCount == 0)
+        return buf_append(out, &bakefile->firstTarget, sizeof(Target *));
+
+    for(size_t index = 0; index < options.targetCount; ++index) {
+        // Try find the target specified
+        Target * target = bakefile_getTarget(bakefile, options.targets[index]);
+        if(target == NULL) {
+            buf_free(out);
+            reportError("Could not find the target %s to execute\n", options.targets[index]);
             return BAKE_ERROR_ARGUMENTS;
         }
 
-        // Otherwise the last element of argv is our target parameter
-        options->target = argv[argc - 1];
+        err = buf_append(out, &target, sizeof(Target *));
+        if(err != BAKE_SUCCESS) {
+            buf_free(out);
+            return err;
+        }
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError readOutputSyncOption(char * value, OutputSync * out) {
+    if(strcmp(value, "none") == 0) {
+        *out = OUTPUT_SYNC_NONE;
+    } else if(strcmp(value, "line") == 0) {
+        *out = OUTPUT_SYNC_LINE;
+    } else if(strcmp(value, "target") == 0) {
+        *out = OUTPUT_SYNC_TARGET;
+    } else if(strcmp(value, "failed") == 0) {
+        *out = OUTPUT_SYNC_FAILED;
+    } else {
+        reportError("Expected none, line, target or failed for --output-sync, found \"%s\"\n", value);
+        return BAKE_ERROR_ARGUMENTS;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError readJobServerStyleOption(char * value, JobServerStyle * out) {
+    if(strcmp(value, "fifo") == 0) {
+        *out = JOBSERVER_STYLE_FIFO;
+    } else if(strcmp(value, "pipe") == 0) {
+        *out = JOBSERVER_STYLE_PIPE;
+    } else {
+        reportError("Expected fifo or pipe for --jobserver-style, found \"%s\"\n", value);
+        return BAKE_ERROR_ARGUMENTS;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError readFreshnessOption(char * value, FreshnessMode * out) {
+    if(strcmp(value, "mtime") == 0) {
+        *out = FRESHNESS_MTIME;
+    } else if(strcmp(value, "hash") == 0) {
+        *out = FRESHNESS_HASH;
+    } else {
+        reportError("Expected mtime or hash for --freshness, found \"%s\"\n", value);
+        return BAKE_ERROR_ARGUMENTS;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError readTimeoutOption(char * value, double * out) {
+    if(!parseSeconds(value, out)) {
+        reportError("Expected a positive number of seconds for --timeout, found \"%s\"\n", value);
+        return BAKE_ERROR_ARGUMENTS;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError readUsageReportOption(char * value, size_t * out) {
+    if(value == NULL) {
+        *out = USAGE_REPORT_DEFAULT_COUNT;
+        return BAKE_SUCCESS;
+    }
+
+    if(!parseCount(value, out)) {
+        reportError("Expected a positive number of commands for --rusage-report, found \"%s\"\n", value);
+        return BAKE_ERROR_ARGUMENTS;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError readCountOption(char option, char * value, size_t * out) {
+    // Parse the value as a base 10 number
+    char * end;
+    errno = 0;
+    long count = strtol(value, &end, 10);
+
+    // The whole value must be a positive number
+    if(errno != 0 || end == value || *end != '\0' || count <= 0) {
+        reportError("Expected a positive number for command-line option %c, found \"%s\"\n", option, value);
+        return BAKE_ERROR_ARGUMENTS;
+    }
+
+    *out = (size_t) count;
+    return BAKE_SUCCESS;
+}
+
+
+BakeError readDecimalOption(char option, char * value, double * out) {
+    // Parse the value as a decimal number
+    char * end;
+    errno = 0;
+    double number = strtod(value, &end);
+
+    // The whole value must be a positive number
+    if(errno != 0 || end == value || *end != '\0' || !(number > 0)) {
+        reportError("Expected a positive number for command-line option %c, found \"%s\"\n", option, value);
+        return BAKE_ERROR_ARGUMENTS;
     }
 
+    *out = number;
     return BAKE_SUCCESS;
 }
 
@@ -217,6 +534,15 @@ BakeError printActionLine(FILE * file, ActionLine * actionLine) {
     // Used to store any errors that may occur when printing
     int err;
 
+    // Print out the '&' symbol to mark this action line as concurrent
+    if(actionLine->concurrent) {
+        err = fprintf(file, "&");
+        if(err < 0) {
+            reportError("Unable to print '&' action line symbol to file: %s\n", strerror(errno));
+            return BAKE_ERROR_IO;
+        }
+    }
+
     // Print out the '-' symbol to mark this action line as not requiring success
     if(!actionLine->requireSuccess) {
         err = fprintf(file, "-");
@@ -303,7 +629,94 @@ BakeError printTarget(FILE * file, Target * target) {
 }
 
 
+BakeError printPool(FILE * file, char * name, JobPool * pool) {
+    int err = fprintf(file, "pool %s = %zu", name, pool->depth);
+    if(err >= 0 && pool->nice != 0) {
+        err = fprintf(file, " nice=%i", pool->nice);
+    }
+
+    // Print the CPUs of the pool, joining consecutive CPUs into ranges
+    size_t cpuCount = pool->affinity.used / sizeof(int);
+    int * cpus = buf_get(&pool->affinity);
+
+    for(size_t index = 0; index < cpuCount && err >= 0; ++index) {
+        size_t last = index;
+        while(last + 1 < cpuCount && cpus[last + 1] == cpus[last] + 1) {
+            last += 1;
+        }
+
+        err = fprintf(file, "%s%i", (index == 0 ? " affinity=" : ","), cpus[index]);
+        if(err >= 0 && last > index) {
+            err = fprintf(file, "-%i", cpus[last]);
+        }
+
+        index = last;
+    }
+
+    if(err >= 0) {
+        err = fprintf(file, "\n");
+    }
+
+    if(err < 0) {
+        reportError("Unable to print pool %s to file: %s\n", name, strerror(errno));
+        return BAKE_ERROR_IO;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError printTargetSettings(FILE * file, Bakefile * bakefile, Target * target) {
+    int err = 0;
+    if(target->cpus != 1) {
+        err = fprintf(file, "%s : cpus = %zu\n", target->name, target->cpus);
+    }
+
+    if(err >= 0 && target->timeout > 0) {
+        err = fprintf(file, "%s : timeout = %g\n", target->name, target->timeout);
+    }
+
+    // Pools are only known to targets by their address, so find the name each was declared with
+    size_t poolCount = strmap_size(&bakefile->pools);
+    StringMapEntry * poolEntries = strmap_entries(&bakefile->pools);
+    size_t costCount = target_poolCostCount(target);
+    PoolCost * costs = target_getPoolCosts(target);
+
+    for(size_t index = 0; index < costCount && err >= 0; ++index) {
+        for(size_t poolIndex = 0; poolIndex < poolCount; ++poolIndex) {
+            if(poolEntries[poolIndex].value != costs[index].pool)
+                continue;
+
+            char * name = poolEntries[poolIndex].key;
+            if(costs[index].cost == 1) {
+                err = fprintf(file, "%s : pool = %s\n", target->name, name);
+            } else {
+                err = fprintf(file, "%s : %s = %zu\n", target->name, name, costs[index].cost);
+            }
+            break;
+        }
+    }
+
+    if(err < 0) {
+        reportError("Unable to print settings of target %s to file: %s\n", target->name, strerror(errno));
+        return BAKE_ERROR_IO;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
 BakeError printBakefile(FILE * file, Bakefile * bakefile) {
+    // Print the pools first, as the settings of the targets refer to them
+    size_t poolCount = strmap_size(&bakefile->pools);
+    StringMapEntry * poolEntries = strmap_entries(&bakefile->pools);
+
+    for(size_t index = 0; index < poolCount; ++index) {
+        BakeError err = printPool(file, poolEntries[index].key, (JobPool *) poolEntries[index].value);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
     // Get the targets in bakefile
     size_t targetCount = strmap_size(&bakefile->targets);
     StringMapEntry * targetEntries = strmap_entries(&bakefile->targets);
@@ -313,8 +726,12 @@ BakeError printBakefile(FILE * file, Bakefile * bakefile) {
         // Get the index'th entry in the targets map
         StringMapEntry entry = targetEntries[index];
 
-        // Print out the target associated with this entry
+        // Print out the target associated with this entry, followed by its settings
         BakeError err = printTarget(file, (Target *) entry.value);
+        if(err == BAKE_SUCCESS) {
+            err = printTargetSettings(file, bakefile, (Target *) entry.value);
+        }
+
         if(err != BAKE_SUCCESS)
             return err;
     }
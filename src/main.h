@@ -19,6 +19,108 @@
 #include "targets.h"
 
 
+/**
+ * How the output of jobs that execute at the same time is kept from being interleaved.
+ */
+typedef enum {
+    /**
+     * Output is printed as soon as it is written.
+     */
+    OUTPUT_SYNC_NONE,
+
+    /**
+     * The output of each command is printed once the command completes.
+     */
+    OUTPUT_SYNC_LINE,
+
+    /**
+     * The output of all the commands of a target is printed once the target has been executed.
+     */
+    OUTPUT_SYNC_TARGET,
+
+    /**
+     * The output of all the commands of a target is only printed if one of them failed.
+     */
+    OUTPUT_SYNC_FAILED
+} OutputSync;
+
+
+/**
+ * How a jobserver created by bake is passed to the commands it executes.
+ */
+typedef enum {
+    /**
+     * The path of the jobserver's FIFO is passed, as by GNU make 4.4 and later.
+     */
+    JOBSERVER_STYLE_FIFO,
+
+    /**
+     * File descriptors open to the jobserver's FIFO are passed, as expected by GNU make before 4.4.
+     */
+    JOBSERVER_STYLE_PIPE
+} JobServerStyle;
+
+
+/**
+ * How bake decides whether the inputs of a target have changed since it was last executed.
+ */
+typedef enum {
+    /**
+     * A target is executed if any of its inputs were modified more recently than its file, or than when
+     * it last finished if it was recorded as not creating a file, or if its commands were edited.
+     */
+    FRESHNESS_MTIME,
+
+    /**
+     * A target is executed if the contents of any of its inputs differ from those recorded the last time
+     * it was executed. Targets without a record fall back to comparing modification times.
+     */
+    FRESHNESS_HASH
+} FreshnessMode;
+
+
+/**
+ * The value returned by getopt_long for the --jobserver-style option, which has no short option.
+ */
+#define OPTION_JOBSERVER_STYLE  256
+
+
+/**
+ * The value returned by getopt_long for the --timeout option, which has no short option.
+ */
+#define OPTION_TIMEOUT  257
+
+
+/**
+ * The value returned by getopt_long for the --rusage-report option, which has no short option.
+ */
+#define OPTION_RUSAGE_REPORT  258
+
+
+/**
+ * The value returned by getopt_long for the --rusage-json option, which has no short option.
+ */
+#define OPTION_RUSAGE_JSON  259
+
+
+/**
+ * The value returned by getopt_long for the --trace option, which has no short option.
+ */
+#define OPTION_TRACE  260
+
+
+/**
+ * The value returned by getopt_long for the --stats option, which has no short option.
+ */
+#define OPTION_STATS  261
+
+
+/**
+ * The value returned by getopt_long for the --freshness option, which has no short option.
+ */
+#define OPTION_FRESHNESS  262
+
+
 /**
  * The arguments supplied to the program.
  */
@@ -47,6 +149,14 @@ typedef struct {
      */
     bool requireSuccess;
 
+    /**
+     * Whether we want to keep executing the targets that don't depend on a target
+     * that failed, instead of stopping once any target fails.
+     *
+     * Default: FALSE
+     */
+    bool keepGoing;
+
     /**
      * Whether we want to only print the commands that
      * we would execute, and not actually execute them.
@@ -72,12 +182,116 @@ typedef struct {
     bool silent;
 
     /**
-     * The target that we want to execute, or NULL if the
-     * default first target in the bakefile is to be used.
+     * The maximum number of jobs that we want to execute at once.
+     *
+     * Default: 1
+     */
+    size_t jobs;
+
+    /**
+     * Whether we want to find the number of jobs to execute at once from the processors
+     * available to bake, and grow and shrink it as the pressure on the machine changes.
+     *
+     * Default: FALSE
+     */
+    bool automaticJobs;
+
+    /**
+     * Whether the number of jobs was given with -j, in which case bake does not
+     * share the jobs of a jobserver from the make that started it.
+     *
+     * Default: FALSE
+     */
+    bool explicitJobs;
+
+    /**
+     * The load above which we don't want to start any new jobs, or 0 for no limit.
+     *
+     * Default: 0
+     */
+    double maxLoad;
+
+    /**
+     * Whether we want to execute simple echo, mkdir, touch, rm
+     * and cp commands within bake, instead of in a new process.
+     *
+     * Default: TRUE
+     */
+    bool useBuiltins;
+
+    /**
+     * How the output of jobs is kept from being interleaved.
+     *
+     * Default: OUTPUT_SYNC_NONE
+     */
+    OutputSync outputSync;
+
+    /**
+     * How a jobserver created by bake is passed to the commands it executes.
+     *
+     * Default: JOBSERVER_STYLE_PIPE
+     */
+    JobServerStyle jobServerStyle;
+
+    /**
+     * The number of seconds each command may execute for before it is stopped,
+     * or 0 for no limit. Targets may set their own timeout.
+     *
+     * Default: 0
+     */
+    double timeout;
+
+    /**
+     * The number of commands to list in a table of the commands that used the most
+     * CPU time once execution has finished, or 0 to not print the table.
+     *
+     * Default: 0
+     */
+    size_t usageReportCount;
+
+    /**
+     * The file to write the resources used by each command to as JSON, or NULL to not write them.
      *
      * Default: NULL
      */
-    char * target;
+    char * usageJSON;
+
+    /**
+     * The file to write a timeline of the build to in the Trace Event Format, or NULL to not write one.
+     *
+     * Default: NULL
+     */
+    char * tracePath;
+
+    /**
+     * Whether we want to print how long each phase took, and counters of the work bake did itself, when we exit.
+     *
+     * Default: FALSE
+     */
+    bool printStats;
+
+    /**
+     * How we decide whether the inputs of a target have changed since it was last executed.
+     *
+     * Default: FRESHNESS_MTIME
+     */
+    FreshnessMode freshness;
+
+    /**
+     * The names of the targets that we want to execute, which are all
+     * executed together. If there are none, the default first target
+     * in the bakefile is executed.
+     *
+     * Default: NULL
+     */
+    char ** targets;
+
+    /**
+     * The number of names in targets.
+     *
+     * Default: 0
+     */
+    size_t targetCount;
 } BakeOptions;
 
 
@@ -88,6 +302,59 @@ typedef struct {
 BakeError readCommandLineOptions(int argc, char * argv[], BakeOptions * options);
 
 
+/**
+ * Find each of the targets of {@param bakefile} named in {@param options}, or its first target if none
+ * were named, and place a Buffer containing a list of them into {@param out}.
+ */
+BakeError findTargets(BakeOptions options, Bakefile * bakefile, Buffer * out);
+
+
+/**
+ * Parse the output synchronisation mode {@param value} of the command-line option
+ * --output-sync, and place it into {@param out}.
+ */
+BakeError readOutputSyncOption(char * value, OutputSync * out);
+
+
+/**
+ * Read the value {@param value} of the --jobserver-style option, and place it into {@param out}.
+ */
+BakeError readJobServerStyleOption(char * value, JobServerStyle * out);
+
+
+/**
+ * Read the value {@param value} of the --freshness option, and place it into {@param out}.
+ */
+BakeError readFreshnessOption(char * value, FreshnessMode * out);
+
+
+/**
+ * Read the number of seconds {@param value} of the --timeout option, and place it into {@param out}.
+ */
+BakeError readTimeoutOption(char * value, double * out);
+
+
+/**
+ * Read the number of commands {@param value} of the --rusage-report option, which is
+ * USAGE_REPORT_DEFAULT_COUNT if {@param value} is NULL, and place it into {@param out}.
+ */
+BakeError readUsageReportOption(char * value, size_t * out);
+
+
+/**
+ * Parse the positive count {@param value} of the command-line option {@param option},
+ * and place it into {@param out}.
+ */
+BakeError readCountOption(char option, char * value, size_t * out);
+
+
+/**
+ * Parse the positive decimal number {@param value} of the command-line option {@param option},
+ * and place it into {@param out}.
+ */
+BakeError readDecimalOption(char option, char * value, double * out);
+
+
 /**
  * Print out the action line {@param actionLine} to {@param file}.
  *
@@ -103,7 +370,21 @@ BakeError printTarget(FILE * file, Target * target);
 
 
 /**
- * Print out the bakefile {@param bakefile} to {@param file}.
+ * Print out the declaration of the pool {@param pool} with the name {@param name} to {@param file}.
+ */
+BakeError printPool(FILE * file, char * name, JobPool * pool);
+
+
+/**
+ * Print out the settings of the target {@param target} of {@param bakefile} that differ
+ * from their defaults to {@param file}, each as a line of the form "target : name = value".
+ */
+BakeError printTargetSettings(FILE * file, Bakefile * bakefile, Target * target);
+
+
+/**
+ * Print out the bakefile {@param bakefile} to {@param file}, starting with its pools.
+ * The settings of each target are printed after it.
  *
  * Will not print any variables that may have
  * been found while parsing {@param bakefile},
@@ -0,0 +1,115 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "output.h"
+
+
+BakeError output_allocate(OutputBuffer * out) {
+    out->spill = NULL;
+    return strbuilder_allocate(&out->buffer, 256);
+}
+
+
+void output_free(OutputBuffer * output) {
+    if(output->spill != NULL) {
+        fclose(output->spill);
+        output->spill = NULL;
+    }
+
+    strbuilder_free(&output->buffer);
+}
+
+
+BakeError output_append(OutputBuffer * output, char * data, size_t length) {
+    // If the output would grow too large to keep in memory, move it into a temporary file
+    if(output->spill == NULL && output->buffer.buffer.used + length > OUTPUT_MEMORY_LIMIT) {
+        output->spill = tmpfile();
+        if(output->spill == NULL) {
+            reportError("Unable to create temporary file to hold output: %s\n", strerror(errno));
+            return BAKE_ERROR_IO;
+        }
+
+        size_t used = output->buffer.buffer.used;
+        if(fwrite(strbuilder_get(&output->buffer), 1, used, output->spill) != used) {
+            reportError("Unable to write output to temporary file: %s\n", strerror(errno));
+            return BAKE_ERROR_IO;
+        }
+
+        strbuilder_reset(&output->buffer);
+    }
+
+    if(output->spill != NULL) {
+        if(fwrite(data, 1, length, output->spill) != length) {
+            reportError("Unable to write output to temporary file: %s\n", strerror(errno));
+            return BAKE_ERROR_IO;
+        }
+
+        return BAKE_SUCCESS;
+    }
+
+    return strbuilder_appendSubstring(&output->buffer, data, length);
+}
+
+
+BakeError output_flush(OutputBuffer * output, FILE * file) {
+    BakeError err = BAKE_SUCCESS;
+
+    if(output->spill != NULL) {
+        // Copy the contents of the temporary file
+        char buf[4096];
+        size_t charsRead;
+
+        rewind(output->spill);
+        while(err == BAKE_SUCCESS && (charsRead = fread(buf, 1, sizeof(buf), output->spill)) > 0) {
+            if(fwrite(buf, 1, charsRead, file) != charsRead) {
+                reportError("Unable to print output: %s\n", strerror(errno));
+                err = BAKE_ERROR_IO;
+            }
+        }
+
+        if(err == BAKE_SUCCESS && ferror(output->spill)) {
+            reportError("Unable to read output from temporary file: %s\n", strerror(errno));
+            err = BAKE_ERROR_IO;
+        }
+    } else {
+        size_t used = output->buffer.buffer.used;
+        if(fwrite(strbuilder_get(&output->buffer), 1, used, file) != used) {
+            reportError("Unable to print output: %s\n", strerror(errno));
+            err = BAKE_ERROR_IO;
+        }
+    }
+
+    if(fflush(file) != 0 && err == BAKE_SUCCESS) {
+        reportError("Unable to print output: %s\n", strerror(errno));
+        err = BAKE_ERROR_IO;
+    }
+
+    output_discard(output);
+    return err;
+}
+
+
+void output_discard(OutputBuffer * output) {
+    strbuilder_reset(&output->buffer);
+
+    // Go back to keeping the output in memory
+    if(output->spill != NULL) {
+        fclose(output->spill);
+        output->spill = NULL;
+    }
+}
+
+
+bool output_isSameFile(int fd, int otherFD) {
+    struct stat status;
+    struct stat otherStatus;
+    if(fstat(fd, &status) != 0 || fstat(otherFD, &otherStatus) != 0)
+        return false;
+
+    return status.st_dev == otherStatus.st_dev && status.st_ino == otherStatus.st_ino;
+}
@@ -0,0 +1,84 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === output ===
+//
+// Collects the output of a job so that it can be printed all at once, without
+// being interleaved with the output of other jobs that are executing at the same time.
+//
+
+#ifndef CITS2002_OUTPUT_H
+#define CITS2002_OUTPUT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "errors.h"
+#include "stringbuilder.h"
+
+
+/**
+ * The most output that is held in memory for a job, after which its output is moved into a temporary file.
+ */
+#define OUTPUT_MEMORY_LIMIT  (1024 * 1024)
+
+
+/**
+ * The output collected from a job that has not been printed yet.
+ */
+typedef struct {
+    /**
+     * The output collected in memory.
+     */
+    StringBuilder buffer;
+
+    /**
+     * A temporary file holding all of the output once there was more than OUTPUT_MEMORY_LIMIT
+     * of it, in which case buffer is no longer used. Otherwise NULL.
+     */
+    FILE * spill;
+} OutputBuffer;
+
+
+/**
+ * Allocate a new empty OutputBuffer, and place it into {@param out}.
+ */
+BakeError output_allocate(OutputBuffer * out);
+
+
+/**
+ * Free the resources of {@param output}, discarding any output that has not been printed.
+ */
+void output_free(OutputBuffer * output);
+
+
+/**
+ * Append the {@param length} bytes of {@param data} to {@param output}. If this takes the output past
+ * OUTPUT_MEMORY_LIMIT, all of the output is moved into a temporary file.
+ */
+BakeError output_append(OutputBuffer * output, char * data, size_t length);
+
+
+/**
+ * Write all the output in {@param output} to {@param file}, and then empty {@param output}.
+ * The output is discarded even if it could not all be written.
+ */
+BakeError output_flush(OutputBuffer * output, FILE * file);
+
+
+/**
+ * Empty {@param output} without printing it.
+ */
+void output_discard(OutputBuffer * output);
+
+
+/**
+ * @return whether the file descriptors {@param fd} and {@param otherFD} refer to the same file
+ */
+bool output_isSameFile(int fd, int otherFD);
+
+
+#endif //CITS2002_OUTPUT_H
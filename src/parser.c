@@ -3,6 +3,11 @@
    Student number(s):	22494652
  */
 
+// strdup and strndup are POSIX, which glibc hides under -std=c99 without a feature-test macro
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "parser.h"
 #include "files.h"
 
@@ -40,6 +45,16 @@ BakeError parse_allocate(ParseContext * out) {
         return err;
     }
 
+    // Allocate a buffer to hold the settings of targets until they are applied
+    err = buf_allocate(&out->targetSettings, 4 * sizeof(TargetSetting));
+    if(err != BAKE_SUCCESS) {
+        strmap_free(&out->variables);
+        strbuilder_free(&out->tempBuffer);
+        strbuilder_free(&out->readBuffer);
+        strbuilder_free(&out->expandBuffer);
+        return err;
+    }
+
     return BAKE_SUCCESS;
 }
 
@@ -49,6 +64,18 @@ void parse_free(ParseContext * context) {
     strbuilder_free(&context->tempBuffer);
     strbuilder_free(&context->readBuffer);
     strbuilder_free(&context->expandBuffer);
+
+    // Free the strings of each target setting
+    size_t settingCount = context->targetSettings.used / sizeof(TargetSetting);
+    TargetSetting * settings = buf_get(&context->targetSettings);
+
+    for(size_t index = 0; index < settingCount; ++index) {
+        free(settings[index].target);
+        free(settings[index].name);
+        free(settings[index].value);
+    }
+
+    buf_free(&context->targetSettings);
 }
 
 
@@ -94,7 +121,7 @@ bool isIdentifierCharacter(const char ch) {
      * and so not allowing '(' in variable names is sufficient. Also '$' makes more sense in variable names
      * than brackets.
      */
-    return !isspace(ch) && ch != '=' && ch != ':' && ch != '(' && ch != ')';
+    return ch != '\0' && !isspace(ch) && ch != '=' && ch != ':' && ch != '(' && ch != ')';
 }
 
 
@@ -284,6 +311,16 @@ BakeError parseVariable(ParseContext * context, StringMap * variables, char * id
 
 
 BakeError parseTarget(ParseContext * context, Bakefile * bakefile, char * identifier, char * restOfLine) {
+    // A line of the form "target : name = value" gives a setting to a target, rather than defining it
+    if(isTargetSetting(restOfLine)) {
+        BakeError err = parseTargetSetting(context, identifier, restOfLine);
+        if(err == BAKE_SUCCESS) {
+            // The identifier isn't kept, as it is copied into the setting
+            free(identifier);
+        }
+        return err;
+    }
+
     // Allocate space for storing the output target when we add it to bakefile
     Target * target = malloc(sizeof(Target));
     if(target == NULL) {
@@ -340,6 +377,277 @@ BakeError parseTarget(ParseContext * context, Bakefile * bakefile, char * identi
 }
 
 
+bool isTargetSetting(char * restOfLine) {
+    restOfLine = trimLeadingWhitespace(restOfLine);
+
+    // The name of the setting must be followed by an '='
+    size_t length = 0;
+    while(isIdentifierCharacter(restOfLine[length])) {
+        length += 1;
+    }
+
+    return length > 0 && *trimLeadingWhitespace(&restOfLine[length]) == '=';
+}
+
+
+BakeError parseTargetSetting(ParseContext * context, char * identifier, char * restOfLine) {
+    restOfLine = trimLeadingWhitespace(restOfLine);
+
+    char * name;
+    BakeError err = parseIdentifier(restOfLine, &name);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Move past the name and the '='
+    restOfLine = trimLeadingWhitespace(&restOfLine[strlen(name)]) + 1;
+    restOfLine = trimLeadingWhitespace(restOfLine);
+
+    // Remove any whitespace after the value
+    size_t valueLength = strlen(restOfLine);
+    while(valueLength > 0 && isspace(restOfLine[valueLength - 1])) {
+        valueLength -= 1;
+    }
+
+    TargetSetting setting;
+    setting.target = strdup(identifier);
+    setting.name = name;
+    setting.value = strndup(restOfLine, valueLength);
+
+    if(setting.target == NULL || setting.value == NULL) {
+        reportError("Unable to copy setting of target %s: %s\n", identifier, strerror(errno));
+        free(setting.target);
+        free(setting.name);
+        free(setting.value);
+        return BAKE_ERROR_MEMORY;
+    }
+
+    // Settings shouldn't appear in the middle of a target's action lines
+    context->activeTarget = NULL;
+
+    err = buf_append(&context->targetSettings, &setting, sizeof(TargetSetting));
+    if(err != BAKE_SUCCESS) {
+        free(setting.target);
+        free(setting.name);
+        free(setting.value);
+    }
+
+    return err;
+}
+
+
+BakeError parsePool(Bakefile * bakefile, char * restOfLine) {
+    char * name;
+    BakeError err = parseIdentifier(restOfLine, &name);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    restOfLine = trimLeadingWhitespace(&restOfLine[strlen(name)]);
+    if(*restOfLine != '=') {
+        reportError("Expected '=' after the name of pool %s\n", name);
+        free(name);
+        return BAKE_ERROR_PARSING;
+    }
+
+    // Split the rest of the line into its words, the first of which is the depth of the pool
+    char * words = strdup(restOfLine + 1);
+    if(words == NULL) {
+        reportError("Unable to copy declaration of pool %s: %s\n", name, strerror(errno));
+        free(name);
+        return BAKE_ERROR_MEMORY;
+    }
+
+    char * saveState;
+    char * word = strtok_r(words, " \t", &saveState);
+
+    size_t depth;
+    if(word == NULL || !parseCount(word, &depth)) {
+        reportError("Expected a positive number for the depth of pool %s\n", name);
+        free(words);
+        free(name);
+        return BAKE_ERROR_PARSING;
+    }
+
+    JobPool * pool = malloc(sizeof(JobPool));
+    if(pool == NULL) {
+        reportError("Unable to allocate space for pool %s: %s\n", name, strerror(errno));
+        free(words);
+        free(name);
+        return BAKE_ERROR_MEMORY;
+    }
+
+    err = jobpool_allocate(pool, depth);
+    if(err != BAKE_SUCCESS) {
+        free(pool);
+        free(words);
+        free(name);
+        return err;
+    }
+
+    // Read the options of the pool that follow its depth
+    while(err == BAKE_SUCCESS && (word = strtok_r(NULL, " \t", &saveState)) != NULL) {
+        if(strncmp(word, "nice=", strlen("nice=")) == 0) {
+            char * end;
+            long nice = strtol(word + strlen("nice="), &end, 10);
+
+            if(*end != '\0' || end == word + strlen("nice=") || nice < -20 || nice > 19) {
+                reportError("Expected a nice level between -20 and 19 for pool %s, found \"%s\"\n", name, word);
+                err = BAKE_ERROR_PARSING;
+            }
+
+            pool->nice = (int) nice;
+        } else if(strncmp(word, "affinity=", strlen("affinity=")) == 0) {
+            err = jobpool_parseAffinity(pool, word + strlen("affinity="));
+        } else {
+            reportError("Unknown option \"%s\" for pool %s, expected nice= or affinity=\n", word, name);
+            err = BAKE_ERROR_PARSING;
+        }
+    }
+
+    free(words);
+
+    if(err == BAKE_SUCCESS) {
+        err = bakefile_addPool(bakefile, name, pool);
+    }
+
+    if(err != BAKE_SUCCESS) {
+        jobpool_free(pool);
+        free(pool);
+        free(name);
+    }
+
+    return err;
+}
+
+
+bool parseCount(char * value, size_t * out) {
+    char * end;
+    errno = 0;
+    long long count = strtoll(value, &end, 10);
+
+    if(errno != 0 || end == value || *end != '\0' || count <= 0)
+        return false;
+
+    *out = (size_t) count;
+    return true;
+}
+
+
+bool parseSeconds(char * value, double * out) {
+    char * end;
+    errno = 0;
+    double seconds = strtod(value, &end);
+
+    if(errno != 0 || end == value || *end != '\0' || !(seconds > 0))
+        return false;
+
+    *out = seconds;
+    return true;
+}
+
+
+BakeError findPool(Bakefile * bakefile, char * name, JobPool ** out) {
+    *out = bakefile_getPool(bakefile, name);
+    if(*out != NULL)
+        return BAKE_SUCCESS;
+
+    if(strcmp(name, MEMORY_POOL) != 0) {
+        reportError("Could not find the pool %s\n", name);
+        return BAKE_ERROR_PARSING;
+    }
+
+    // Create the memory pool from the memory available to us
+    char * poolName = strdup(MEMORY_POOL);
+    JobPool * pool = malloc(sizeof(JobPool));
+    if(poolName == NULL || pool == NULL) {
+        reportError("Unable to allocate space for the memory pool: %s\n", strerror(errno));
+        free(poolName);
+        free(pool);
+        return BAKE_ERROR_MEMORY;
+    }
+
+    BakeError err = jobpool_allocate(pool, findAvailableMemory());
+    if(err != BAKE_SUCCESS) {
+        free(poolName);
+        free(pool);
+        return err;
+    }
+
+    err = bakefile_addPool(bakefile, poolName, pool);
+    if(err != BAKE_SUCCESS) {
+        jobpool_free(pool);
+        free(poolName);
+        free(pool);
+        return err;
+    }
+
+    *out = pool;
+    return BAKE_SUCCESS;
+}
+
+
+BakeError applyTargetSettings(ParseContext * context, Bakefile * bakefile) {
+    size_t settingCount = context->targetSettings.used / sizeof(TargetSetting);
+    TargetSetting * settings = buf_get(&context->targetSettings);
+
+    for(size_t index = 0; index < settingCount; ++index) {
+        TargetSetting * setting = &settings[index];
+
+        Target * target = bakefile_getTarget(bakefile, setting->target);
+        if(target == NULL) {
+            reportError("Could not find the target %s to apply the setting %s to\n", setting->target, setting->name);
+            return BAKE_ERROR_PARSING;
+        }
+
+        // The job slots the target takes, out of the number of jobs that may execute at once
+        if(strcmp(setting->name, "cpus") == 0) {
+            if(!parseCount(setting->value, &target->cpus)) {
+                reportError("Expected a positive number for cpus of target %s, found \"%s\"\n",
+                            target->name, setting->value);
+                return BAKE_ERROR_PARSING;
+            }
+            continue;
+        }
+
+        // How long each command of the target may execute for before it is stopped
+        if(strcmp(setting->name, "timeout") == 0) {
+            if(!parseSeconds(setting->value, &target->timeout)) {
+                reportError("Expected a positive number of seconds for timeout of target %s, found \"%s\"\n",
+                            target->name, setting->value);
+                return BAKE_ERROR_PARSING;
+            }
+            continue;
+        }
+
+        // The target takes one token from the named pool
+        JobPool * pool;
+        size_t cost = 1;
+
+        if(strcmp(setting->name, "pool") == 0) {
+            BakeError err = findPool(bakefile, setting->value, &pool);
+            if(err != BAKE_SUCCESS)
+                return err;
+        } else {
+            // Or a number of tokens from the pool with the name of the setting
+            BakeError err = findPool(bakefile, setting->name, &pool);
+            if(err != BAKE_SUCCESS)
+                return err;
+
+            if(!parseCount(setting->value, &cost)) {
+                reportError("Expected a positive number for %s of target %s, found \"%s\"\n",
+                            setting->name, target->name, setting->value);
+                return BAKE_ERROR_PARSING;
+            }
+        }
+
+        BakeError err = target_addPoolCost(target, pool, cost);
+        if(err != BAKE_SUCCESS)
+            return err;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
 BakeError parseIdentifierLine(ParseContext * context, Bakefile * bakefile, StringMap * variables, char * line) {
     // Parse an identifier from the start of the line
     char * identifier;
@@ -353,6 +661,16 @@ BakeError parseIdentifierLine(ParseContext * context, Bakefile * bakefile, Strin
     // Skip all whitespace characters
     line = trimLeadingWhitespace(line);
 
+    // The word pool followed by another word is the declaration of a pool
+    if(strcmp(identifier, "pool") == 0 && isIdentifierCharacter(*line)) {
+        free(identifier);
+
+        // Pool declarations shouldn't appear in the middle of a target's action lines
+        context->activeTarget = NULL;
+
+        return parsePool(bakefile, line);
+    }
+
     // The first non-whitespace character after the identifier will
     // tell us whether this is a variable definition or a target definition
     char ch = *(line++);
@@ -419,6 +737,19 @@ BakeError parseActionLine(ParseContext * context, char * line) {
     ActionLine actionLine;
     actionLine.skipPrinting = false;
     actionLine.requireSuccess = true;
+    actionLine.concurrent = false;
+    actionLine.failed = false;
+
+    /**
+     * An '&' character at the start of an action line signifies that the action
+     * lines after it may be executed without waiting for it to complete.
+     */
+    if(*line == '&') {
+        actionLine.concurrent = true;
+
+        // Move past the '&' character
+        line++;
+    }
 
     // Look for special cases for this action line
     switch (*line) {
@@ -453,12 +784,88 @@ BakeError parseActionLine(ParseContext * context, char * line) {
 
     // Duplicate the ActionLine's command, so we can store it for later.
     actionLine.command = strdup(line);
+    if(actionLine.command == NULL) {
+        reportError("Unable to copy action line's command: %s\n", strerror(errno));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    // Split the command into its arguments, if it can be executed without a shell
+    BakeError err = tokenizeCommand(actionLine.command, &actionLine.arguments);
+    if(err != BAKE_SUCCESS)
+        return err;
 
     // Add the action line to the active target
     return target_addActionLine(context->activeTarget, actionLine);
 }
 
 
+BakeError parseShell(StringMap * variables, Bakefile * bakefile) {
+    // Unlike other variables, SHELL is not taken from the environment, as it contains the user's login shell
+    char * shell = strmap_get(variables, "SHELL");
+    if(shell == NULL || isEmptyLine(shell)) {
+        shell = DEFAULT_SHELL;
+    }
+
+    // Copy the shell, as the variables will be free'd once parsing is finished
+    bakefile->shell = strdup(shell);
+    if(bakefile->shell == NULL) {
+        reportError("Unable to copy the SHELL variable: %s\n", strerror(errno));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError parseSpecialTargets(Bakefile * bakefile) {
+    Target * oneShell = bakefile_getTarget(bakefile, ".ONESHELL");
+    if(oneShell != NULL) {
+        size_t dependencyCount = target_dependencyCount(oneShell);
+        char ** dependencies = target_getDependencies(oneShell);
+
+        // If .ONESHELL has no dependencies, it applies to every target
+        if(dependencyCount == 0) {
+            size_t targetCount = strmap_size(&bakefile->targets);
+            StringMapEntry * entries = strmap_entries(&bakefile->targets);
+
+            for(size_t index = 0; index < targetCount; ++index) {
+                ((Target *) entries[index].value)->oneShell = true;
+            }
+        }
+
+        // Otherwise, it applies to each of its dependencies
+        for(size_t index = 0; index < dependencyCount; ++index) {
+            Target * target = bakefile_getTarget(bakefile, dependencies[index]);
+            if(target == NULL) {
+                reportError("Could not find the target %s listed by .ONESHELL\n", dependencies[index]);
+                return BAKE_ERROR_PARSING;
+            }
+
+            target->oneShell = true;
+        }
+    }
+
+    // Each dependency of .PRIORITY, and the targets it depends on, are started before other targets
+    Target * priority = bakefile_getTarget(bakefile, ".PRIORITY");
+    if(priority != NULL) {
+        size_t dependencyCount = target_dependencyCount(priority);
+        char ** dependencies = target_getDependencies(priority);
+
+        for(size_t index = 0; index < dependencyCount; ++index) {
+            Target * target = bakefile_getTarget(bakefile, dependencies[index]);
+            if(target == NULL) {
+                reportError("Could not find the target %s listed by .PRIORITY\n", dependencies[index]);
+                return BAKE_ERROR_PARSING;
+            }
+
+            target->priorityHint = true;
+        }
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
 BakeError parseBakefile(BakeOptions options, FILE * file, Bakefile * bakefile) {
     // Stores whether parsing was a success
     BakeError err;
@@ -466,6 +873,9 @@ BakeError parseBakefile(BakeOptions options, FILE * file, Bakefile * bakefile) {
     // Stores the line number of the current line being parsed
     size_t currentLineNumber;
 
+    // Stores when we started parsing, for the trace of the build
+    double start = monotonicTime();
+
     // Allocate the output bakefile
     err = bakefile_allocate(bakefile);
     if(err != BAKE_SUCCESS)
@@ -525,6 +935,21 @@ BakeError parseBakefile(BakeOptions options, FILE * file, Bakefile * bakefile) {
             break;
     }
 
+    // Find the shell that should be used to execute commands
+    if(err == BAKE_SUCCESS) {
+        err = parseShell(&context.variables, bakefile);
+    }
+
+    // Apply the special targets to the rest of the targets
+    if(err == BAKE_SUCCESS) {
+        err = parseSpecialTargets(bakefile);
+    }
+
+    // Apply the settings given to targets, now that all the targets and pools are known
+    if(err == BAKE_SUCCESS) {
+        err = applyTargetSettings(&context, bakefile);
+    }
+
     // If we hit an error, print the line number we encountered it on, and free the parsed bakefile
     if(err != BAKE_SUCCESS) {
         reportError(" .. while parsing line %li of the bakefile\n", currentLineNumber);
@@ -534,6 +959,10 @@ BakeError parseBakefile(BakeOptions options, FILE * file, Bakefile * bakefile) {
     // Free all our temporary allocated resources
     parse_free(&context);
 
+    double end = monotonicTime();
+    trace_span(trace_currentLane(), "phase", "parse", NULL, start, end);
+    stats_addTime(STAT_PHASE_PARSE, end - start);
+
     // Finished!
     return err;
 }
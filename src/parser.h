@@ -25,6 +25,33 @@
 #include "stringmap.h"
 #include "main.h"
 #include "targets.h"
+#include "command.h"
+#include "jobpool.h"
+#include "load.h"
+#include "trace.h"
+#include "stats.h"
+
+
+/**
+ * A setting given to a target by a line of the form "target : name = value", which is
+ * applied once the whole bakefile has been parsed. All its strings are owned by it.
+ */
+typedef struct {
+    /**
+     * The name of the target the setting applies to.
+     */
+    char * target;
+
+    /**
+     * The name of the setting.
+     */
+    char * name;
+
+    /**
+     * The value of the setting.
+     */
+    char * value;
+} TargetSetting;
 
 
 /**
@@ -60,6 +87,11 @@ typedef struct {
      * Is used to store the values of variables throughout the parsing of the file.
      */
     StringMap variables;
+
+    /**
+     * A buffer containing a list of the TargetSetting's that have been parsed.
+     */
+    Buffer targetSettings;
 } ParseContext;
 
 
@@ -175,18 +207,94 @@ BakeError parseTarget(ParseContext * context, Bakefile * bakefile, char * identi
 
 
 /**
- * Parse a line beginning with an identifier, which could signify
- * either a variable definition or the start of a target defintion.
+ * @return whether {@param restOfLine}, the rest of a target line after its ':', is of the form "name = value"
+ */
+bool isTargetSetting(char * restOfLine);
+
+
+/**
+ * Parse the setting in {@param restOfLine}, of the form "name = value", for the target {@param identifier},
+ * and add it to {@param context} to be applied once the whole bakefile has been parsed.
+ */
+BakeError parseTargetSetting(ParseContext * context, char * identifier, char * restOfLine);
+
+
+/**
+ * Parse the declaration of a pool in {@param restOfLine}, which follows the word "pool",
+ * and add the pool to {@param bakefile}. The declaration is of the form
+ * "name = depth [nice=level] [affinity=cpus]".
+ */
+BakeError parsePool(Bakefile * bakefile, char * restOfLine);
+
+
+/**
+ * Parse {@param value} as a positive whole number, and place it into {@param out}.
+ *
+ * @return whether {@param value} was a positive whole number
+ */
+bool parseCount(char * value, size_t * out);
+
+
+/**
+ * Parse {@param value} as a positive number of seconds, and place it into {@param out}.
+ *
+ * @return whether {@param value} was a positive number
+ */
+bool parseSeconds(char * value, double * out);
+
+
+/**
+ * Find the pool named {@param name} in {@param bakefile}, and place it into {@param out}. If the memory pool
+ * is used without being declared, it is created with the memory available to bake in megabytes as its depth.
+ */
+BakeError findPool(Bakefile * bakefile, char * name, JobPool ** out);
+
+
+/**
+ * Apply each of the settings in {@param context} to the targets of {@param bakefile}:
+ *
+ *   pool = name    = Take a token from the pool name while the target executes.
+ *   cpus = count   = Take count of the jobs that may execute at once while the target executes.
+ *   timeout = secs = Stop each command of the target that executes for longer than secs seconds.
+ *   name = count   = Take count tokens from the pool name while the target executes, such as memory = 8000.
+ */
+BakeError applyTargetSettings(ParseContext * context, Bakefile * bakefile);
+
+
+/**
+ * Parse a line beginning with an identifier, which could signify a variable definition,
+ * the start of a target defintion, a target setting, or the declaration of a pool.
  */
 BakeError parseIdentifierLine(ParseContext * context, Bakefile * bakefile, StringMap * variables, char * line);
 
 
 /**
  * Parse the action line {@param line} and add it to the active target in {@param context}.
+ *
+ * Commands that don't need a shell are split into their arguments here, so that they can be executed directly.
  */
 BakeError parseActionLine(ParseContext * context, char * line);
 
 
+/**
+ * Find the shell to execute commands with from the SHELL variable in {@param variables}, or use
+ * DEFAULT_SHELL if it is not set, and place a copy of it into {@param bakefile}.
+ */
+BakeError parseShell(StringMap * variables, Bakefile * bakefile);
+
+
+/**
+ * Apply the special targets of {@param bakefile} to its other targets:
+ *
+ *   .ONESHELL = Execute all the action lines of each of its dependencies as one script in a single
+ *               shell, or of every target in {@param bakefile} if it has no dependencies.
+ *
+ *   .PRIORITY = Start each of its dependencies, and the targets they depend on, before any other
+ *               targets that are ready to be executed at the same time.
+ */
+BakeError parseSpecialTargets(Bakefile * bakefile);
+
+
 /**
  * Parse the bakefile from {@param file}, and put the result in {@param bakefile}.
  */
@@ -0,0 +1,192 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+// O_DIRECTORY, O_CLOEXEC, fstatat and strndup are POSIX.1-2008, and -std=c99 hides them on glibc without a feature-test macro
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "statbatch.h"
+#include "load.h"
+#include "stats.h"
+
+
+BakeError statbatch_run(StatCache * cache, char ** paths, size_t count) {
+    if(count == 0)
+        return BAKE_SUCCESS;
+
+    // Find the directory of each path once, rather than every time it is compared
+    FilePath * files = malloc(count * sizeof(FilePath));
+    if(files == NULL) {
+        reportError("Unable to allocate memory to find the status of files: %s\n", strerror(errno));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    for(size_t index = 0; index < count; ++index) {
+        files[index].path = paths[index];
+        files[index].directoryLength = statbatch_directoryLength(paths[index]);
+    }
+
+    // Group the files of each directory together
+    qsort(files, count, sizeof(FilePath), statbatch_compare);
+
+    Buffer groups;
+    BakeError err = buf_allocate(&groups, 64 * sizeof(FileGroup));
+    if(err != BAKE_SUCCESS) {
+        free(files);
+        return err;
+    }
+
+    for(size_t index = 0; index < count && err == BAKE_SUCCESS; ++index) {
+        FilePath file = files[index];
+
+        // Only find the status of each path once
+        if(index > 0 && strcmp(file.path, files[index - 1].path) == 0)
+            continue;
+
+        FileGroup * last = (groups.used > 0 ? (FileGroup *) buf_head(&groups) - 1 : NULL);
+        if(last != NULL && last->files[0].directoryLength == file.directoryLength
+           && strncmp(last->files[0].path, file.path, file.directoryLength) == 0) {
+
+            // Add the file to the group, moving it over any duplicate paths skipped before it
+            last->files[last->count++] = file;
+            continue;
+        }
+
+        FileGroup group;
+        group.cache = cache;
+        group.files = &files[index];
+        group.count = 1;
+        err = buf_append(&groups, &group, sizeof(FileGroup));
+    }
+
+    if(err != BAKE_SUCCESS) {
+        buf_free(&groups);
+        free(files);
+        return err;
+    }
+
+    // Use a worker for each processor, but never more workers than there are directories
+    size_t groupCount = groups.used / sizeof(FileGroup);
+    size_t workerCount = findAvailableProcessors();
+    if(workerCount > groupCount) {
+        workerCount = groupCount;
+    }
+
+    ThreadPool pool;
+    err = pool_allocate(&pool, workerCount, NULL);
+    if(err != BAKE_SUCCESS) {
+        buf_free(&groups);
+        free(files);
+        return err;
+    }
+
+    // Submit a task for each directory, which idle workers will steal from the first worker
+    FileGroup * groupArray = buf_get(&groups);
+    for(size_t index = 0; index < groupCount && err == BAKE_SUCCESS; ++index) {
+        err = pool_submit(&pool, NULL, statbatch_statGroup, &groupArray[index]);
+    }
+
+    BakeError waitErr = pool_wait(&pool);
+    if(err == BAKE_SUCCESS) {
+        err = waitErr;
+    }
+
+    pool_free(&pool);
+    buf_free(&groups);
+    free(files);
+    return err;
+}
+
+
+size_t statbatch_directoryLength(char * path) {
+    char * separator = strrchr(path, '/');
+    if(separator == NULL)
+        return 0;
+
+    // Keep the separator of the root directory
+    if(separator == path)
+        return 1;
+
+    return (size_t) (separator - path);
+}
+
+
+int statbatch_compare(const void * first, const void * second) {
+    const FilePath * firstFile = first;
+    const FilePath * secondFile = second;
+    size_t firstLength = firstFile->directoryLength;
+    size_t secondLength = secondFile->directoryLength;
+
+    // Compare the directories first
+    size_t commonLength = (firstLength < secondLength ? firstLength : secondLength);
+    int comparison = memcmp(firstFile->path, secondFile->path, commonLength);
+    if(comparison != 0)
+        return comparison;
+
+    if(firstLength != secondLength)
+        return (firstLength < secondLength ? -1 : 1);
+
+    return strcmp(firstFile->path, secondFile->path);
+}
+
+
+BakeError statbatch_statGroup(Worker * worker, void * argument) {
+    FileGroup * group = argument;
+
+    // Open the directory of the files once, so that their paths are only walked from it
+    int directoryFD = AT_FDCWD;
+    size_t nameOffset = 0;
+
+    size_t directoryLength = group->files[0].directoryLength;
+    if(directoryLength > 0) {
+        char * directory = strndup(group->files[0].path, directoryLength);
+        if(directory == NULL) {
+            reportError("Unable to copy directory of %s: %s\n", group->files[0].path, strerror(errno));
+            return BAKE_ERROR_MEMORY;
+        }
+
+        directoryFD = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        free(directory);
+
+        // Leave the files to be found one at a time when they are needed, so that any errors are reported then
+        if(directoryFD < 0)
+            return BAKE_SUCCESS;
+
+        // Skip the separator after the directory, which the root directory includes
+        nameOffset = directoryLength + (group->files[0].path[directoryLength] == '/' ? 1 : 0);
+    }
+
+    BakeError err = BAKE_SUCCESS;
+    for(size_t index = 0; index < group->count && err == BAKE_SUCCESS; ++index) {
+        char * name = group->files[index].path + nameOffset;
+        if(*name == '\0')
+            continue;
+
+        struct stat result;
+        int statErr = fstatat(directoryFD, name, &result, 0);
+        countStat(STAT_FILE_STATS, 1);
+
+        // Errors other than the file not existing are reported when the file is needed
+        if(statErr != 0 && errno != ENOENT)
+            continue;
+
+        FileStatus status;
+        statcache_convert((statErr == 0 ? &result : NULL), &status);
+        err = statcache_store(group->cache, group->files[index].path, status);
+    }
+
+    if(directoryFD != AT_FDCWD) {
+        close(directoryFD);
+    }
+
+    return err;
+}
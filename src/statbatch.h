@@ -0,0 +1,91 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === statbatch ===
+//
+// Finds the status of many files at once before they are needed, placing them into a StatCache.
+// The files are grouped by their directory, so that each directory is only opened once, and the
+// files within it are found with fstatat relative to it instead of walking their whole path again.
+// The directories are spread between the workers of a ThreadPool, so that many stat calls are
+// waiting on the file system at the same time.
+//
+
+#ifndef CITS2002_STATBATCH_H
+#define CITS2002_STATBATCH_H
+
+#include <stddef.h>
+#include "errors.h"
+#include "statcache.h"
+#include "threadpool.h"
+
+
+/**
+ * The path of a file whose status is to be found.
+ */
+typedef struct {
+    /**
+     * The path of the file.
+     */
+    char * path;
+
+    /**
+     * The length of the directory at the start of path, as found by statbatch_directoryLength.
+     */
+    size_t directoryLength;
+} FilePath;
+
+
+/**
+ * The files of one directory, whose status is found by one task.
+ */
+typedef struct {
+    /**
+     * The cache to place the status of the files into.
+     */
+    StatCache * cache;
+
+    /**
+     * The paths of the files, which all have the same directory.
+     */
+    FilePath * files;
+
+    /**
+     * The number of paths in files.
+     */
+    size_t count;
+} FileGroup;
+
+
+/**
+ * Find the status of each of the {@param count} files {@param paths}, and place them into {@param cache}.
+ * {@param paths} may contain the same path more than once. Files whose status can't be found,
+ * such as those in a directory that can't be opened, are left out of {@param cache}.
+ */
+BakeError statbatch_run(StatCache * cache, char ** paths, size_t count);
+
+
+/**
+ * @return the length of the directory at the start of {@param path}, without its last
+ *         separator unless it is the root directory, or 0 if {@param path} has no directory
+ */
+size_t statbatch_directoryLength(char * path);
+
+
+/**
+ * Compare the FilePath's {@param first} and {@param second} by their directory, and
+ * then by their name, so that sorting them groups the files of each directory together.
+ */
+int statbatch_compare(const void * first, const void * second);
+
+
+/**
+ * Find the status of each of the files of the FileGroup {@param argument}, as a task executed by {@param worker}.
+ */
+BakeError statbatch_statGroup(Worker * worker, void * argument);
+
+
+#endif //CITS2002_STATBATCH_H
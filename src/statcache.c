@@ -0,0 +1,221 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+// strdup and the st_mtim field of struct stat are POSIX.1-2008, which glibc hides under -std=c99 without a feature-test macro
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "statcache.h"
+#include "stats.h"
+
+
+BakeError statcache_allocate(StatCache * out) {
+    // Zeroed maps are empty, and are allocated when they are first stored into
+    out->buckets = calloc(STAT_CACHE_BUCKET_COUNT, sizeof(StringMap));
+    if(out->buckets == NULL) {
+        reportError("Unable to allocate memory for stat cache: %s\n", strerror(errno));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    for(size_t index = 0; index < STAT_CACHE_LOCK_COUNT; ++index) {
+        int err = pthread_mutex_init(&out->locks[index], NULL);
+        if(err == 0)
+            continue;
+
+        reportError("Unable to create lock for stat cache: %s\n", strerror(err));
+        while(index > 0) {
+            pthread_mutex_destroy(&out->locks[--index]);
+        }
+
+        free(out->buckets);
+        out->buckets = NULL;
+        return BAKE_ERROR_MEMORY;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+void statcache_free(StatCache * cache) {
+    for(size_t index = 0; index < STAT_CACHE_BUCKET_COUNT; ++index) {
+        strmap_free(&cache->buckets[index]);
+    }
+
+    free(cache->buckets);
+    cache->buckets = NULL;
+
+    for(size_t index = 0; index < STAT_CACHE_LOCK_COUNT; ++index) {
+        pthread_mutex_destroy(&cache->locks[index]);
+    }
+}
+
+
+size_t statcache_hash(char * path) {
+    // FNV-1a
+    size_t hash = 2166136261u;
+    for(unsigned char * character = (unsigned char *) path; *character != '\0'; ++character) {
+        hash ^= *character;
+        hash *= 16777619u;
+    }
+
+    return hash % STAT_CACHE_BUCKET_COUNT;
+}
+
+
+pthread_mutex_t * statcache_lock(StatCache * cache, size_t bucket) {
+    return &cache->locks[bucket % STAT_CACHE_LOCK_COUNT];
+}
+
+
+void statcache_convert(struct stat * result, FileStatus * out) {
+    if(result == NULL) {
+        out->exists = false;
+        out->modificationTime = -1;
+        out->size = 0;
+        out->device = 0;
+        out->inode = 0;
+        return;
+    }
+
+    out->exists = true;
+    out->modificationTime = fileTimeFromTimespec(statModificationTime(result));
+    out->size = result->st_size;
+    out->device = result->st_dev;
+    out->inode = result->st_ino;
+}
+
+
+bool statcache_lookup(StatCache * cache, char * path, FileStatus * out) {
+    size_t index = statcache_hash(path);
+    StringMap * bucket = &cache->buckets[index];
+    pthread_mutex_t * lock = statcache_lock(cache, index);
+
+    pthread_mutex_lock(lock);
+
+    StatCacheEntry * entry = strmap_get(bucket, path);
+    bool found = (entry != NULL && entry->valid);
+    if(found) {
+        *out = entry->status;
+    }
+
+    pthread_mutex_unlock(lock);
+
+    countStat(STAT_STAT_CACHE_LOOKUPS, 1);
+    if(found) {
+        countStat(STAT_STAT_CACHE_HITS, 1);
+    }
+
+    return found;
+}
+
+
+BakeError statcache_store(StatCache * cache, char * path, FileStatus status) {
+    size_t index = statcache_hash(path);
+    StringMap * bucket = &cache->buckets[index];
+    pthread_mutex_t * lock = statcache_lock(cache, index);
+    BakeError err = BAKE_SUCCESS;
+
+    pthread_mutex_lock(lock);
+
+    // Update the entry of the path if it already has one
+    StatCacheEntry * entry = strmap_get(bucket, path);
+    if(entry != NULL) {
+        entry->status = status;
+        entry->valid = true;
+        entry->hashed = false;
+        pthread_mutex_unlock(lock);
+        return BAKE_SUCCESS;
+    }
+
+    // Otherwise, add a new entry for it
+    if(bucket->entries.data == NULL) {
+        err = strmap_allocate(bucket, 4);
+        if(err != BAKE_SUCCESS) {
+            pthread_mutex_unlock(lock);
+            return err;
+        }
+    }
+
+    char * key = strdup(path);
+    entry = malloc(sizeof(StatCacheEntry));
+    if(key == NULL || entry == NULL) {
+        reportError("Unable to allocate memory to cache status of %s: %s\n", path, strerror(errno));
+        free(key);
+        free(entry);
+        pthread_mutex_unlock(lock);
+        return BAKE_ERROR_MEMORY;
+    }
+
+    entry->status = status;
+    entry->valid = true;
+    entry->hashed = false;
+    entry->hash = 0;
+
+    err = strmap_put(bucket, key, entry);
+    if(err != BAKE_SUCCESS) {
+        free(key);
+        free(entry);
+    }
+
+    pthread_mutex_unlock(lock);
+    return err;
+}
+
+
+bool statcache_lookupHash(StatCache * cache, char * path, uint64_t * out) {
+    size_t index = statcache_hash(path);
+    StringMap * bucket = &cache->buckets[index];
+    pthread_mutex_t * lock = statcache_lock(cache, index);
+
+    pthread_mutex_lock(lock);
+
+    StatCacheEntry * entry = strmap_get(bucket, path);
+    bool found = (entry != NULL && entry->valid && entry->hashed);
+    if(found) {
+        *out = entry->hash;
+    }
+
+    pthread_mutex_unlock(lock);
+    return found;
+}
+
+
+void statcache_storeHash(StatCache * cache, char * path, uint64_t hash) {
+    size_t index = statcache_hash(path);
+    StringMap * bucket = &cache->buckets[index];
+    pthread_mutex_t * lock = statcache_lock(cache, index);
+
+    pthread_mutex_lock(lock);
+
+    // The hash is only kept alongside the status it was found with
+    StatCacheEntry * entry = strmap_get(bucket, path);
+    if(entry != NULL && entry->valid) {
+        entry->hashed = true;
+        entry->hash = hash;
+    }
+
+    pthread_mutex_unlock(lock);
+}
+
+
+void statcache_invalidate(StatCache * cache, char * path) {
+    size_t index = statcache_hash(path);
+    StringMap * bucket = &cache->buckets[index];
+    pthread_mutex_t * lock = statcache_lock(cache, index);
+
+    pthread_mutex_lock(lock);
+
+    StatCacheEntry * entry = strmap_get(bucket, path);
+    if(entry != NULL) {
+        entry->valid = false;
+        entry->hashed = false;
+    }
+
+    pthread_mutex_unlock(lock);
+}
@@ -0,0 +1,184 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === statcache ===
+//
+// Remembers the results of stat for the files checked during a build, so that a file
+// that many targets depend on is only stat'ed once. The results for a file are forgotten
+// when a target that writes to it is executed. The hash of the contents of a file is also
+// remembered once it has been found, until the file's status is forgotten.
+//
+
+#ifndef CITS2002_STATCACHE_H
+#define CITS2002_STATCACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "errors.h"
+#include "stringmap.h"
+#include "filetime.h"
+
+
+/**
+ * The number of StringMap's the paths in a StatCache are spread between, so that looking up a path stays fast.
+ */
+#define STAT_CACHE_BUCKET_COUNT  65536
+
+
+/**
+ * The number of locks that the buckets of a StatCache are guarded by, so that threads looking up
+ * different paths rarely wait for each other. Must divide STAT_CACHE_BUCKET_COUNT.
+ */
+#define STAT_CACHE_LOCK_COUNT  64
+
+
+/**
+ * What was found about a file by stat.
+ */
+typedef struct {
+    /**
+     * Whether the file exists. If it doesn't, none of the other fields are used.
+     */
+    bool exists;
+
+    /**
+     * The time the file was last modified.
+     */
+    FileTime modificationTime;
+
+    /**
+     * The size of the file in bytes.
+     */
+    off_t size;
+
+    /**
+     * The device that holds the file.
+     */
+    dev_t device;
+
+    /**
+     * The inode of the file on its device.
+     */
+    ino_t inode;
+} FileStatus;
+
+
+/**
+ * The cached FileStatus of a path.
+ */
+typedef struct {
+    /**
+     * What was found about the file.
+     */
+    FileStatus status;
+
+    /**
+     * Whether status is still correct, which it stops being once the file may have been written.
+     */
+    bool valid;
+
+    /**
+     * Whether the contents of the file with this status have been hashed into hash.
+     */
+    bool hashed;
+
+    /**
+     * The hash of the contents of the file, if hashed is true.
+     */
+    uint64_t hash;
+} StatCacheEntry;
+
+
+/**
+ * A cache of the FileStatus of paths, which may be used from many threads at once.
+ */
+typedef struct {
+    /**
+     * An array of STAT_CACHE_LOCK_COUNT locks. Each bucket is guarded by the lock at its index modulo
+     * STAT_CACHE_LOCK_COUNT, which is held while the bucket is read or changed.
+     */
+    pthread_mutex_t locks[STAT_CACHE_LOCK_COUNT];
+
+    /**
+     * An array of STAT_CACHE_BUCKET_COUNT maps from paths to their StatCacheEntry's, each holding the paths
+     * whose statcache_hash selects it. Each map is only allocated once a path is stored in it.
+     */
+    StringMap * buckets;
+} StatCache;
+
+
+/**
+ * Allocate a new empty StatCache, and place it into {@param out}.
+ */
+BakeError statcache_allocate(StatCache * out);
+
+
+/**
+ * Free the resources of {@param cache} and mark it as invalid.
+ */
+void statcache_free(StatCache * cache);
+
+
+/**
+ * @return the index of the bucket of a StatCache that holds {@param path}
+ */
+size_t statcache_hash(char * path);
+
+
+/**
+ * @return the lock in {@param cache} that guards the bucket with index {@param bucket}
+ */
+pthread_mutex_t * statcache_lock(StatCache * cache, size_t bucket);
+
+
+/**
+ * Place the FileStatus described by the result {@param result} of stat into {@param out},
+ * or the status of a file that doesn't exist if {@param result} is NULL.
+ */
+void statcache_convert(struct stat * result, FileStatus * out);
+
+
+/**
+ * Find the cached status of {@param path} in {@param cache}, and place it into {@param out}.
+ *
+ * @return whether the status of {@param path} was found
+ */
+bool statcache_lookup(StatCache * cache, char * path, FileStatus * out);
+
+
+/**
+ * Remember that {@param status} is the status of {@param path} in {@param cache}.
+ */
+BakeError statcache_store(StatCache * cache, char * path, FileStatus status);
+
+
+/**
+ * Find the cached hash of the contents of {@param path} in {@param cache}, and place it into {@param out}.
+ *
+ * @return whether the hash of {@param path} was found
+ */
+bool statcache_lookupHash(StatCache * cache, char * path, uint64_t * out);
+
+
+/**
+ * Remember that {@param hash} is the hash of the contents of {@param path} in {@param cache}, as long as its
+ * status is still cached. The hash is forgotten along with the status of {@param path}.
+ */
+void statcache_storeHash(StatCache * cache, char * path, uint64_t hash);
+
+
+/**
+ * Forget the status of {@param path} in {@param cache}, so that it is found again the next time it is needed.
+ */
+void statcache_invalidate(StatCache * cache, char * path);
+
+
+#endif //CITS2002_STATCACHE_H
@@ -0,0 +1,483 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+// O_CLOEXEC, strndup and fsync are POSIX, and glibc only declares them under -std=c99 when a feature-test macro is defined
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "state.h"
+#include "fingerprints.h"
+#include "files.h"
+#include "hash.h"
+
+
+BakeError state_open(BuildState * out, Bakefile * bakefile, char * path, bool writable, bool fingerprints) {
+    out->fd = -1;
+    out->recordCount = 0;
+    out->damaged = false;
+    out->fingerprints = fingerprints;
+
+    BakeError err = strbuilder_allocate(&out->record, 256);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0 && errno != ENOENT) {
+        reportError("Unable to open state file %s: %s\n", path, strerror(errno));
+        strbuilder_free(&out->record);
+        return BAKE_ERROR_IO;
+    }
+
+    // If no targets have been recorded yet, there is nothing to load
+    if(fd >= 0) {
+        struct stat status;
+        if(fstat(fd, &status) != 0) {
+            reportError("Unable to find size of state file %s: %s\n", path, strerror(errno));
+            close(fd);
+            strbuilder_free(&out->record);
+            return BAKE_ERROR_IO;
+        }
+
+        // Map the whole file into memory to read it, rather than copying it through a buffer
+        size_t length = (size_t) status.st_size;
+        if(length > 0) {
+            char * data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(data == MAP_FAILED) {
+                reportError("Unable to map state file %s: %s\n", path, strerror(errno));
+                close(fd);
+                strbuilder_free(&out->record);
+                return BAKE_ERROR_IO;
+            }
+
+            err = state_load(out, bakefile, data, length);
+            munmap(data, length);
+        }
+
+        close(fd);
+
+        if(err != BAKE_SUCCESS) {
+            strbuilder_free(&out->record);
+            return err;
+        }
+    }
+
+    if(!writable)
+        return BAKE_SUCCESS;
+
+    // Records that were cut short by a build being killed are removed, so that new records aren't appended to them
+    if(out->damaged) {
+        err = state_compact(out, bakefile, path);
+        if(err != BAKE_SUCCESS) {
+            strbuilder_free(&out->record);
+            return err;
+        }
+    }
+
+    out->fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if(out->fd < 0) {
+        reportError("Unable to open state file %s to record targets: %s\n", path, strerror(errno));
+        strbuilder_free(&out->record);
+        return BAKE_ERROR_IO;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError state_load(BuildState * state, Bakefile * bakefile, char * data, size_t length) {
+    char * position = data;
+    char * end = data + length;
+
+    while(position < end) {
+        // Each record starts with the line of its target
+        if(end - position >= 2 && strncmp(position, "T\t", 2) == 0) {
+            BakeError err = state_loadRecord(state, bakefile, position, end, &position);
+            if(err != BAKE_SUCCESS)
+                return err;
+
+            continue;
+        }
+
+        // Anything else is left over from a record that was cut short, and is skipped
+        state->damaged = true;
+
+        char * lineEnd = memchr(position, '\n', (size_t) (end - position));
+        position = (lineEnd == NULL ? end : lineEnd + 1);
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError state_loadRecord(BuildState * state, Bakefile * bakefile, char * start, char * end, char ** next) {
+    // Find the line holding the checksum, which is the last line of the record
+    char * line = start;
+    char * checksumLine = NULL;
+
+    while(line < end) {
+        char * lineEnd = memchr(line, '\n', (size_t) (end - line));
+        if(lineEnd == NULL) {
+            line = end;
+            break;
+        }
+
+        if(line != start && strncmp(line, "T\t", 2) == 0)
+            break;
+
+        if(strncmp(line, "E\t", 2) == 0) {
+            checksumLine = line;
+            line = lineEnd + 1;
+            break;
+        }
+
+        line = lineEnd + 1;
+    }
+
+    *next = line;
+
+    // Records without a checksum, or whose checksum doesn't match, were cut short while they were written
+    Hasher hasher;
+    hash_start(&hasher);
+
+    char * checksumEnd = NULL;
+    uint64_t checksum = 0;
+    if(checksumLine != NULL) {
+        hash_update(&hasher, start, (size_t) (checksumLine - start));
+        checksum = strtoull(&checksumLine[2], &checksumEnd, 16);
+    }
+
+    if(checksumLine == NULL || *checksumEnd != '\n' || checksum != hash_finish(&hasher)) {
+        state->damaged = true;
+        return BAKE_SUCCESS;
+    }
+
+    state->recordCount += 1;
+
+    // Copy the name of the target, so that it can be looked up
+    char * lineEnd = memchr(start, '\n', (size_t) (checksumLine - start));
+    char * name = start;
+    for(int field = 0; field < 5 && name != NULL; ++field) {
+        name = memchr(name, '\t', (size_t) (lineEnd - name));
+        name = (name == NULL ? NULL : name + 1);
+    }
+
+    if(name == NULL)
+        return BAKE_SUCCESS;
+
+    strbuilder_reset(&state->record);
+    BakeError err = strbuilder_appendSubstring(&state->record, name, (size_t) (lineEnd - name));
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Records of targets that are no longer in the bakefile are ignored, and dropped when the file is compacted
+    Target * target = bakefile_getTarget(bakefile, strbuilder_get(&state->record));
+    if(target == NULL)
+        return BAKE_SUCCESS;
+
+    // The latest record of each target replaces any before it
+    bool succeeded;
+    target_clearFingerprints(&target->recordedFingerprints);
+    target->fingerprintsRecorded = false;
+
+    if(!state_parseTarget(start, lineEnd, target, &succeeded) || !succeeded)
+        return BAKE_SUCCESS;
+
+    for(line = lineEnd + 1; line < checksumLine; line = lineEnd + 1) {
+        lineEnd = memchr(line, '\n', (size_t) (checksumLine - line));
+
+        Fingerprint fingerprint;
+        if(!fingerprints_parse(line, lineEnd, &fingerprint)) {
+            // Leave the target without a record, so that it is executed again
+            target_clearFingerprints(&target->recordedFingerprints);
+            return BAKE_SUCCESS;
+        }
+
+        fingerprint.path = strndup(fingerprint.path, (size_t) (lineEnd - fingerprint.path));
+        if(fingerprint.path == NULL) {
+            reportError("Unable to allocate memory for fingerprint: %s\n", strerror(errno));
+            return BAKE_ERROR_MEMORY;
+        }
+
+        err = target_addRecordedFingerprint(target, fingerprint);
+        if(err != BAKE_SUCCESS) {
+            free(fingerprint.path);
+            return err;
+        }
+    }
+
+    target->fingerprintsRecorded = true;
+    return BAKE_SUCCESS;
+}
+
+
+bool state_parseTarget(char * line, char * lineEnd, Target * target, bool * succeeded) {
+    // Each number is followed by a tab, which stops it from being read past the end of the line
+    char * end;
+    errno = 0;
+    FileTime time = strtoll(&line[2], &end, 10);
+    if(*end != '\t' || end >= lineEnd)
+        return false;
+
+    char * outcome = end + 1;
+    if(lineEnd - outcome > 8 && strncmp(outcome, "success\t", 8) == 0) {
+        *succeeded = true;
+        end = outcome + 7;
+    } else if(lineEnd - outcome > 7 && strncmp(outcome, "failed\t", 7) == 0) {
+        *succeeded = false;
+        end = outcome + 6;
+    } else {
+        return false;
+    }
+
+    uint64_t commandHash = strtoull(end + 1, &end, 16);
+    if(*end != '\t' || end + 2 >= lineEnd || (end[1] != '0' && end[1] != '1') || end[2] != '\t' || errno != 0)
+        return false;
+
+    target->recordedTime = time;
+    target->recordedCommandHash = commandHash;
+    target->recordedFile = (end[1] == '1');
+    return true;
+}
+
+
+BakeError state_record(BuildState * state, StatCache * cache, Target * target) {
+    if(state->fd < 0)
+        return BAKE_SUCCESS;
+
+    bool succeeded;
+    if(target->state == TARGET_EXECUTED || (target->state == TARGET_SKIPPED && state_isStale(state, target))) {
+        // Find whether the commands of the target created its file
+        FileStatus status;
+        BakeError err = getFileStatus(cache, target->name, &status);
+        if(err != BAKE_SUCCESS)
+            return err;
+
+        target->recordedCommandHash = state_commandHash(target);
+        target->recordedFile = status.exists;
+        target_recordFingerprints(target);
+        succeeded = true;
+    } else if(target->state == TARGET_FAILED && target->lane != 0) {
+        // Targets that weren't started because a target they depend on failed keep their record
+        target_clearFingerprints(&target->recordedFingerprints);
+        target->fingerprintsRecorded = false;
+        succeeded = false;
+    } else {
+        return BAKE_SUCCESS;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    target->recordedTime = fileTimeFromTimespec(now);
+
+    BakeError err = state_formatRecord(&state->record, target, succeeded);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Each record is written at once, so that it is only cut short if bake is killed during the write
+    err = state_write(state->fd, strbuilder_get(&state->record), state->record.buffer.used);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    state->recordCount += 1;
+    return BAKE_SUCCESS;
+}
+
+
+bool state_isStale(BuildState * state, Target * target) {
+    if(!target->fingerprintsRecorded || target->recordedFile != (target->modificationTime != -1))
+        return true;
+
+    if(!state->fingerprints)
+        return false;
+
+    size_t count = target_currentFingerprintCount(target);
+    if(count != target_recordedFingerprintCount(target))
+        return true;
+
+    Fingerprint * current = target_getCurrentFingerprints(target);
+    Fingerprint * recorded = target_getRecordedFingerprints(target);
+
+    for(size_t index = 0; index < count; ++index) {
+        if(current[index].hash != recorded[index].hash
+           || current[index].modificationTime != recorded[index].modificationTime
+           || current[index].size != recorded[index].size
+           || current[index].inode != recorded[index].inode
+           || strcmp(current[index].path, recorded[index].path) != 0)
+            return true;
+    }
+
+    return false;
+}
+
+
+BakeError state_formatRecord(StringBuilder * builder, Target * target, bool succeeded) {
+    strbuilder_reset(builder);
+
+    BakeError err = strbuilder_appendFormat(builder, "T\t%" PRId64 "\t%s\t%016" PRIx64 "\t%d\t%s\n",
+                                            target->recordedTime, (succeeded ? "success" : "failed"),
+                                            target->recordedCommandHash, (target->recordedFile ? 1 : 0),
+                                            target->name);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    if(succeeded) {
+        size_t count = target_recordedFingerprintCount(target);
+        Fingerprint * fingerprints = target_getRecordedFingerprints(target);
+
+        for(size_t index = 0; index < count; ++index) {
+            err = fingerprints_format(builder, &fingerprints[index]);
+            if(err != BAKE_SUCCESS)
+                return err;
+        }
+    }
+
+    // End the record with a checksum of everything before it, so that records that were cut short can be found
+    Hasher hasher;
+    hash_start(&hasher);
+    hash_update(&hasher, strbuilder_get(builder), builder->buffer.used);
+
+    return strbuilder_appendFormat(builder, "E\t%016" PRIx64 "\n", hash_finish(&hasher));
+}
+
+
+BakeError state_write(int fd, char * data, size_t length) {
+    while(length > 0) {
+        ssize_t written = write(fd, data, length);
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+
+            reportError("Unable to write to state file: %s\n", strerror(errno));
+            return BAKE_ERROR_IO;
+        }
+
+        data += written;
+        length -= (size_t) written;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+BakeError state_compact(BuildState * state, Bakefile * bakefile, char * path) {
+    // Write the records to a temporary file first, and then move it over the old state
+    StringBuilder tempPath;
+    BakeError err = strbuilder_allocate(&tempPath, 64);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    err = strbuilder_appendFormat(&tempPath, "%s.tmp", path);
+    if(err != BAKE_SUCCESS) {
+        strbuilder_free(&tempPath);
+        return err;
+    }
+
+    int fd = open(strbuilder_get(&tempPath), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) {
+        reportError("Unable to create state file %s: %s\n", strbuilder_get(&tempPath), strerror(errno));
+        strbuilder_free(&tempPath);
+        return BAKE_ERROR_IO;
+    }
+
+    size_t recordCount = 0;
+    size_t targetCount = strmap_size(&bakefile->targets);
+    StringMapEntry * entries = strmap_entries(&bakefile->targets);
+
+    for(size_t index = 0; index < targetCount && err == BAKE_SUCCESS; ++index) {
+        Target * target = entries[index].value;
+        if(!target->fingerprintsRecorded)
+            continue;
+
+        err = state_formatRecord(&state->record, target, true);
+        if(err == BAKE_SUCCESS) {
+            err = state_write(fd, strbuilder_get(&state->record), state->record.buffer.used);
+            recordCount += 1;
+        }
+    }
+
+    // Make sure the records are on disk before they replace the old ones
+    if(err == BAKE_SUCCESS && fsync(fd) != 0) {
+        reportError("Unable to write state file %s: %s\n", strbuilder_get(&tempPath), strerror(errno));
+        err = BAKE_ERROR_IO;
+    }
+
+    close(fd);
+
+    if(err == BAKE_SUCCESS && rename(strbuilder_get(&tempPath), path) != 0) {
+        reportError("Unable to replace state file %s: %s\n", path, strerror(errno));
+        err = BAKE_ERROR_IO;
+    }
+
+    if(err != BAKE_SUCCESS) {
+        remove(strbuilder_get(&tempPath));
+    } else {
+        state->recordCount = recordCount;
+        state->damaged = false;
+    }
+
+    strbuilder_free(&tempPath);
+    return err;
+}
+
+
+BakeError state_close(BuildState * state, Bakefile * bakefile, char * path) {
+    BakeError err = BAKE_SUCCESS;
+
+    if(state->fd >= 0) {
+        close(state->fd);
+        state->fd = -1;
+
+        // Count the targets that have a record, which are all that will be kept
+        size_t recordedCount = 0;
+        size_t targetCount = strmap_size(&bakefile->targets);
+        StringMapEntry * entries = strmap_entries(&bakefile->targets);
+
+        for(size_t index = 0; index < targetCount; ++index) {
+            Target * target = entries[index].value;
+            if(target->fingerprintsRecorded) {
+                recordedCount += 1;
+            }
+        }
+
+        // Rewrite the file once most of its records have been replaced
+        if(state->recordCount > STATE_COMPACTION_RATIO * recordedCount) {
+            err = state_compact(state, bakefile, path);
+        }
+    }
+
+    strbuilder_free(&state->record);
+    return err;
+}
+
+
+uint64_t state_commandHash(Target * target) {
+    Hasher hasher;
+    hash_start(&hasher);
+
+    // Executing the commands as one script may behave differently to executing them separately
+    char oneShell = (target->oneShell ? '1' : '0');
+    hash_update(&hasher, &oneShell, 1);
+
+    size_t actionLineCount = target_actionLineCount(target);
+    ActionLine * actionLines = target_getActionLines(target);
+
+    for(size_t index = 0; index < actionLineCount; ++index) {
+        // Include the terminating '\0', so that commands can't run together
+        hash_update(&hasher, actionLines[index].command, strlen(actionLines[index].command) + 1);
+    }
+
+    return hash_finish(&hasher);
+}
@@ -0,0 +1,165 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === state ===
+//
+// Records the outcome of each target in a small database that is kept between builds, so
+// that bake can tell which targets are still up to date. Each record holds the time a target
+// finished, whether it succeeded, a hash of its commands, whether it had a file, and, with
+// --freshness=hash, the fingerprints of its inputs.
+//
+// A record is appended to the file as soon as each target finishes, so that a build that is
+// killed keeps the records of the targets that finished, and the next build doesn't execute
+// them again. Each record ends with a checksum, and records that were only partly written
+// are ignored. The last record of a target replaces any before it, and once most of the
+// records in the file have been replaced, it is compacted by rewriting it with only the
+// latest record of each target.
+//
+// The file is memory-mapped to be read. Each record starts with a line holding "T", the time
+// in nanoseconds, "success" or "failed", the hash of the commands in hexadecimal, 1 or 0 for
+// whether the target had a file, and the name of the target, separated by tabs. This is
+// followed by a line for each input, as described in fingerprints, and then "E", a tab, and
+// the hash of all the lines of the record before it.
+//
+
+#ifndef CITS2002_STATE_H
+#define CITS2002_STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "errors.h"
+#include "targets.h"
+#include "statcache.h"
+#include "stringbuilder.h"
+
+
+/**
+ * The file, relative to the directory bake is run in, that the state of targets is recorded in.
+ */
+#define STATE_FILE  ".bake_state"
+
+
+/**
+ * The file is compacted once it holds more than this many records for each target that has one.
+ */
+#define STATE_COMPACTION_RATIO  2
+
+
+/**
+ * The database that the outcome of each target is recorded in.
+ */
+typedef struct {
+    /**
+     * The file descriptor that records are appended to, or -1 if records are not being written.
+     */
+    int fd;
+
+    /**
+     * The number of records in the file, including those that have been replaced.
+     */
+    size_t recordCount;
+
+    /**
+     * Whether the file holds a record that was only partly written, which must be removed before records are appended.
+     */
+    bool damaged;
+
+    /**
+     * Whether the fingerprints of the inputs of targets are taken in this build. If not, targets that are
+     * skipped keep the fingerprints recorded for them, as there is nothing to compare them against.
+     */
+    bool fingerprints;
+
+    /**
+     * Used to hold each record before it is written.
+     */
+    StringBuilder record;
+} BuildState;
+
+
+/**
+ * Read the records in the state file {@param path} into the targets of {@param bakefile}, and place the
+ * BuildState into {@param out}. If {@param writable}, the outcome of targets is appended to the file as
+ * they finish. {@param fingerprints} should be whether the fingerprints of inputs are taken in this build.
+ * It is not an error for the file to not exist, or for it to mention targets that are no longer in
+ * {@param bakefile}.
+ */
+BakeError state_open(BuildState * out, Bakefile * bakefile, char * path, bool writable, bool fingerprints);
+
+
+/**
+ * Read the records in the {@param length} bytes {@param data} of a state file into the targets of {@param bakefile}.
+ */
+BakeError state_load(BuildState * state, Bakefile * bakefile, char * data, size_t length);
+
+
+/**
+ * Read the record that starts at {@param start}, and ends before {@param end}, into its target in {@param bakefile},
+ * and place the start of the record after it into {@param next}. Records that were only partly written are skipped.
+ */
+BakeError state_loadRecord(BuildState * state, Bakefile * bakefile, char * start, char * end, char ** next);
+
+
+/**
+ * Read the first line {@param line} of a record, which ends at {@param lineEnd}, into {@param target},
+ * placing whether the target succeeded into {@param succeeded}.
+ *
+ * @return whether the line was well formed
+ */
+bool state_parseTarget(char * line, char * lineEnd, Target * target, bool * succeeded);
+
+
+/**
+ * Append the outcome of the finished target {@param target} to {@param state}. Targets that were executed
+ * record the fingerprints of their inputs in this build, while targets that were skipped only do if they
+ * differ from those recorded. Targets that failed while executing are recorded as failed, and lose their
+ * fingerprints, so that they are executed again. Whether the target created its file is found using {@param cache}.
+ */
+BakeError state_record(BuildState * state, StatCache * cache, Target * target);
+
+
+/**
+ * @return whether the inputs, commands or file of {@param target} in this build differ from those recorded for it
+ *         in {@param state}. Inputs are only compared if their fingerprints are taken in this build.
+ */
+bool state_isStale(BuildState * state, Target * target);
+
+
+/**
+ * Place the record of {@param target} into {@param builder}, holding its recorded fingerprints if
+ * {@param succeeded}, or marking that it failed otherwise.
+ */
+BakeError state_formatRecord(StringBuilder * builder, Target * target, bool succeeded);
+
+
+/**
+ * Write {@param length} bytes of {@param data} to the file descriptor {@param fd}, writing again after partial writes.
+ */
+BakeError state_write(int fd, char * data, size_t length);
+
+
+/**
+ * Replace the state file {@param path} with one that holds only the latest record of each target of {@param bakefile}.
+ * The file is replaced atomically, so that it is never left half written.
+ */
+BakeError state_compact(BuildState * state, Bakefile * bakefile, char * path);
+
+
+/**
+ * Stop appending to the state file {@param path}, compact it if most of its records have been replaced,
+ * and free the resources of {@param state}.
+ */
+BakeError state_close(BuildState * state, Bakefile * bakefile, char * path);
+
+
+/**
+ * @return the hash of the commands of {@param target}, which changes when they are edited
+ */
+uint64_t state_commandHash(Target * target);
+
+
+#endif //CITS2002_STATE_H
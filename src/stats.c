@@ -0,0 +1,113 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "stats.h"
+
+
+bool statsEnabled = false;
+
+
+/**
+ * The value of each counter.
+ */
+static size_t counters[STAT_COUNTER_COUNT];
+
+
+/**
+ * The number of seconds spent in each phase.
+ */
+static double phaseTimes[STAT_PHASE_COUNT];
+
+
+/**
+ * The name printed for each counter.
+ */
+static const char * counterNames[STAT_COUNTER_COUNT] = {
+    "bytes parsed",
+    "lines parsed",
+    "strmap_get calls",
+    "strmap_get key comparisons",
+    "stat calls",
+    "stat cache lookups",
+    "stat cache hits",
+    "files hashed",
+    "bytes hashed",
+    "URL requests",
+    "processes started",
+    "buffer reallocations"
+};
+
+
+/**
+ * The name printed for each phase.
+ */
+static const char * phaseNames[STAT_PHASE_COUNT] = {
+    "parse",
+    "resolve graph",
+    "check freshness",
+    "execute"
+};
+
+
+void stats_enable(void) {
+    statsEnabled = true;
+}
+
+
+void stats_add(StatCounter counter, size_t amount) {
+    // The freshness of targets is checked by many threads at once
+    __sync_fetch_and_add(&counters[counter], amount);
+}
+
+
+void stats_addTime(StatPhase phase, double seconds) {
+    if(statsEnabled) {
+        phaseTimes[phase] += seconds;
+    }
+}
+
+
+void stats_print(FILE * file) {
+    fprintf(file, "\nBake statistics:\n");
+
+    for(size_t index = 0; index < STAT_PHASE_COUNT; ++index) {
+        fprintf(file, "  %-28s %12.6fs\n", phaseNames[index], phaseTimes[index]);
+    }
+
+    for(size_t index = 0; index < STAT_COUNTER_COUNT; ++index) {
+        fprintf(file, "  %-28s %12lu\n", counterNames[index], (unsigned long) counters[index]);
+    }
+
+    // Find how often files were found in the stat cache
+    size_t lookups = counters[STAT_STAT_CACHE_LOOKUPS];
+    if(lookups > 0) {
+        fprintf(file, "  %-28s %11.1f%%\n", "stat cache hit rate",
+                100.0 * (double) counters[STAT_STAT_CACHE_HITS] / (double) lookups);
+    }
+
+    // Find the most memory bake has used at once
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+        long peakRSS = usage.ru_maxrss;
+
+#ifdef __APPLE__
+        // macOS reports the resident set size in bytes, rather than kilobytes
+        peakRSS /= 1024;
+#endif
+
+        fprintf(file, "  %-28s %10.1fMB\n", "peak RSS", (double) peakRSS / 1024);
+    }
+
+    fflush(file);
+}
+
+
+void stats_printAtExit(void) {
+    if(statsEnabled) {
+        stats_print(stdout);
+    }
+}
@@ -0,0 +1,170 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === stats ===
+//
+// Counts how much work bake does itself, such as how many files it stats and how many times
+// it searches a StringMap, and times each phase of a build, to be printed once bake exits.
+//
+// Counting is off unless stats_enable is called. While it is off, each counter that would have
+// been counted only costs a check of statsEnabled.
+//
+
+#ifndef CITS2002_STATS_H
+#define CITS2002_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+
+/**
+ * The things that are counted.
+ */
+typedef enum {
+    /**
+     * The bytes read from the bakefile.
+     */
+    STAT_BYTES_PARSED,
+
+    /**
+     * The lines read from the bakefile.
+     */
+    STAT_LINES_PARSED,
+
+    /**
+     * The calls to strmap_get.
+     */
+    STAT_STRMAP_GETS,
+
+    /**
+     * The keys compared by strmap_get.
+     */
+    STAT_STRMAP_COMPARISONS,
+
+    /**
+     * The calls to stat made to find files and programs.
+     */
+    STAT_FILE_STATS,
+
+    /**
+     * The files whose status was looked for in the stat cache.
+     */
+    STAT_STAT_CACHE_LOOKUPS,
+
+    /**
+     * The files whose status was found in the stat cache, without calling stat.
+     */
+    STAT_STAT_CACHE_HITS,
+
+    /**
+     * The files whose contents were hashed to decide whether they changed.
+     */
+    STAT_FILES_HASHED,
+
+    /**
+     * The bytes read from files to hash their contents.
+     */
+    STAT_BYTES_HASHED,
+
+    /**
+     * The requests made to find the modification time of URLs.
+     */
+    STAT_URL_REQUESTS,
+
+    /**
+     * The processes started.
+     */
+    STAT_PROCESSES,
+
+    /**
+     * The times a Buffer was grown by reallocating its memory.
+     */
+    STAT_BUFFER_GROWTHS,
+
+    /**
+     * The number of counters, which must be last.
+     */
+    STAT_COUNTER_COUNT
+} StatCounter;
+
+
+/**
+ * The phases of a build that are timed.
+ */
+typedef enum {
+    /**
+     * Reading and parsing the bakefile.
+     */
+    STAT_PHASE_PARSE,
+
+    /**
+     * Resolving the graph of targets to be executed.
+     */
+    STAT_PHASE_PREPARE,
+
+    /**
+     * Checking which targets are out of date.
+     */
+    STAT_PHASE_FRESHNESS,
+
+    /**
+     * Executing the targets that are out of date.
+     */
+    STAT_PHASE_EXECUTE,
+
+    /**
+     * The number of phases, which must be last.
+     */
+    STAT_PHASE_COUNT
+} StatPhase;
+
+
+/**
+ * Whether counters are being counted. Only to be set through stats_enable.
+ */
+extern bool statsEnabled;
+
+
+/**
+ * Add {@param amount} to the counter {@param counter}, if counters are being counted.
+ */
+#define countStat(counter, amount)  do { if(statsEnabled) stats_add((counter), (amount)); } while(0)
+
+
+/**
+ * Start counting counters and timing phases.
+ */
+void stats_enable(void);
+
+
+/**
+ * Add {@param amount} to the counter {@param counter}. May be called from any thread.
+ */
+void stats_add(StatCounter counter, size_t amount);
+
+
+/**
+ * Add {@param seconds} to the time spent in the phase {@param phase}, if phases are being timed.
+ */
+void stats_addTime(StatPhase phase, double seconds);
+
+
+/**
+ * Print the time spent in each phase, each of the counters, the hit rate of the stat cache,
+ * and the peak resident set size of bake to {@param file}.
+ */
+void stats_print(FILE * file);
+
+
+/**
+ * Print the stats to stdout, if they are being counted. Registered with atexit when they are enabled.
+ */
+void stats_printAtExit(void);
+
+
+#endif //CITS2002_STATS_H
@@ -131,7 +131,9 @@ BakeError strbuilder_appendFormat(StringBuilder * builder, const char * format,
             return err;
         }
 
-        // Try formatting the string again
+        // Try formatting the string again, restarting the arguments as the first attempt consumed them
+        va_end(arguments);
+        va_start(arguments, format);
         available = strbuilder_available(builder);
         length = vsnprintf(strbuilder_head(builder), available + 1, format, arguments);
 
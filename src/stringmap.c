@@ -4,6 +4,7 @@
  */
 
 #include "stringmap.h"
+#include "stats.h"
 
 
 BakeError strmap_allocate(StringMap * out, size_t capacity) {
@@ -90,6 +91,7 @@ BakeError strmap_put(StringMap * map, char * key, void * value) {
 void * strmap_get(StringMap * map, char * key) {
     size_t size = strmap_size(map);
     StringMapEntry * entries = strmap_entries(map);
+    countStat(STAT_STRMAP_GETS, 1);
 
     // Loop through all entries looking for an entry with a matching key
     for(size_t index = 0; index < size; ++index) {
@@ -100,9 +102,11 @@ void * strmap_get(StringMap * map, char * key) {
             continue;
 
         // We found the matching entry!
+        countStat(STAT_STRMAP_COMPARISONS, index + 1);
         return entry.value;
     }
 
     // We found no matching entries
+    countStat(STAT_STRMAP_COMPARISONS, size);
     return NULL;
 }
@@ -0,0 +1,114 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+ */
+
+#include "targetqueue.h"
+
+
+BakeError tqueue_allocate(TargetQueue * out, size_t capacity) {
+    // Allocate a buffer to hold the heap of targets
+    return buf_allocate(&out->heap, capacity * sizeof(Target *));
+}
+
+
+void tqueue_free(TargetQueue * queue) {
+    // Free the heap buffer, but not the targets within it
+    buf_free(&queue->heap);
+}
+
+
+size_t tqueue_size(TargetQueue * queue) {
+    // The amount of Target *'s that could fit in the used memory
+    return queue->heap.used / sizeof(Target *);
+}
+
+
+bool tqueue_isBefore(Target * first, Target * second) {
+    // Start targets that lead to a target listed by .PRIORITY first
+    if(first->prioritised != second->prioritised)
+        return first->prioritised;
+
+    // Then start the targets with the longest chain of targets after them, so that it isn't left until last
+    if(first->criticalPath != second->criticalPath)
+        return first->criticalPath > second->criticalPath;
+
+    // Otherwise, start targets in the same order as a serial walk of the dependency graph would
+    return first->order < second->order;
+}
+
+
+BakeError tqueue_push(TargetQueue * queue, Target * target) {
+    // Append the target to the end of the heap
+    BakeError err = buf_append(&queue->heap, &target, sizeof(Target *));
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    Target ** heap = buf_get(&queue->heap);
+
+    // Move the target up the heap until its parent should be started before it
+    size_t index = tqueue_size(queue) - 1;
+    while(index > 0) {
+        size_t parent = (index - 1) / 2;
+
+        // If the parent should be started first, the heap is in order
+        if(!tqueue_isBefore(heap[index], heap[parent]))
+            break;
+
+        // Otherwise, swap the target with its parent
+        Target * swap = heap[parent];
+        heap[parent] = heap[index];
+        heap[index] = swap;
+
+        index = parent;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+Target * tqueue_pop(TargetQueue * queue) {
+    size_t size = tqueue_size(queue);
+    Target ** heap = buf_get(&queue->heap);
+
+    // If the queue is empty, there is nothing to remove
+    if(size == 0)
+        return NULL;
+
+    // The root of the heap is the target that should be started first
+    Target * first = heap[0];
+
+    // Move the last target in the heap to its root
+    size -= 1;
+    heap[0] = heap[size];
+    queue->heap.used -= sizeof(Target *);
+
+    // Move the new root down the heap until both its children should be started after it
+    size_t index = 0;
+    while(true) {
+        size_t left = 2 * index + 1;
+        size_t right = left + 1;
+        size_t earliest = index;
+
+        // Find which of the target and its children should be started first
+        if(left < size && tqueue_isBefore(heap[left], heap[earliest])) {
+            earliest = left;
+        }
+        if(right < size && tqueue_isBefore(heap[right], heap[earliest])) {
+            earliest = right;
+        }
+
+        // If the target should be started before its children, the heap is in order
+        if(earliest == index)
+            break;
+
+        // Otherwise, swap the target with the child that should be started first
+        Target * swap = heap[earliest];
+        heap[earliest] = heap[index];
+        heap[index] = swap;
+
+        index = earliest;
+    }
+
+    return first;
+}
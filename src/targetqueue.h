@@ -0,0 +1,72 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === targetqueue ===
+//
+// A priority queue of targets that are ready to be executed,
+// ordered by the order in which they should be started.
+//
+
+#ifndef CITS2002_TARGETQUEUE_H
+#define CITS2002_TARGETQUEUE_H
+
+#include "buffer.h"
+#include "targets.h"
+
+
+/**
+ * A binary heap of Target *'s, with the target that should be started first at its root.
+ */
+typedef struct {
+    /**
+     * A buffer containing the heap array of Target *'s.
+     */
+    Buffer heap;
+} TargetQueue;
+
+
+/**
+ * Allocate a TargetQueue with the initial capacity of {@param capacity} targets, and place it in {@param out}.
+ */
+BakeError tqueue_allocate(TargetQueue * out, size_t capacity);
+
+
+/**
+ * Free the resources of {@param queue} and mark it as invalid.
+ *
+ * The targets within the queue will not be free'd.
+ */
+void tqueue_free(TargetQueue * queue);
+
+
+/**
+ * @return the number of targets in {@param queue}
+ */
+size_t tqueue_size(TargetQueue * queue);
+
+
+/**
+ * @return whether the target {@param first} should be started before the target {@param second}
+ */
+bool tqueue_isBefore(Target * first, Target * second);
+
+
+/**
+ * Add the target {@param target} to {@param queue}.
+ */
+BakeError tqueue_push(TargetQueue * queue, Target * target);
+
+
+/**
+ * Remove the target that should be started first from {@param queue}.
+ *
+ * @return the removed target, or NULL if {@param queue} is empty
+ */
+Target * tqueue_pop(TargetQueue * queue);
+
+
+#endif //CITS2002_TARGETQUEUE_H
@@ -3,12 +3,33 @@
    Student number(s):	22494652
  */
 
+#include <stdlib.h>
 #include "targets.h"
 
 
 BakeError target_allocate(char * name, Target * out) {
     out->name = name;
     out->state = TARGET_NOT_EXECUTED;
+    out->pendingDependencies = 0;
+    out->order = 0;
+    out->priorityHint = false;
+    out->prioritised = false;
+    out->expectedDuration = -1;
+    out->criticalPath = 0;
+    out->startTime = 0;
+    out->lane = 0;
+    out->duration = -1;
+    out->modificationTime = -1;
+    out->dependenciesUpdated = false;
+    out->fingerprintsRecorded = false;
+    out->recordedCommandHash = 0;
+    out->recordedFile = false;
+    out->recordedTime = -1;
+    out->freshnessChecked = false;
+    out->oneShell = false;
+    out->cpus = 1;
+    out->timeout = 0;
+    out->holdsResources = false;
 
     // Allocate a buffer to hold all the dependencies of the target
     BakeError err = buf_allocate(&out->dependencies, 4 * sizeof(char *));
@@ -22,6 +43,55 @@ BakeError target_allocate(char * name, Target * out) {
         return err;
     }
 
+    // Allocate a buffer to hold the targets that the dependencies resolve to
+    err = buf_allocate(&out->dependencyTargets, 4 * sizeof(Target *));
+    if(err != BAKE_SUCCESS) {
+        buf_free(&out->dependencies);
+        buf_free(&out->actionLines);
+        return err;
+    }
+
+    // Allocate a buffer to hold the targets that depend on this target
+    err = buf_allocate(&out->dependents, 4 * sizeof(Target *));
+    if(err != BAKE_SUCCESS) {
+        buf_free(&out->dependencies);
+        buf_free(&out->actionLines);
+        buf_free(&out->dependencyTargets);
+        return err;
+    }
+
+    // Allocate a buffer to hold the tokens that the target takes from pools
+    err = buf_allocate(&out->poolCosts, sizeof(PoolCost));
+    if(err != BAKE_SUCCESS) {
+        buf_free(&out->dependencies);
+        buf_free(&out->actionLines);
+        buf_free(&out->dependencyTargets);
+        buf_free(&out->dependents);
+        return err;
+    }
+
+    // Allocate buffers to hold the fingerprints of the inputs of the target
+    err = buf_allocate(&out->recordedFingerprints, sizeof(Fingerprint));
+    if(err != BAKE_SUCCESS) {
+        buf_free(&out->dependencies);
+        buf_free(&out->actionLines);
+        buf_free(&out->dependencyTargets);
+        buf_free(&out->dependents);
+        buf_free(&out->poolCosts);
+        return err;
+    }
+
+    err = buf_allocate(&out->currentFingerprints, sizeof(Fingerprint));
+    if(err != BAKE_SUCCESS) {
+        buf_free(&out->dependencies);
+        buf_free(&out->actionLines);
+        buf_free(&out->dependencyTargets);
+        buf_free(&out->dependents);
+        buf_free(&out->poolCosts);
+        buf_free(&out->recordedFingerprints);
+        return err;
+    }
+
     return BAKE_SUCCESS;
 }
 
@@ -29,6 +99,11 @@ BakeError target_allocate(char * name, Target * out) {
 void target_free(Target * target) {
     buf_free(&target->dependencies);
     buf_free(&target->actionLines);
+    buf_free(&target->dependencyTargets);
+    buf_free(&target->dependents);
+    buf_free(&target->poolCosts);
+    target_freeFingerprints(&target->recordedFingerprints);
+    target_freeFingerprints(&target->currentFingerprints);
 }
 
 
@@ -68,11 +143,137 @@ BakeError target_addActionLine(Target * target, ActionLine actionLine) {
 }
 
 
+Target ** target_getDependencyTargets(Target * target) {
+    // Return the dependencyTargets array, which contains an array of Target *'s
+    return buf_get(&target->dependencyTargets);
+}
+
+
+BakeError target_addDependencyTarget(Target * target, Target * dependency) {
+    // Append the dependency pointer to the dependencyTargets array
+    return buf_append(&target->dependencyTargets, &dependency, sizeof(Target *));
+}
+
+
+Target ** target_getDependents(Target * target) {
+    // Return the dependents array, which contains an array of Target *'s
+    return buf_get(&target->dependents);
+}
+
+
+size_t target_dependentCount(Target * target) {
+    // Return the number of Target *'s that are in the used data of the dependents buffer
+    return target->dependents.used / sizeof(Target *);
+}
+
+
+BakeError target_addDependent(Target * target, Target * dependent) {
+    // Append the dependent pointer to the dependents array
+    return buf_append(&target->dependents, &dependent, sizeof(Target *));
+}
+
+
+PoolCost * target_getPoolCosts(Target * target) {
+    // Return the poolCosts array, which contains an array of PoolCost's
+    return buf_get(&target->poolCosts);
+}
+
+
+size_t target_poolCostCount(Target * target) {
+    // Return the number of PoolCost's that are in the used data of the poolCosts buffer
+    return target->poolCosts.used / sizeof(PoolCost);
+}
+
+
+BakeError target_addPoolCost(Target * target, JobPool * pool, size_t cost) {
+    // Append the cost to the poolCosts array
+    PoolCost poolCost = {pool, cost};
+    return buf_append(&target->poolCosts, &poolCost, sizeof(PoolCost));
+}
+
+
+Fingerprint * target_getRecordedFingerprints(Target * target) {
+    // Return the recordedFingerprints array, which contains an array of Fingerprint's
+    return buf_get(&target->recordedFingerprints);
+}
+
+
+size_t target_recordedFingerprintCount(Target * target) {
+    // Return the number of Fingerprint's that are in the used data of the recordedFingerprints buffer
+    return target->recordedFingerprints.used / sizeof(Fingerprint);
+}
+
+
+BakeError target_addRecordedFingerprint(Target * target, Fingerprint fingerprint) {
+    // Append the fingerprint to the recordedFingerprints array
+    return buf_append(&target->recordedFingerprints, &fingerprint, sizeof(Fingerprint));
+}
+
+
+Fingerprint * target_getCurrentFingerprints(Target * target) {
+    // Return the currentFingerprints array, which contains an array of Fingerprint's
+    return buf_get(&target->currentFingerprints);
+}
+
+
+size_t target_currentFingerprintCount(Target * target) {
+    // Return the number of Fingerprint's that are in the used data of the currentFingerprints buffer
+    return target->currentFingerprints.used / sizeof(Fingerprint);
+}
+
+
+BakeError target_addCurrentFingerprint(Target * target, Fingerprint fingerprint) {
+    // Append the fingerprint to the currentFingerprints array
+    return buf_append(&target->currentFingerprints, &fingerprint, sizeof(Fingerprint));
+}
+
+
+void target_recordFingerprints(Target * target) {
+    // Swap the buffers, so that the buffer of the old fingerprints can be reused
+    Buffer recorded = target->recordedFingerprints;
+    target->recordedFingerprints = target->currentFingerprints;
+    target->currentFingerprints = recorded;
+    target->fingerprintsRecorded = true;
+
+    target_clearFingerprints(&target->currentFingerprints);
+}
+
+
+void target_clearFingerprints(Buffer * fingerprints) {
+    size_t count = fingerprints->used / sizeof(Fingerprint);
+    Fingerprint * entries = buf_get(fingerprints);
+
+    for(size_t index = 0; index < count; ++index) {
+        free(entries[index].path);
+    }
+
+    fingerprints->used = 0;
+}
+
+
+void target_freeFingerprints(Buffer * fingerprints) {
+    target_clearFingerprints(fingerprints);
+    buf_free(fingerprints);
+}
+
+
 BakeError bakefile_allocate(Bakefile * out) {
     out->firstTarget = NULL;
+    out->shell = NULL;
 
     // Allocate a new StringMap for storing targets
-    return strmap_allocate(&out->targets, 4);
+    BakeError err = strmap_allocate(&out->targets, 4);
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    // Allocate a new StringMap for storing pools
+    err = strmap_allocate(&out->pools, 4);
+    if(err != BAKE_SUCCESS) {
+        strmap_free(&out->targets);
+        return err;
+    }
+
+    return BAKE_SUCCESS;
 }
 
 
@@ -94,6 +295,20 @@ void bakefile_free(Bakefile * bakefile) {
 
     // Free the targets map itself
     strmap_free(&bakefile->targets);
+
+    // Free the resources of each pool, and then the pools map
+    size_t poolCount = strmap_size(&bakefile->pools);
+    StringMapEntry * poolEntries = strmap_entries(&bakefile->pools);
+
+    for(size_t index = 0; index < poolCount; ++index) {
+        jobpool_free(poolEntries[index].value);
+    }
+
+    strmap_free(&bakefile->pools);
+
+    // Free the shell
+    free(bakefile->shell);
+    bakefile->shell = NULL;
 }
 
 
@@ -111,11 +326,28 @@ BakeError bakefile_addTarget(Bakefile * bakefile, char * identifier, Target * ta
         return BAKE_ERROR_ARGUMENTS;
     }
 
-    // If this is the first target added to bakefile, set its firstTarget property
-    if(strmap_size(&bakefile->targets) == 0) {
+    // If this is the first target added to bakefile, set its firstTarget property.
+    // Targets starting with a '.' are special targets, which can't be the first target.
+    if(bakefile->firstTarget == NULL && identifier[0] != '.') {
         bakefile->firstTarget = target;
     }
 
     // Add this new target to the targets map
     return strmap_put(&bakefile->targets, identifier, target);
 }
+
+
+JobPool * bakefile_getPool(Bakefile * bakefile, char * name) {
+    return strmap_get(&bakefile->pools, name);
+}
+
+
+BakeError bakefile_addPool(Bakefile * bakefile, char * name, JobPool * pool) {
+    // Make sure there isn't already a pool with the same name
+    if(bakefile_getPool(bakefile, name) != NULL) {
+        reportError("Cannot have multiple pools with the same name %s\n", name);
+        return BAKE_ERROR_PARSING;
+    }
+
+    return strmap_put(&bakefile->pools, name, pool);
+}
@@ -14,8 +14,13 @@
 #ifndef CITS2002_TARGETS_H
 #define CITS2002_TARGETS_H
 
+#include <time.h>
+#include <stdint.h>
+#include <sys/types.h>
 #include "buffer.h"
 #include "stringmap.h"
+#include "jobpool.h"
+#include "filetime.h"
 
 
 /**
@@ -32,13 +37,61 @@ typedef struct {
      */
     bool requireSuccess;
 
+    /**
+     * Whether this action line may execute at the same time as the action lines after it. The next
+     * action line that isn't concurrent waits for all the concurrent action lines before it to finish.
+     */
+    bool concurrent;
+
+    /**
+     * Whether this action line failed when it was executed concurrently, in a way that fails its target.
+     */
+    bool failed;
+
     /**
      * The command associated with this action line.
      */
      char * command;
+
+    /**
+     * A NULL terminated array of the arguments of command, if it is simple enough to be executed
+     * directly without a shell. Otherwise NULL, and command will be executed by the shell.
+     */
+     char ** arguments;
 } ActionLine;
 
 
+/**
+ * What an input of a target contained when its freshness was last decided.
+ */
+typedef struct {
+    /**
+     * The path of the input, which is owned by the fingerprint.
+     */
+    char * path;
+
+    /**
+     * The hash of the contents of the input, or 0 if it doesn't exist.
+     */
+    uint64_t hash;
+
+    /**
+     * The modification time of the input, or -1 if it doesn't exist.
+     */
+    FileTime modificationTime;
+
+    /**
+     * The size of the input in bytes.
+     */
+    off_t size;
+
+    /**
+     * The inode of the input.
+     */
+    ino_t inode;
+} Fingerprint;
+
+
 /**
  * Used to mark whether a target has not been executed, is being executed, or has been executed.
  */
@@ -48,6 +101,16 @@ typedef enum {
      */
     TARGET_NOT_EXECUTED,
 
+    /**
+     * The dependencies of the target are currently being prepared for execution.
+     */
+    TARGET_PREPARING,
+
+    /**
+     * The target has been prepared, and is waiting for its target dependencies to finish.
+     */
+    TARGET_PENDING,
+
     /**
      * The target is currently being executed.
      */
@@ -61,7 +124,12 @@ typedef enum {
     /**
      * The target was skipped.
      */
-    TARGET_SKIPPED
+    TARGET_SKIPPED,
+
+    /**
+     * The target failed to execute, or was not executed because a target it depends on failed.
+     */
+    TARGET_FAILED
 } TargetState;
 
 
@@ -84,6 +152,144 @@ typedef struct {
      */
      Buffer actionLines;
 
+    /**
+     * A buffer containing a list of Target *'s, holding the target that each entry of
+     * dependencies refers to, or NULL if that dependency is a file or URL.
+     *
+     * This is filled in when the target is prepared for execution.
+     */
+    Buffer dependencyTargets;
+
+    /**
+     * A buffer containing a list of Target *'s that depend on this target.
+     *
+     * This is filled in when the targets are prepared for execution.
+     */
+    Buffer dependents;
+
+    /**
+     * The number of target dependencies of this target that have not yet finished executing.
+     */
+    size_t pendingDependencies;
+
+    /**
+     * The order in which this target would have been executed by a serial walk of the dependency
+     * graph. Targets that are ready to execute at the same time are executed in this order.
+     */
+    size_t order;
+
+    /**
+     * Whether this target was listed by .PRIORITY, to be started before targets that weren't.
+     */
+    bool priorityHint;
+
+    /**
+     * Whether this target, or any target that depends on it, was listed by .PRIORITY.
+     */
+    bool prioritised;
+
+    /**
+     * The number of seconds this target took to execute the last time it was executed,
+     * as recorded in the history file, or -1 if it is unknown.
+     */
+    double expectedDuration;
+
+    /**
+     * The expected number of seconds it will take to execute this target and then the longest
+     * chain of targets that depend on it. Ready targets with the longest path are started first.
+     */
+    double criticalPath;
+
+    /**
+     * The monotonic time in seconds that this target started executing.
+     */
+    double startTime;
+
+    /**
+     * The job slot this target was executed in, numbered from 1, which is its lane in a trace.
+     */
+    size_t lane;
+
+    /**
+     * The number of seconds it took to execute this target, or -1 if it has not been executed.
+     */
+    double duration;
+
+    /**
+     * The modification time of the file associated with this target, or -1 if it does not exist.
+     */
+    FileTime modificationTime;
+
+    /**
+     * Whether any of the dependencies of this target have been updated, meaning it should be executed.
+     */
+    bool dependenciesUpdated;
+
+    /**
+     * A buffer containing a list of the Fingerprint's of the inputs of this target,
+     * as they were recorded the last time this target was executed.
+     */
+    Buffer recordedFingerprints;
+
+    /**
+     * Whether fingerprints were recorded for this target, in which case it is only executed
+     * if the contents of its inputs changed, rather than if they were modified more recently.
+     */
+    bool fingerprintsRecorded;
+
+    /**
+     * The hash of the commands of this target when its fingerprints were recorded.
+     */
+    uint64_t recordedCommandHash;
+
+    /**
+     * Whether the file of this target existed when its fingerprints were recorded. Targets
+     * that didn't create a file are not executed just because their file doesn't exist.
+     */
+    bool recordedFile;
+
+    /**
+     * The time at which this target finished when its fingerprints were recorded.
+     */
+    FileTime recordedTime;
+
+    /**
+     * A buffer containing a list of the Fingerprint's of the inputs of this target as they are in this
+     * build, in the order of its dependencies, with the files of its target dependencies last.
+     */
+    Buffer currentFingerprints;
+
+    /**
+     * Whether a task has been submitted to check the modification times of this target and its dependencies.
+     */
+    bool freshnessChecked;
+
+    /**
+     * Whether all the action lines of this target should be executed as one script in a single shell.
+     */
+    bool oneShell;
+
+    /**
+     * A buffer containing a list of the PoolCost's of the tokens this target takes from pools while it executes.
+     */
+    Buffer poolCosts;
+
+    /**
+     * The number of job slots this target takes while it executes, out of the number of jobs that may execute at once.
+     */
+    size_t cpus;
+
+    /**
+     * The number of seconds each command of this target may execute for before it is stopped,
+     * or 0 to use the timeout given on the command-line.
+     */
+    double timeout;
+
+    /**
+     * Whether this target currently holds its job slots and pool tokens.
+     */
+    bool holdsResources;
+
     /**
      * The execution state of this target.
      */
@@ -106,6 +312,16 @@ typedef struct {
      * A map containing each Target that is parsed.
      */
     StringMap targets;
+
+    /**
+     * A map containing each JobPool that is declared, by name.
+     */
+    StringMap pools;
+
+    /**
+     * The shell used to execute commands, from the SHELL variable of the bakefile.
+     */
+    char * shell;
 } Bakefile;
 
 
@@ -159,6 +375,111 @@ size_t target_actionLineCount(Target * target);
 BakeError target_addActionLine(Target * target, ActionLine actionLine);
 
 
+/**
+ * @return a pointer to the array of resolved dependency targets of {@param target},
+ *         with one entry for each dependency, or NULL for file and URL dependencies
+ */
+Target ** target_getDependencyTargets(Target * target);
+
+
+/**
+ * Add the resolved dependency target {@param dependency} to {@param target}.
+ */
+BakeError target_addDependencyTarget(Target * target, Target * dependency);
+
+
+/**
+ * @return a pointer to the array of targets that depend on {@param target}
+ */
+Target ** target_getDependents(Target * target);
+
+
+/**
+ * @return the number of targets that depend on {@param target}
+ */
+size_t target_dependentCount(Target * target);
+
+
+/**
+ * Add the target {@param dependent} as depending on {@param target}.
+ */
+BakeError target_addDependent(Target * target, Target * dependent);
+
+
+/**
+ * @return a pointer to the array of PoolCost's of {@param target}
+ */
+PoolCost * target_getPoolCosts(Target * target);
+
+
+/**
+ * @return the number of pools that {@param target} takes tokens from
+ */
+size_t target_poolCostCount(Target * target);
+
+
+/**
+ * Add that {@param target} takes {@param cost} tokens from {@param pool} while it executes.
+ */
+BakeError target_addPoolCost(Target * target, JobPool * pool, size_t cost);
+
+
+/**
+ * @return a pointer to the array of Fingerprint's recorded for {@param target}
+ */
+Fingerprint * target_getRecordedFingerprints(Target * target);
+
+
+/**
+ * @return the number of Fingerprint's recorded for {@param target}
+ */
+size_t target_recordedFingerprintCount(Target * target);
+
+
+/**
+ * Add {@param fingerprint} to the fingerprints recorded for {@param target}, which takes ownership of its path.
+ */
+BakeError target_addRecordedFingerprint(Target * target, Fingerprint fingerprint);
+
+
+/**
+ * @return a pointer to the array of Fingerprint's of the inputs of {@param target} in this build
+ */
+Fingerprint * target_getCurrentFingerprints(Target * target);
+
+
+/**
+ * @return the number of Fingerprint's of the inputs of {@param target} in this build
+ */
+size_t target_currentFingerprintCount(Target * target);
+
+
+/**
+ * Add {@param fingerprint} to the fingerprints of the inputs of {@param target} in
+ * this build, and {@param target} takes ownership of its path.
+ */
+BakeError target_addCurrentFingerprint(Target * target, Fingerprint fingerprint);
+
+
+/**
+ * Make the fingerprints of the inputs of {@param target} in this build its recorded
+ * fingerprints, discarding those previously recorded.
+ */
+void target_recordFingerprints(Target * target);
+
+
+/**
+ * Free the paths of the Fingerprint's in the buffer {@param fingerprints}, and empty it.
+ */
+void target_clearFingerprints(Buffer * fingerprints);
+
+
+/**
+ * Free the paths of the Fingerprint's in the buffer {@param fingerprints}, and then the buffer itself.
+ */
+void target_freeFingerprints(Buffer * fingerprints);
+
+
 /**
  * Allocate a new Bakefile for use in parsing a bakefile, and place it in {@param out}.
  */
@@ -177,9 +498,25 @@ void bakefile_free(Bakefile * bakefile);
 Target * bakefile_getTarget(Bakefile * bakefile, char * identifier);
 
 
+/**
+ * @return the pool in {@param bakefile} with the name {@param name}, or NULL if there is none
+ */
+JobPool * bakefile_getPool(Bakefile * bakefile, char * name);
+
+
+/**
+ * Add the pool {@param pool} to {@param bakefile} with the name {@param name}.
+ *
+ * {@param name} and {@param pool} will be free'd when {@param bakefile} is free'd.
+ */
+BakeError bakefile_addPool(Bakefile * bakefile, char * name, JobPool * pool);
+
+
 /**
  * Add the Target {@param target} identified by {@param identifier} to {@param bakefile}.
  *
+ * Targets whose names start with a '.' are never used as the default first target.
+ *
  * {@param target} must have a unique name.
  * {@param identifier} must not ever change after this call.
  *
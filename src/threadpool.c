@@ -0,0 +1,235 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+ */
+
+#include "threadpool.h"
+
+
+BakeError pool_allocate(ThreadPool * out, size_t workerCount, void * context) {
+    out->workerCount = 0;
+    out->queuedTasks = 0;
+    out->unfinishedTasks = 0;
+    out->stopping = false;
+    out->error = BAKE_SUCCESS;
+    out->context = context;
+
+    // Allocate space for all of the workers
+    out->workers = malloc(workerCount * sizeof(Worker));
+    if(out->workers == NULL) {
+        reportError("Unable to allocate space for worker threads: %s\n", strerror(errno));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    pthread_mutex_init(&out->lock, NULL);
+    pthread_cond_init(&out->changed, NULL);
+
+    // Start each of the workers
+    for(size_t index = 0; index < workerCount; ++index) {
+        Worker * worker = &out->workers[index];
+        worker->pool = out;
+        worker->firstTask = 0;
+
+        // Allocate a buffer to hold the tasks queued on this worker
+        BakeError err = buf_allocate(&worker->tasks, 16 * sizeof(Task));
+        if(err != BAKE_SUCCESS) {
+            pool_free(out);
+            return err;
+        }
+
+        pthread_mutex_init(&worker->lock, NULL);
+
+        // Start the worker's thread
+        int threadErr = pthread_create(&worker->thread, NULL, pool_runWorker, worker);
+        if(threadErr != 0) {
+            reportError("Unable to start worker thread: %s\n", strerror(threadErr));
+            pthread_mutex_destroy(&worker->lock);
+            buf_free(&worker->tasks);
+            pool_free(out);
+            return BAKE_ERROR_UNKNOWN;
+        }
+
+        out->workerCount += 1;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+void pool_free(ThreadPool * pool) {
+    // Tell all the workers to stop
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Wait for each worker to stop, and free its resources
+    for(size_t index = 0; index < pool->workerCount; ++index) {
+        Worker * worker = &pool->workers[index];
+
+        pthread_join(worker->thread, NULL);
+        pthread_mutex_destroy(&worker->lock);
+        buf_free(&worker->tasks);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->changed);
+
+    // Free the workers array, and mark the pool as invalid
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->workerCount = 0;
+}
+
+
+BakeError pool_submit(ThreadPool * pool, Worker * worker, TaskFunction function, void * argument) {
+    // If no worker was given, queue the task on the first worker
+    if(worker == NULL) {
+        worker = &pool->workers[0];
+    }
+
+    Task task;
+    task.function = function;
+    task.argument = argument;
+
+    // The pool lock is held while queueing the task, so that it
+    // is counted before any other worker is able to take it
+    pthread_mutex_lock(&pool->lock);
+
+    // Add the task to the end of the worker's queue
+    pthread_mutex_lock(&worker->lock);
+    BakeError err = buf_append(&worker->tasks, &task, sizeof(Task));
+    pthread_mutex_unlock(&worker->lock);
+
+    if(err != BAKE_SUCCESS) {
+        pthread_mutex_unlock(&pool->lock);
+        return err;
+    }
+
+    // Count the new task, and wake up any idle workers to execute it
+    pool->queuedTasks += 1;
+    pool->unfinishedTasks += 1;
+    pthread_cond_broadcast(&pool->changed);
+
+    pthread_mutex_unlock(&pool->lock);
+    return BAKE_SUCCESS;
+}
+
+
+bool pool_claim(ThreadPool * pool, bool * flag) {
+    pthread_mutex_lock(&pool->lock);
+
+    // Set the flag, remembering whether it was already set
+    bool claimed = !*flag;
+    *flag = true;
+
+    pthread_mutex_unlock(&pool->lock);
+    return claimed;
+}
+
+
+BakeError pool_wait(ThreadPool * pool) {
+    pthread_mutex_lock(&pool->lock);
+
+    // Wait until all the tasks have completed
+    while(pool->unfinishedTasks > 0) {
+        pthread_cond_wait(&pool->changed, &pool->lock);
+    }
+
+    // Get the error of the tasks, and reset it for the next tasks to be submitted
+    BakeError err = pool->error;
+    pool->error = BAKE_SUCCESS;
+
+    pthread_mutex_unlock(&pool->lock);
+    return err;
+}
+
+
+bool pool_takeTask(Worker * worker, Task * out) {
+    ThreadPool * pool = worker->pool;
+
+    // Look through this worker's queue first, followed by the queues of the other workers
+    for(size_t offset = 0; offset < pool->workerCount; ++offset) {
+        Worker * victim = &pool->workers[(worker - pool->workers + offset) % pool->workerCount];
+
+        pthread_mutex_lock(&victim->lock);
+
+        size_t taskCount = victim->tasks.used / sizeof(Task);
+        Task * tasks = buf_get(&victim->tasks);
+
+        // Move on to the next worker if this one has no tasks
+        if(victim->firstTask == taskCount) {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+
+        if(victim == worker) {
+            // Take the most recently queued task from our own queue
+            *out = tasks[taskCount - 1];
+            victim->tasks.used -= sizeof(Task);
+        } else {
+            // Steal the oldest task from the other worker's queue
+            *out = tasks[victim->firstTask];
+            victim->firstTask += 1;
+        }
+
+        // If the queue is now empty, start it again from the start of its buffer
+        if(victim->firstTask * sizeof(Task) == victim->tasks.used) {
+            victim->firstTask = 0;
+            buf_reset(&victim->tasks);
+        }
+
+        pthread_mutex_unlock(&victim->lock);
+
+        // Mark that the task has been taken
+        pthread_mutex_lock(&pool->lock);
+        pool->queuedTasks -= 1;
+        pthread_mutex_unlock(&pool->lock);
+
+        return true;
+    }
+
+    return false;
+}
+
+
+void * pool_runWorker(void * argument) {
+    Worker * worker = argument;
+    ThreadPool * pool = worker->pool;
+
+    while(true) {
+        // Try find a task to execute
+        Task task;
+        if(pool_takeTask(worker, &task)) {
+            BakeError err = task.function(worker, task.argument);
+
+            pthread_mutex_lock(&pool->lock);
+
+            // Remember the first error that occurs
+            if(err != BAKE_SUCCESS && pool->error == BAKE_SUCCESS) {
+                pool->error = err;
+            }
+
+            // Mark the task as completed, and if it was the last task wake up anyone waiting on the pool
+            pool->unfinishedTasks -= 1;
+            if(pool->unfinishedTasks == 0) {
+                pthread_cond_broadcast(&pool->changed);
+            }
+
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        // If there were no tasks, wait until there are more tasks queued
+        pthread_mutex_lock(&pool->lock);
+        while(pool->queuedTasks == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+
+        bool stopping = pool->stopping;
+        pthread_mutex_unlock(&pool->lock);
+
+        if(stopping)
+            return NULL;
+    }
+}
@@ -0,0 +1,184 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === threadpool ===
+//
+// A pool of worker threads that execute tasks in parallel. Each worker keeps its own queue
+// of tasks, and workers that run out of tasks steal them from the queues of other workers.
+//
+
+#ifndef CITS2002_THREADPOOL_H
+#define CITS2002_THREADPOOL_H
+
+#include <pthread.h>
+#include "buffer.h"
+
+
+/**
+ * A pool of worker threads, defined below.
+ */
+typedef struct ThreadPool ThreadPool;
+
+
+/**
+ * A thread within a ThreadPool, with its own queue of tasks.
+ */
+typedef struct {
+    /**
+     * The pool this worker belongs to.
+     */
+    ThreadPool * pool;
+
+    /**
+     * The thread running this worker.
+     */
+    pthread_t thread;
+
+    /**
+     * Guards the tasks of this worker, as they may be stolen by other workers.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * A buffer containing a list of Task's queued on this worker. The worker takes tasks
+     * from the end of the list, and other workers steal tasks from the start of the list.
+     */
+    Buffer tasks;
+
+    /**
+     * The index of the first task in tasks that has not been taken.
+     */
+    size_t firstTask;
+} Worker;
+
+
+/**
+ * A function executed by a worker as a task, passed the worker executing it and its argument.
+ */
+typedef BakeError (* TaskFunction)(Worker * worker, void * argument);
+
+
+/**
+ * A task queued to be executed by a worker.
+ */
+typedef struct {
+    /**
+     * The function to be executed.
+     */
+    TaskFunction function;
+
+    /**
+     * The argument to be passed to function.
+     */
+    void * argument;
+} Task;
+
+
+struct ThreadPool {
+    /**
+     * An array of the workers of this pool.
+     */
+    Worker * workers;
+
+    /**
+     * The number of workers in workers.
+     */
+    size_t workerCount;
+
+    /**
+     * Guards the counts and flags below.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Signalled when tasks are queued, when all tasks are complete, or when the pool is stopping.
+     */
+    pthread_cond_t changed;
+
+    /**
+     * The number of tasks queued on workers that have not been taken.
+     */
+    size_t queuedTasks;
+
+    /**
+     * The number of tasks that have been submitted, but have not completed.
+     */
+    size_t unfinishedTasks;
+
+    /**
+     * Whether the workers should exit.
+     */
+    bool stopping;
+
+    /**
+     * The first error returned by a task, or BAKE_SUCCESS.
+     */
+    BakeError error;
+
+    /**
+     * Shared by all the tasks of this pool, which may read it through the pool of the worker executing them.
+     */
+    void * context;
+};
+
+
+/**
+ * Allocate a ThreadPool with {@param workerCount} workers, start its worker threads, and place it in {@param out}.
+ * The tasks of the pool may read {@param context} from its context.
+ */
+BakeError pool_allocate(ThreadPool * out, size_t workerCount, void * context);
+
+
+/**
+ * Stop the workers of {@param pool}, free its resources and mark it as invalid.
+ *
+ * All submitted tasks should be waited for using pool_wait before calling this.
+ */
+void pool_free(ThreadPool * pool);
+
+
+/**
+ * Submit a task to execute {@param function} with {@param argument} in {@param pool}.
+ *
+ * If {@param worker} is not NULL, the task is queued on that worker, which should be the worker
+ * executing the calling task. Otherwise, the task is queued on the first worker of {@param pool}.
+ */
+BakeError pool_submit(ThreadPool * pool, Worker * worker, TaskFunction function, void * argument);
+
+
+/**
+ * Mark {@param flag} as claimed in {@param pool}, so that only one task acts on it.
+ *
+ * @return whether {@param flag} was unclaimed before this call
+ */
+bool pool_claim(ThreadPool * pool, bool * flag);
+
+
+/**
+ * Wait for all the tasks submitted to {@param pool}, and any tasks they submit, to complete.
+ *
+ * @return the first error returned by a task, or BAKE_SUCCESS if they all succeeded
+ */
+BakeError pool_wait(ThreadPool * pool);
+
+
+/**
+ * Take a task to execute from the end of the queue of {@param worker}, or if it has none, steal one
+ * from the start of the queue of another worker. The task is placed into {@param out}.
+ *
+ * @return whether a task was found
+ */
+bool pool_takeTask(Worker * worker, Task * out);
+
+
+/**
+ * The function run by each worker thread, which executes tasks until the pool is stopped.
+ */
+void * pool_runWorker(void * worker);
+
+
+#endif //CITS2002_THREADPOOL_H
@@ -0,0 +1,198 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "trace.h"
+#include "buffer.h"
+#include "load.h"
+#include "usage.h"
+
+
+/**
+ * The file the trace is being written to, or NULL if no trace is being written.
+ */
+static FILE * traceFile = NULL;
+
+
+/**
+ * The path of the file the trace is being written to.
+ */
+static char * tracePath = NULL;
+
+
+/**
+ * The monotonicTime that the times in the trace are measured from.
+ */
+static double traceStart = 0;
+
+
+/**
+ * Whether any events have been written to the trace, after which each event must be preceded by a comma.
+ */
+static bool wroteEvent = false;
+
+
+/**
+ * A buffer containing a list of the lanes that have been given a name in the trace.
+ */
+static Buffer namedLanes;
+
+
+/**
+ * Guards the writing of events to traceFile, and namedLanes.
+ */
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Holds the lane of each thread that has set one, plus one so that 0 means it hasn't been set.
+ */
+static pthread_key_t laneKey;
+
+
+void startEvent(void) {
+    fputs(wroteEvent ? ",\n" : "\n", traceFile);
+    wroteEvent = true;
+}
+
+
+void nameLane(size_t lane) {
+    size_t laneCount = namedLanes.used / sizeof(size_t);
+    size_t * lanes = buf_get(&namedLanes);
+    for(size_t index = 0; index < laneCount; ++index) {
+        if(lanes[index] == lane)
+            return;
+    }
+
+    if(buf_append(&namedLanes, &lane, sizeof(size_t)) != BAKE_SUCCESS)
+        return;
+
+    char name[64];
+    if(lane == TRACE_MAIN_LANE) {
+        snprintf(name, sizeof(name), "bake");
+    } else if(lane < TRACE_WORKER_LANE) {
+        snprintf(name, sizeof(name), "job slot %lu", (unsigned long) lane);
+    } else {
+        snprintf(name, sizeof(name), "freshness worker %lu", (unsigned long) (lane - TRACE_WORKER_LANE + 1));
+    }
+
+    startEvent();
+    fprintf(traceFile, "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %lu, \"args\": {\"name\": ",
+            (unsigned long) lane);
+    writeJSONString(traceFile, name);
+    fputs("}}", traceFile);
+
+    // Keep the lanes in order in the timeline
+    startEvent();
+    fprintf(traceFile, "{\"ph\": \"M\", \"name\": \"thread_sort_index\", \"pid\": 1, \"tid\": %lu, "
+                       "\"args\": {\"sort_index\": %lu}}", (unsigned long) lane, (unsigned long) lane);
+}
+
+
+BakeError trace_start(char * path) {
+    BakeError err = buf_allocate(&namedLanes, 16 * sizeof(size_t));
+    if(err != BAKE_SUCCESS)
+        return err;
+
+    int keyErr = pthread_key_create(&laneKey, NULL);
+    if(keyErr != 0) {
+        reportError("Unable to create key to hold trace lanes: %s\n", strerror(keyErr));
+        buf_free(&namedLanes);
+        return BAKE_ERROR_UNKNOWN;
+    }
+
+    traceFile = fopen(path, "w");
+    if(traceFile == NULL) {
+        reportError("Unable to open trace file %s: %s\n", path, strerror(errno));
+        pthread_key_delete(laneKey);
+        buf_free(&namedLanes);
+        return BAKE_ERROR_IO;
+    }
+
+    tracePath = path;
+    traceStart = monotonicTime();
+    wroteEvent = false;
+
+    fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [", traceFile);
+
+    startEvent();
+    fputs("{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": 1, \"args\": {\"name\": \"bake\"}}", traceFile);
+    return BAKE_SUCCESS;
+}
+
+
+void trace_finish(void) {
+    if(traceFile == NULL)
+        return;
+
+    pthread_mutex_lock(&traceLock);
+
+    fputs("\n]}\n", traceFile);
+    bool failed = (ferror(traceFile) != 0);
+    if(fclose(traceFile) != 0 || failed) {
+        reportError("Unable to write trace file %s: %s\n", tracePath, strerror(errno));
+    }
+
+    traceFile = NULL;
+    buf_free(&namedLanes);
+    pthread_key_delete(laneKey);
+
+    pthread_mutex_unlock(&traceLock);
+}
+
+
+bool trace_enabled(void) {
+    return traceFile != NULL;
+}
+
+
+void trace_setLane(size_t lane) {
+    if(traceFile != NULL) {
+        pthread_setspecific(laneKey, (void *) (uintptr_t) (lane + 1));
+    }
+}
+
+
+size_t trace_currentLane(void) {
+    if(traceFile == NULL)
+        return TRACE_MAIN_LANE;
+
+    uintptr_t lane = (uintptr_t) pthread_getspecific(laneKey);
+    return (lane == 0 ? TRACE_MAIN_LANE : (size_t) lane - 1);
+}
+
+
+void trace_span(size_t lane, char * category, char * name, char * detail, double start, double end) {
+    if(traceFile == NULL)
+        return;
+
+    pthread_mutex_lock(&traceLock);
+
+    if(traceFile != NULL) {
+        nameLane(lane);
+
+        startEvent();
+        fprintf(traceFile, "{\"ph\": \"X\", \"pid\": 1, \"tid\": %lu, \"ts\": %.3f, \"dur\": %.3f, \"cat\": ",
+                (unsigned long) lane, (start - traceStart) * 1e6, (end - start) * 1e6);
+        writeJSONString(traceFile, category);
+        fputs(", \"name\": ", traceFile);
+        writeJSONString(traceFile, name);
+
+        if(detail != NULL) {
+            fputs(", \"args\": {\"detail\": ", traceFile);
+            writeJSONString(traceFile, detail);
+            fputc('}', traceFile);
+        }
+
+        fputc('}', traceFile);
+    }
+
+    pthread_mutex_unlock(&traceLock);
+}
@@ -0,0 +1,88 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === trace ===
+//
+// Writes a timeline of everything bake does to a file in the Trace Event Format, which can be
+// opened in Perfetto or chrome://tracing. Each span is placed on the lane of the thread or job
+// slot that did the work, so that idle job slots and slow phases of the build stand out.
+//
+// Spans are written as soon as they end, so a trace is only written while trace_start has
+// been called and trace_finish has not. All the functions may be called from any thread.
+//
+
+#ifndef CITS2002_TRACE_H
+#define CITS2002_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "errors.h"
+
+
+/**
+ * The lane of the main thread of bake.
+ */
+#define TRACE_MAIN_LANE  0
+
+
+/**
+ * The lane of the first worker used to check the freshness of targets. Job slots take the lanes before it.
+ */
+#define TRACE_WORKER_LANE  1000
+
+
+/**
+ * Start writing a trace to the file {@param path}, with times measured from now.
+ */
+BakeError trace_start(char * path);
+
+
+/**
+ * Finish writing the trace, if one is being written, and close its file.
+ */
+void trace_finish(void);
+
+
+/**
+ * @return whether a trace is being written
+ */
+bool trace_enabled(void);
+
+
+/**
+ * Set the lane that the spans of the calling thread are placed on to {@param lane}.
+ */
+void trace_setLane(size_t lane);
+
+
+/**
+ * @return the lane that the spans of the calling thread are placed on, which is TRACE_MAIN_LANE unless it was set
+ */
+size_t trace_currentLane(void);
+
+
+/**
+ * Write a span of the category {@param category} named {@param name} to the trace, on the lane {@param lane},
+ * from the monotonicTime {@param start} to {@param end}. If {@param detail} is not NULL, it is shown as the
+ * detail of the span.
+ */
+void trace_span(size_t lane, char * category, char * name, char * detail, double start, double end);
+
+
+/**
+ * Write the separator before the next event in the trace. The caller must hold the lock of the trace.
+ */
+void startEvent(void);
+
+
+/**
+ * Name the lane {@param lane} in the trace, if it has not been named already. The caller must hold the lock of the trace.
+ */
+void nameLane(size_t lane);
+
+
+#endif //CITS2002_TRACE_H
@@ -0,0 +1,185 @@
+/* CITS2002 Project 2018
+   Name(s):		Padraig Lamont
+   Student number(s):	22494652
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "usage.h"
+
+
+BakeError usage_allocate(UsageReport * out) {
+    return buf_allocate(&out->commands, 16 * sizeof(CommandUsage));
+}
+
+
+void usage_free(UsageReport * report) {
+    buf_free(&report->commands);
+}
+
+
+size_t usage_commandCount(UsageReport * report) {
+    return report->commands.used / sizeof(CommandUsage);
+}
+
+
+CommandUsage * usage_getCommands(UsageReport * report) {
+    return buf_get(&report->commands);
+}
+
+
+BakeError usage_record(UsageReport * report, char * target, char * command, int exitStatus,
+                       double elapsed, struct rusage * resources) {
+    CommandUsage usage;
+    usage.target = target;
+    usage.command = command;
+    usage.exitStatus = exitStatus;
+    usage.elapsed = elapsed;
+    usage.userTime = usage_seconds(resources->ru_utime);
+    usage.systemTime = usage_seconds(resources->ru_stime);
+    usage.maxRSS = resources->ru_maxrss;
+    usage.inBlocks = resources->ru_inblock;
+    usage.outBlocks = resources->ru_oublock;
+    usage.voluntarySwitches = resources->ru_nvcsw;
+    usage.involuntarySwitches = resources->ru_nivcsw;
+
+#ifdef __APPLE__
+    // macOS reports the resident set size in bytes, rather than kilobytes
+    usage.maxRSS /= 1024;
+#endif
+
+    return buf_append(&report->commands, &usage, sizeof(CommandUsage));
+}
+
+
+double usage_seconds(struct timeval time) {
+    return (double) time.tv_sec + (double) time.tv_usec / 1e6;
+}
+
+
+int compareCPUTime(const void * first, const void * second) {
+    CommandUsage * a = *(CommandUsage **) first;
+    CommandUsage * b = *(CommandUsage **) second;
+
+    double aTime = a->userTime + a->systemTime;
+    double bTime = b->userTime + b->systemTime;
+    return (aTime < bTime) - (aTime > bTime);
+}
+
+
+BakeError usage_print(UsageReport * report, FILE * file, size_t count) {
+    size_t commandCount = usage_commandCount(report);
+    CommandUsage * commands = usage_getCommands(report);
+    if(commandCount == 0)
+        return BAKE_SUCCESS;
+
+    // Sort the commands by their CPU time, leaving the report in the order they completed
+    CommandUsage ** sorted = malloc(commandCount * sizeof(CommandUsage *));
+    if(sorted == NULL) {
+        reportError("Unable to allocate space to sort the resources used by commands: %s\n", strerror(errno));
+        return BAKE_ERROR_MEMORY;
+    }
+
+    double totalUser = 0;
+    double totalSystem = 0;
+    for(size_t index = 0; index < commandCount; ++index) {
+        sorted[index] = &commands[index];
+        totalUser += commands[index].userTime;
+        totalSystem += commands[index].systemTime;
+    }
+
+    qsort(sorted, commandCount, sizeof(CommandUsage *), compareCPUTime);
+
+    if(count > commandCount) {
+        count = commandCount;
+    }
+
+    fprintf(file, "\nCommands that used the most CPU time (%lu of %lu):\n",
+            (unsigned long) count, (unsigned long) commandCount);
+    fprintf(file, "%9s %9s %9s %9s %10s %9s %9s %9s %9s  %s\n", "cpu", "user", "system", "elapsed",
+            "max rss", "blk in", "blk out", "vol cs", "invol cs", "target: command");
+
+    for(size_t index = 0; index < count; ++index) {
+        CommandUsage * usage = sorted[index];
+
+        fprintf(file, "%8.2fs %8.2fs %8.2fs %8.2fs %7.1fMB %9ld %9ld %9ld %9ld  %s: %s\n",
+                usage->userTime + usage->systemTime, usage->userTime, usage->systemTime, usage->elapsed,
+                (double) usage->maxRSS / 1024, usage->inBlocks, usage->outBlocks,
+                usage->voluntarySwitches, usage->involuntarySwitches,
+                usage->target, (usage->command != NULL ? usage->command : "(all action lines)"));
+    }
+
+    fprintf(file, "%8.2fs %8.2fs %8.2fs in total\n", totalUser + totalSystem, totalUser, totalSystem);
+    fflush(file);
+
+    free(sorted);
+    return BAKE_SUCCESS;
+}
+
+
+BakeError usage_writeJSON(UsageReport * report, char * path) {
+    FILE * file = fopen(path, "w");
+    if(file == NULL) {
+        reportError("Unable to open %s to write the resources used by commands: %s\n", path, strerror(errno));
+        return BAKE_ERROR_IO;
+    }
+
+    size_t commandCount = usage_commandCount(report);
+    CommandUsage * commands = usage_getCommands(report);
+
+    fprintf(file, "{\n  \"commands\": [");
+    for(size_t index = 0; index < commandCount; ++index) {
+        CommandUsage * usage = &commands[index];
+
+        fprintf(file, "%s\n    {\"target\": ", (index == 0 ? "" : ","));
+        writeJSONString(file, usage->target);
+        fprintf(file, ", \"command\": ");
+        writeJSONString(file, usage->command);
+        fprintf(file, ", \"exitStatus\": %i, \"elapsed\": %.6f, \"user\": %.6f, \"system\": %.6f, "
+                      "\"maxRSSKB\": %ld, \"inBlocks\": %ld, \"outBlocks\": %ld, "
+                      "\"voluntarySwitches\": %ld, \"involuntarySwitches\": %ld}",
+                usage->exitStatus, usage->elapsed, usage->userTime, usage->systemTime,
+                usage->maxRSS, usage->inBlocks, usage->outBlocks,
+                usage->voluntarySwitches, usage->involuntarySwitches);
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    if(ferror(file)) {
+        reportError("Unable to write the resources used by commands to %s: %s\n", path, strerror(errno));
+        fclose(file);
+        return BAKE_ERROR_IO;
+    }
+
+    if(fclose(file) != 0) {
+        reportError("Unable to write the resources used by commands to %s: %s\n", path, strerror(errno));
+        return BAKE_ERROR_IO;
+    }
+
+    return BAKE_SUCCESS;
+}
+
+
+void writeJSONString(FILE * file, char * string) {
+    if(string == NULL) {
+        fputs("null", file);
+        return;
+    }
+
+    fputc('"', file);
+    for(unsigned char * c = (unsigned char *) string; *c != '\0'; ++c) {
+        if(*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if(*c == '\t') {
+            fputs("\\t", file);
+        } else if(*c == '\n') {
+            fputs("\\n", file);
+        } else if(*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
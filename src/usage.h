@@ -0,0 +1,165 @@
+/* CITS2002 Project 2018
+   Name(s):              Padraig Lamont
+   Student number(s):    22494652
+ */
+
+
+//
+// === usage ===
+//
+// Records the resources used by each command that is executed, as reported by wait4 when the
+// command's process is reaped, so that the commands that use the most can be reported.
+//
+
+#ifndef CITS2002_USAGE_H
+#define CITS2002_USAGE_H
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "errors.h"
+#include "buffer.h"
+
+
+/**
+ * The number of commands listed by --rusage-report when no number is given.
+ */
+#define USAGE_REPORT_DEFAULT_COUNT  10
+
+
+/**
+ * The resources used by one command.
+ */
+typedef struct {
+    /**
+     * The name of the target the command was executed for.
+     */
+    char * target;
+
+    /**
+     * The command, or NULL if all the action lines of the target were executed as one script.
+     */
+    char * command;
+
+    /**
+     * The exit status of the command.
+     */
+    int exitStatus;
+
+    /**
+     * The number of seconds from when the command was started until it was reaped.
+     */
+    double elapsed;
+
+    /**
+     * The number of seconds of CPU time the command spent executing in user mode.
+     */
+    double userTime;
+
+    /**
+     * The number of seconds of CPU time the command spent executing in the kernel.
+     */
+    double systemTime;
+
+    /**
+     * The largest resident set size of the command, or of the largest of its children, in kilobytes.
+     */
+    long maxRSS;
+
+    /**
+     * The number of times the file system had to read from a block device for the command.
+     */
+    long inBlocks;
+
+    /**
+     * The number of times the file system had to write to a block device for the command.
+     */
+    long outBlocks;
+
+    /**
+     * The number of times the command gave up the CPU while it waited for something.
+     */
+    long voluntarySwitches;
+
+    /**
+     * The number of times the command was made to give up the CPU to another process.
+     */
+    long involuntarySwitches;
+} CommandUsage;
+
+
+/**
+ * The resources used by each of the commands that have been executed.
+ */
+typedef struct {
+    /**
+     * A buffer containing a list of the CommandUsage's of the commands, in the order they completed.
+     */
+    Buffer commands;
+} UsageReport;
+
+
+/**
+ * Allocate a new empty UsageReport, and place it into {@param out}.
+ */
+BakeError usage_allocate(UsageReport * out);
+
+
+/**
+ * Free the resources of {@param report}.
+ */
+void usage_free(UsageReport * report);
+
+
+/**
+ * @return the number of commands recorded in {@param report}
+ */
+size_t usage_commandCount(UsageReport * report);
+
+
+/**
+ * @return the CommandUsage's of the commands recorded in {@param report}
+ */
+CommandUsage * usage_getCommands(UsageReport * report);
+
+
+/**
+ * Record the resources {@param resources} used by the command {@param command} of the target {@param target},
+ * which exited with {@param exitStatus} {@param elapsed} seconds after it was started. The strings are not
+ * copied, and must outlive {@param report}.
+ */
+BakeError usage_record(UsageReport * report, char * target, char * command, int exitStatus,
+                       double elapsed, struct rusage * resources);
+
+
+/**
+ * @return the number of seconds in {@param time}
+ */
+double usage_seconds(struct timeval time);
+
+
+/**
+ * Orders the CommandUsage's pointed to by {@param first} and {@param second} by their CPU time, from most to least.
+ */
+int compareCPUTime(const void * first, const void * second);
+
+
+/**
+ * Print a table of the {@param count} commands of {@param report} that used the most CPU time to {@param file}.
+ */
+BakeError usage_print(UsageReport * report, FILE * file, size_t count);
+
+
+/**
+ * Write all the commands of {@param report} to the file {@param path} as JSON.
+ */
+BakeError usage_writeJSON(UsageReport * report, char * path);
+
+
+/**
+ * Write {@param string} to {@param file} as a quoted JSON string, or null if {@param string} is NULL.
+ */
+void writeJSONString(FILE * file, char * string);
+
+
+#endif //CITS2002_USAGE_H